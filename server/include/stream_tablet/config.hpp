@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace stream_tablet {
 
@@ -20,6 +21,12 @@ enum class CodecType {
     H264    // H.264 - fastest encoding, widest compatibility
 };
 
+// One simulcast encode: resolution relative to the capture, and bitrate
+struct SimulcastRung {
+    float scale = 1.0f;
+    int bitrate = 0;
+};
+
 struct ServerConfig {
     // Display
     std::string display = ":0";
@@ -32,6 +39,8 @@ struct ServerConfig {
     CodecType codec_type = CodecType::AUTO;  // Video codec to use
     int cqp = 24;            // Quality level for CQP mode (lower = better, 1-51)
                              // AUTO mode starts at 24 and adjusts dynamically
+    int qp_min = 1;          // QP bounds for every mode (the AUTO adjustment
+    int qp_max = 51;         // and the encoder's own rate control stay inside)
 
     // Network
     uint16_t control_port = 9500;
@@ -47,6 +56,8 @@ struct ServerConfig {
     int audio_frame_ms = 10;       // Frame size in milliseconds
 
     // Security
+    bool tls = false;             // TLS 1.3 on the control channel
+    bool tls_early_data = true;   // Accept a resumed client's config request as 0-RTT data
     std::string cert_file = "server.crt";
     std::string key_file = "server.key";
     std::string ca_file = "ca.crt";
@@ -57,6 +68,88 @@ struct ServerConfig {
 
     // Pacing mode for video sender (0=auto, 1=none, 2=light, 3=aggressive)
     int pacing_mode = 0;  // AUTO by default
+
+    // Egress scheduler across media sockets (0=off, 1=strict priority, 2=weighted)
+    int egress_mode = 0;
+
+    // Multiplex video, audio and feedback over the video UDP socket
+    // (only used when the client advertises support). Input keeps its own
+    // port: the input thread waits on it directly, while the mux socket's
+    // feedback is drained from the frame loop.
+    bool udp_mux = false;
+
+    // Mark video packets ECT(1) and back off on CE feedback (L4S-style)
+    bool ecn = false;
+    float ecn_impair_ce = 0.0f;   // Testing: fraction of video packets sent already CE-marked
+
+    // Send video to an IP multicast group (empty = unicast to the client)
+    std::string multicast_group;
+    uint16_t multicast_port = 9504;
+    int multicast_ttl = 1;        // 1 = stay on the local subnet
+    int fec_group = -1;           // Parity every N packets (0 = off, -1 = adapt to receiver loss)
+
+    // Concurrent clients sharing one capture/encode (1 = single client)
+    int max_clients = 1;
+
+    // Simulcast ladder (empty = one encode at the capture resolution).
+    // Each client is served the rung its rate controller can sustain.
+    std::vector<SimulcastRung> simulcast_rungs;
+
+    // Collapse stylus/touch MOVE and HOVER samples per pointer before uinput
+    // (-1 = off, 0 = within one receive batch, N = hold up to N microseconds)
+    int input_coalesce_us = -1;
+
+    // Release stylus samples to uinput at their client-side spacing instead
+    // of in per-vsync bursts, holding each at most this long (-1 = off).
+    // Stylus samples are then never coalesced.
+    int input_pace_us = -1;
+
+    // Draw the stylus this many ms ahead of the last sample while it moves
+    // on the surface (0 = off)
+    int stylus_predict_ms = 0;
+
+    // Capture as soon as input has had this long to reach the screen instead
+    // of waiting for the next tick (-1 = off). Frames are never closer than
+    // 1/input_trigger_max_fps apart (0 = capture_fps, so triggering only
+    // shifts the frame phase; more frames than that outrun the encoder's
+    // per-frame bit budget)
+    int input_trigger_us = -1;
+    int input_trigger_max_fps = 0;
+
+    // Receive input on a dedicated epoll thread instead of the frame loop
+    bool input_thread = true;
+    int input_rt_priority = 0;    // SCHED_FIFO priority for that thread (0 = normal)
+
+    // Record decoded input events with receive times (empty = off; replay
+    // with stream_tablet_input_replay)
+    std::string input_record_path;
+
+    // Write input_event records to this file instead of creating uinput
+    // devices (benchmarks and CI without /dev/uinput)
+    std::string uinput_sink;
+
+    // Accept compact input batches from clients that support them
+    bool compact_input = true;
+
+    // Accept redundant input datagrams on the input port (UDP), so a lost
+    // packet doesn't stall later samples behind a TCP retransmission
+    bool udp_input = true;
+
+    // Measure clock offset and drift to clients that support it, so input
+    // latency includes the absolute one-way network delay
+    bool clock_sync = true;
+
+    // Keep a dropped client's stream state (rate estimate, rung, input role)
+    // this long for a reconnect with its session token (0 = off)
+    int resume_grace_ms = 10000;
+
+    // Ping heartbeat-capable clients this often and suspend capture, encode
+    // and audio once every client missed this many in a row (0 = off)
+    int heartbeat_ms = 1000;
+    int heartbeat_misses = 3;
+
+    // UNIX socket for stats and live tuning (stream_tablet_ctl; empty = off)
+    std::string admin_socket;
 };
 
 struct EncoderConfig {
@@ -69,6 +162,8 @@ struct EncoderConfig {
     QualityMode quality_mode = QualityMode::BALANCED;
     CodecType codec_type = CodecType::AUTO;  // Video codec to use
     int cqp = 20;  // Quality level for CQP mode (lower = better, 1-51)
+    int qp_min = 1;   // QP bounds: clamp the CQP level, and the rate
+    int qp_max = 51;  // controller's QP in bitrate modes
 };
 
 // Protocol constants
@@ -81,6 +176,17 @@ constexpr uint8_t PACKET_TYPE_AUDIO = 0x04;
 
 constexpr size_t MAX_PACKET_PAYLOAD = 1200;  // MTU-safe
 
+// Stream ids prefixed to every datagram in multiplexed UDP mode
+constexpr uint8_t STREAM_ID_VIDEO = 0x01;
+constexpr uint8_t STREAM_ID_AUDIO = 0x02;
+constexpr uint8_t STREAM_ID_FEEDBACK = 0x03;
+
+// ECN codepoints (low 2 bits of the TOS byte)
+constexpr uint8_t ECN_NOT_ECT = 0x00;
+constexpr uint8_t ECN_ECT1 = 0x01;    // L4S identifier
+constexpr uint8_t ECN_ECT0 = 0x02;
+constexpr uint8_t ECN_CE = 0x03;      // Congestion experienced
+
 // Audio stream configuration for protocol negotiation
 struct AudioStreamConfig {
     uint16_t port = 9503;
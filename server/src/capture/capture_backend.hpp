@@ -36,6 +36,10 @@ public:
     // Check if initialized successfully
     virtual bool is_initialized() const = 0;
 
+    // Stop or restart frame production while nobody watches. Backends that
+    // only capture when asked have nothing to do.
+    virtual void set_active(bool active) { (void)active; }
+
     // Get backend name for logging
     virtual const char* get_name() const = 0;
 
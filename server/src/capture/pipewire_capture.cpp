@@ -175,6 +175,17 @@ bool PipeWireCapture::capture_frame(CapturedFrame& frame) {
     return true;
 }
 
+void PipeWireCapture::set_active(bool active) {
+    if (!m_initialized || !m_pw_stream) {
+        return;
+    }
+    // Pausing rather than disconnecting: a new stream would need a new
+    // portal session, and with it another permission prompt
+    pw_stream_set_active(m_pw_stream, active);
+    pw_loop_iterate(pw_main_loop_get_loop(m_pw_loop), 0);
+    LOG_INFO("PipeWire stream %s", active ? "resumed" : "paused");
+}
+
 // D-Bus initialization
 bool PipeWireCapture::init_dbus() {
     GError* error = nullptr;
@@ -40,6 +40,9 @@ public:
     // Check if initialized
     bool is_initialized() const override { return m_initialized; }
 
+    // Pause or restart the stream (keeps the portal session)
+    void set_active(bool active) override;
+
     // Backend name
     const char* get_name() const override { return "PipeWire"; }
 
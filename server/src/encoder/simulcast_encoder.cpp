@@ -0,0 +1,278 @@
+#include "simulcast_encoder.hpp"
+#include "../util/logger.hpp"
+
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+
+namespace stream_tablet {
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Resample one plane with interleaved components (1 = Y, 2 = UV) in 16.16 fixed point
+static void scale_plane(const uint8_t* src, int src_w, int src_h, int src_stride,
+                        uint8_t* dst, int dst_w, int dst_h, int dst_stride, int components) {
+    if (dst_w <= 0 || dst_h <= 0) {
+        return;
+    }
+    const uint32_t step_x = static_cast<uint32_t>((static_cast<uint64_t>(src_w) << 16) / dst_w);
+    const uint32_t step_y = static_cast<uint32_t>((static_cast<uint64_t>(src_h) << 16) / dst_h);
+
+    for (int y = 0; y < dst_h; y++) {
+        uint32_t fy = y * step_y + (step_y >> 1);
+        int sy = std::min(static_cast<int>(fy >> 16), src_h - 1);
+        int sy1 = std::min(sy + 1, src_h - 1);
+        uint32_t wy = (fy >> 8) & 0xFF;
+        const uint8_t* row0 = src + sy * src_stride;
+        const uint8_t* row1 = src + sy1 * src_stride;
+        uint8_t* out = dst + y * dst_stride;
+
+        for (int x = 0; x < dst_w; x++) {
+            uint32_t fx = x * step_x + (step_x >> 1);
+            int sx = std::min(static_cast<int>(fx >> 16), src_w - 1);
+            int sx1 = std::min(sx + 1, src_w - 1);
+            uint32_t wx = (fx >> 8) & 0xFF;
+            for (int c = 0; c < components; c++) {
+                uint32_t a = row0[sx * components + c];
+                uint32_t b = row0[sx1 * components + c];
+                uint32_t d = row1[sx * components + c];
+                uint32_t e = row1[sx1 * components + c];
+                uint32_t top = a * (256 - wx) + b * wx;
+                uint32_t bottom = d * (256 - wx) + e * wx;
+                out[x * components + c] = static_cast<uint8_t>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+            }
+        }
+    }
+}
+
+void scale_nv12(const NV12Planes& src, int src_width, int src_height,
+                const NV12Planes& dst, int dst_width, int dst_height) {
+    scale_plane(src.y, src_width, src_height, src.y_stride,
+                dst.y, dst_width, dst_height, dst.y_stride, 1);
+    scale_plane(src.uv, src_width / 2, src_height / 2, src.uv_stride,
+                dst.uv, dst_width / 2, dst_height / 2, dst.uv_stride, 2);
+}
+
+bool SimulcastEncoder::init(const EncoderConfig& base, const std::vector<SimulcastRung>& rungs,
+                            float output_scale) {
+    shutdown();
+    output_scale = std::clamp(output_scale, 0.05f, 1.0f);
+
+    std::vector<SimulcastRung> ladder = rungs;
+    if (ladder.empty()) {
+        ladder.push_back({1.0f, base.bitrate});
+    }
+
+    // CQP rungs are tuned relative to the top rung, which keeps the configured QP
+    const int top_bitrate = ladder[0].bitrate > 0 ? ladder[0].bitrate : base.bitrate;
+
+    for (size_t i = 0; i < ladder.size(); i++) {
+        const SimulcastRung& spec = ladder[i];
+        float scale = std::clamp(spec.scale, 0.05f, 1.0f) * output_scale;
+
+        EncoderConfig config = base;
+        // Rung 0 is the conversion target, so it must match the capture size
+        // (unless everything is scaled)
+        if (i > 0 || output_scale < 1.0f) {
+            config.width = std::max(16, static_cast<int>(std::lround(base.width * scale)) & ~1);
+            config.height = std::max(16, static_cast<int>(std::lround(base.height * scale)) & ~1);
+        }
+        config.bitrate = spec.bitrate > 0 ? spec.bitrate : base.bitrate;
+        if (config.quality_mode == QualityMode::AUTO || config.quality_mode == QualityMode::HIGH_QUALITY) {
+            // CQP: fewer pixels account for part of the lower budget, QP covers the rest
+            double pixels = static_cast<double>(config.width) * config.height /
+                            (static_cast<double>(base.width) * base.height);
+            double ratio = static_cast<double>(top_bitrate) * pixels / config.bitrate;
+            if (ratio > 1.0) {
+                config.cqp = std::clamp(base.cqp + static_cast<int>(std::lround(6.0 * std::log2(ratio))), 1, 51);
+            }
+        }
+
+        Rung rung;
+        rung.encoder = std::make_unique<VAAPIEncoder>();
+        if (!rung.encoder->init(config)) {
+            LOG_ERROR("Failed to initialize simulcast rung %zu (%dx%d)", i, config.width, config.height);
+            shutdown();
+            return false;
+        }
+        rung.bitrate = config.bitrate;
+        m_rungs.push_back(std::move(rung));
+
+        if (ladder.size() > 1) {
+            LOG_INFO("Simulcast rung %zu: %dx%d, %.2f Mbps, qp=%d", i, config.width, config.height,
+                     config.bitrate / 1e6, config.cqp);
+        }
+    }
+
+    if (output_scale < 1.0f) {
+        m_source_width = base.width;
+        m_source_height = base.height;
+        m_source_stride = (base.width + 1) & ~1;
+        m_source.resize(static_cast<size_t>(m_source_stride) * (base.height + (base.height + 1) / 2));
+        LOG_INFO("Encoding at %dx%d (capture %dx%d)", m_rungs[0].encoder->get_width(),
+                 m_rungs[0].encoder->get_height(), base.width, base.height);
+    }
+    return true;
+}
+
+void SimulcastEncoder::shutdown() {
+    m_rungs.clear();
+    m_source.clear();
+    m_convert_ns = 0;
+    m_convert_frames = 0;
+}
+
+void SimulcastEncoder::set_active(size_t rung, bool active) {
+    if (rung >= m_rungs.size() || m_rungs[rung].active == active) {
+        return;
+    }
+    m_rungs[rung].active = active;
+    if (active) {
+        // The decoder joining this rung needs a fresh reference
+        m_rungs[rung].encoder->request_keyframe();
+    }
+    LOG_INFO("Simulcast rung %zu %s", rung, active ? "activated" : "idle");
+}
+
+void SimulcastEncoder::set_rung_bitrate(size_t rung, int bitrate) {
+    if (rung >= m_rungs.size() || bitrate <= 0) {
+        return;
+    }
+    m_rungs[rung].bitrate = bitrate;
+    m_rungs[rung].encoder->set_bitrate(bitrate);
+}
+
+void SimulcastEncoder::set_framerate(int fps) {
+    for (auto& rung : m_rungs) {
+        rung.encoder->set_framerate(fps);
+    }
+}
+
+void SimulcastEncoder::set_qp_range(int qp_min, int qp_max) {
+    for (auto& rung : m_rungs) {
+        rung.encoder->set_qp_range(qp_min, qp_max);
+    }
+}
+
+void SimulcastEncoder::request_keyframe_all() {
+    for (auto& rung : m_rungs) {
+        rung.encoder->request_keyframe();
+    }
+}
+
+bool SimulcastEncoder::encode(const uint8_t* bgra_data, int width, int height, int stride,
+                              uint64_t timestamp_us, std::vector<RungFrame>& output) {
+    output.clear();
+    if (m_rungs.empty()) {
+        return false;
+    }
+
+    // Single encode: no shared buffer juggling
+    if (m_rungs.size() == 1 && m_source.empty()) {
+        Rung& rung = m_rungs[0];
+        uint64_t cpu0 = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        uint64_t wall0 = clock_ns(CLOCK_MONOTONIC);
+        RungFrame out;
+        bool ok = rung.encoder->encode(bgra_data, width, height, stride, timestamp_us, out.frame);
+        rung.cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+        rung.gpu_ns += clock_ns(CLOCK_MONOTONIC) - wall0;
+        if (ok) {
+            rung.frames++;
+            rung.bytes += out.frame.data.size();
+            output.push_back(std::move(out));
+        }
+        return ok;
+    }
+
+    // Convert once into the full-resolution rung's upload buffer (or our own
+    // capture-size buffer when every rung is scaled)
+    NV12Planes source;
+    int source_width = width;
+    int source_height = height;
+    bool scale_all = !m_source.empty();
+    if (scale_all) {
+        if (width != m_source_width || height != m_source_height) {
+            return false;
+        }
+        source.y = m_source.data();
+        source.uv = m_source.data() + static_cast<size_t>(m_source_stride) * m_source_height;
+        source.y_stride = m_source_stride;
+        source.uv_stride = m_source_stride;
+    } else {
+        VAAPIEncoder& top = *m_rungs[0].encoder;
+        source = top.get_input_planes();
+        source_width = top.get_width();
+        source_height = top.get_height();
+    }
+    if (!source.y) {
+        return false;
+    }
+    uint64_t convert0 = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    VAAPIEncoder::convert_bgra_to_nv12(bgra_data, width, height, stride, source);
+    m_convert_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - convert0;
+    m_convert_frames++;
+
+    for (size_t i = 0; i < m_rungs.size(); i++) {
+        Rung& rung = m_rungs[i];
+        if (!rung.active) {
+            continue;
+        }
+
+        uint64_t cpu0 = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        if (i > 0 || scale_all) {
+            NV12Planes planes = rung.encoder->get_input_planes();
+            if (!planes.y) {
+                continue;
+            }
+            scale_nv12(source, source_width, source_height,
+                       planes, rung.encoder->get_width(), rung.encoder->get_height());
+        }
+        uint64_t wall0 = clock_ns(CLOCK_MONOTONIC);
+
+        RungFrame out;
+        out.rung = static_cast<int>(i);
+        bool ok = rung.encoder->encode_input(timestamp_us, out.frame);
+        rung.cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+        rung.gpu_ns += clock_ns(CLOCK_MONOTONIC) - wall0;
+        if (ok) {
+            rung.frames++;
+            rung.bytes += out.frame.data.size();
+            output.push_back(std::move(out));
+        }
+    }
+    return !output.empty();
+}
+
+double SimulcastEncoder::take_convert_ms() {
+    double ms = m_convert_frames ? m_convert_ns / 1e6 / m_convert_frames : 0.0;
+    m_convert_ns = 0;
+    m_convert_frames = 0;
+    return ms;
+}
+
+std::vector<RungStats> SimulcastEncoder::take_stats() {
+    std::vector<RungStats> result;
+    result.reserve(m_rungs.size());
+    for (auto& rung : m_rungs) {
+        RungStats stats;
+        stats.width = rung.encoder->get_width();
+        stats.height = rung.encoder->get_height();
+        stats.bitrate = rung.encoder->get_bitrate();
+        stats.active = rung.active;
+        stats.frames = rung.frames;
+        stats.bytes = rung.bytes;
+        if (rung.frames > 0) {
+            stats.cpu_ms = rung.cpu_ns / 1e6 / rung.frames;
+            stats.gpu_ms = rung.gpu_ns / 1e6 / rung.frames;
+        }
+        result.push_back(stats);
+        rung.frames = rung.bytes = rung.cpu_ns = rung.gpu_ns = 0;
+    }
+    return result;
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "stream_tablet/config.hpp"
+#include "vaapi_encoder.hpp"
+
+namespace stream_tablet {
+
+// Output of one rung for one captured frame
+struct RungFrame {
+    int rung = 0;
+    EncodedFrame frame;
+};
+
+// Per-rung cost since the last take_stats()
+struct RungStats {
+    int width = 0;
+    int height = 0;
+    int bitrate = 0;
+    bool active = false;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    double cpu_ms = 0.0;   // Thread CPU time: scaling, upload and encode calls
+    double gpu_ms = 0.0;   // Wall time of upload + encode (mostly waiting on the GPU)
+};
+
+// Runs one VA-API encoder per resolution/bitrate rung off a single capture.
+// The BGRA->NV12 conversion happens once, into the top rung's upload
+// buffer; lower rungs are scaled from that NV12 image, so every extra rung
+// costs a downscale and a hardware encode, not another conversion.
+// Rung 0 is the full-resolution encode, unless an output scale shrinks the
+// whole ladder; then the conversion goes to a buffer of our own and every
+// rung is scaled from it.
+class SimulcastEncoder {
+public:
+    SimulcastEncoder() = default;
+
+    SimulcastEncoder(const SimulcastEncoder&) = delete;
+    SimulcastEncoder& operator=(const SimulcastEncoder&) = delete;
+
+    // Rungs are used in the given order. Empty = one rung at base.bitrate.
+    // base.width/height is the capture size; output_scale (0-1] shrinks
+    // every rung below it.
+    bool init(const EncoderConfig& base, const std::vector<SimulcastRung>& rungs,
+              float output_scale = 1.0f);
+    void shutdown();
+
+    // Encode one frame on every active rung
+    bool encode(const uint8_t* bgra_data, int width, int height, int stride,
+                uint64_t timestamp_us, std::vector<RungFrame>& output);
+
+    size_t get_rung_count() const { return m_rungs.size(); }
+    VAAPIEncoder& get_encoder(size_t rung) { return *m_rungs[rung].encoder; }
+    const VAAPIEncoder& get_encoder(size_t rung) const { return *m_rungs[rung].encoder; }
+    int get_rung_bitrate(size_t rung) const { return m_rungs[rung].bitrate; }
+
+    // Retune a rung's bitrate / every rung's frame rate or QP bounds
+    // (applied by each encoder at its next keyframe)
+    void set_rung_bitrate(size_t rung, int bitrate);
+    void set_framerate(int fps);
+    void set_qp_range(int qp_min, int qp_max);
+
+    // Rungs nobody watches are not encoded. Reactivating one starts with an IDR.
+    void set_active(size_t rung, bool active);
+    bool is_active(size_t rung) const { return m_rungs[rung].active; }
+
+    void request_keyframe(size_t rung) { m_rungs[rung].encoder->request_keyframe(); }
+    void request_keyframe_all();
+
+    // Shared conversion cost and per-rung costs; resets the counters
+    double take_convert_ms();
+    std::vector<RungStats> take_stats();
+
+private:
+    struct Rung {
+        std::unique_ptr<VAAPIEncoder> encoder;
+        int bitrate = 0;
+        bool active = true;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t cpu_ns = 0;
+        uint64_t gpu_ns = 0;
+    };
+
+    std::vector<Rung> m_rungs;
+    // Capture-size NV12 image when rung 0 is scaled too (empty otherwise)
+    std::vector<uint8_t> m_source;
+    int m_source_width = 0;
+    int m_source_height = 0;
+    int m_source_stride = 0;
+    uint64_t m_convert_ns = 0;
+    uint64_t m_convert_frames = 0;
+};
+
+// Bilinear NV12 resize (chroma resampled on its own half-resolution grid)
+void scale_nv12(const NV12Planes& src, int src_width, int src_height,
+                const NV12Planes& dst, int dst_width, int dst_height);
+
+}  // namespace stream_tablet
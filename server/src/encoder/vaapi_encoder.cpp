@@ -15,6 +15,7 @@ extern "C" {
 #include <dirent.h>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <string>
 
@@ -26,8 +27,13 @@ extern "C" {
 
 namespace stream_tablet {
 
+// With a GOP longer than this, a pending backoff reopens the codec this
+// long after the last keyframe rather than at the GOP end
+static constexpr int BACKOFF_REOPEN_S = 3;
+
 // Private implementation using FFmpeg
 struct VAAPIEncoder::Impl {
+    const AVCodec* codec = nullptr;
     AVBufferRef* hw_device_ctx = nullptr;
     AVBufferRef* hw_frames_ctx = nullptr;
     AVCodecContext* codec_ctx = nullptr;
@@ -71,26 +77,8 @@ static std::vector<std::string> get_render_devices() {
     return devices;
 }
 
-// Try to initialize encoder on a specific device
-static bool try_encoder_on_device(const char* device, const char* encoder_name,
-                                   const EncoderConfig& config,
-                                   AVBufferRef** hw_device_ctx,
-                                   AVBufferRef** hw_frames_ctx,
-                                   AVCodecContext** codec_ctx) {
-    const AVCodec* codec = avcodec_find_encoder_by_name(encoder_name);
-    if (!codec) return false;
-
-    // Try to create device context
-    int ret = av_hwdevice_ctx_create(hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, device, nullptr, 0);
-    if (ret < 0) return false;
-
-    // Create codec context
-    *codec_ctx = avcodec_alloc_context3(codec);
-    if (!*codec_ctx) {
-        av_buffer_unref(hw_device_ctx);
-        return false;
-    }
-
+// Apply encoder settings (resolution, GOP, rate control) to a codec context
+static void configure_codec_context(AVCodecContext** codec_ctx, const EncoderConfig& config) {
     // Configure encoder
     (*codec_ctx)->width = config.width;
     (*codec_ctx)->height = config.height;
@@ -140,7 +128,38 @@ static bool try_encoder_on_device(const char* device, const char* encoder_name,
         av_opt_set((*codec_ctx)->priv_data, "rc_mode", "CBR", 0);
         av_opt_set((*codec_ctx)->priv_data, "preset", "fast", 0);
         av_opt_set((*codec_ctx)->priv_data, "tune", "zerolatency", 0);
+        // Only narrowed bounds are passed on: VA-API encoders default to
+        // the driver's full range (-1)
+        if (config.qp_min > 1) {
+            (*codec_ctx)->qmin = config.qp_min;
+        }
+        if (config.qp_max < 51) {
+            (*codec_ctx)->qmax = config.qp_max;
+        }
     }
+}
+
+// Try to initialize encoder on a specific device
+static bool try_encoder_on_device(const char* device, const char* encoder_name,
+                                   const EncoderConfig& config,
+                                   AVBufferRef** hw_device_ctx,
+                                   AVBufferRef** hw_frames_ctx,
+                                   AVCodecContext** codec_ctx) {
+    const AVCodec* codec = avcodec_find_encoder_by_name(encoder_name);
+    if (!codec) return false;
+
+    // Try to create device context
+    int ret = av_hwdevice_ctx_create(hw_device_ctx, AV_HWDEVICE_TYPE_VAAPI, device, nullptr, 0);
+    if (ret < 0) return false;
+
+    // Create codec context
+    *codec_ctx = avcodec_alloc_context3(codec);
+    if (!*codec_ctx) {
+        av_buffer_unref(hw_device_ctx);
+        return false;
+    }
+
+    configure_codec_context(codec_ctx, config);
 
     // Create HW frames context
     *hw_frames_ctx = av_hwframe_ctx_alloc(*hw_device_ctx);
@@ -181,6 +200,8 @@ static bool try_encoder_on_device(const char* device, const char* encoder_name,
 
 bool VAAPIEncoder::init(const EncoderConfig& config) {
     m_config = config;
+    m_running_bitrate = config.bitrate;
+    m_running_qp = config.cqp;
 
     // Suppress FFmpeg internal logging (only show errors in quiet mode)
     // Users can use -v to see our logs, but FFmpeg logs are too noisy
@@ -241,6 +262,7 @@ bool VAAPIEncoder::init(const EncoderConfig& config) {
                                        &m_impl->codec_ctx)) {
                 LOG_INFO("Success! Using %s encoder on %s", codec.display_name, device.c_str());
                 m_actual_codec = codec.codec_id;
+                m_impl->codec = avcodec_find_encoder_by_name(codec.encoder_name);
 
                 // Allocate frames
                 m_impl->sw_frame = av_frame_alloc();
@@ -269,6 +291,31 @@ void VAAPIEncoder::shutdown() {
     m_impl.reset(new Impl());
 }
 
+// Replace the codec context with one using the current m_config.
+// The device and HW frames context are kept, so this only costs an IDR.
+bool VAAPIEncoder::reopen_codec() {
+    if (!m_impl->codec || !m_impl->hw_frames_ctx) {
+        return false;
+    }
+
+    AVCodecContext* codec_ctx = avcodec_alloc_context3(m_impl->codec);
+    if (!codec_ctx) {
+        return false;
+    }
+
+    configure_codec_context(&codec_ctx, m_config);
+    codec_ctx->hw_frames_ctx = av_buffer_ref(m_impl->hw_frames_ctx);
+
+    if (avcodec_open2(codec_ctx, m_impl->codec, nullptr) < 0) {
+        avcodec_free_context(&codec_ctx);
+        return false;
+    }
+
+    avcodec_free_context(&m_impl->codec_ctx);
+    m_impl->codec_ctx = codec_ctx;
+    return true;
+}
+
 // Fast BGRA to NV12 conversion - optimized with SSE2
 static void convert_bgra_to_nv12_fast(const uint8_t* bgra, int width, int height, int src_stride,
                                        uint8_t* y_plane, uint8_t* uv_plane,
@@ -367,6 +414,32 @@ bool VAAPIEncoder::encode(const uint8_t* bgra_data, int width, int height, int s
                                sw_frame->data[0], sw_frame->data[1],
                                sw_frame->linesize[0], sw_frame->linesize[1]);
 
+    return encode_input(timestamp_us, output);
+}
+
+NV12Planes VAAPIEncoder::get_input_planes() {
+    NV12Planes planes;
+    if (m_impl->sw_frame) {
+        planes.y = m_impl->sw_frame->data[0];
+        planes.uv = m_impl->sw_frame->data[1];
+        planes.y_stride = m_impl->sw_frame->linesize[0];
+        planes.uv_stride = m_impl->sw_frame->linesize[1];
+    }
+    return planes;
+}
+
+void VAAPIEncoder::convert_bgra_to_nv12(const uint8_t* bgra, int width, int height, int stride,
+                                        const NV12Planes& dst) {
+    convert_bgra_to_nv12_fast(bgra, width, height, stride,
+                               dst.y, dst.uv, dst.y_stride, dst.uv_stride);
+}
+
+bool VAAPIEncoder::encode_input(uint64_t timestamp_us, EncodedFrame& output) {
+    if (!m_impl->codec_ctx) {
+        return false;
+    }
+
+    AVFrame* sw_frame = m_impl->sw_frame;
     sw_frame->pts = m_frame_count++;
 
     // Upload to GPU
@@ -377,6 +450,26 @@ bool VAAPIEncoder::encode(const uint8_t* bgra_data, int width, int height, int s
     }
     m_impl->hw_frame->pts = sw_frame->pts;
 
+    // Apply pending rate/quality changes where an IDR is due anyway. An IDR
+    // is the worst answer to congestion, so a backoff waits too (the caller
+    // bridges it with get_pending_rate_scale()); only with a long GOP is
+    // the reopen forced, at most once per BACKOFF_REOPEN_S.
+    bool backoff = get_pending_rate_scale() < 1.0;
+    if (m_reconfigure_pending &&
+        (m_force_keyframe || m_frames_since_keyframe + 1 >= m_config.gop_size ||
+         (backoff && m_frames_since_keyframe + 1 >= BACKOFF_REOPEN_S * m_config.framerate))) {
+        m_reconfigure_pending = false;
+        if (reopen_codec()) {
+            m_running_bitrate = m_config.bitrate;
+            m_running_qp = m_config.cqp;
+            LOG_INFO("Encoder reconfigured: %d bps, qp=%d (%d-%d), %d fps", m_config.bitrate, m_config.cqp,
+                     m_config.qp_min, m_config.qp_max, m_config.framerate);
+            m_force_keyframe = true;
+        } else {
+            LOG_WARN("Failed to reconfigure encoder, keeping previous settings");
+        }
+    }
+
     // Force keyframe if requested
     if (m_force_keyframe) {
         m_impl->hw_frame->pict_type = AV_PICTURE_TYPE_I;
@@ -410,14 +503,63 @@ bool VAAPIEncoder::encode(const uint8_t* bgra_data, int width, int height, int s
     memcpy(output.data.data(), m_impl->packet->data, m_impl->packet->size);
     output.timestamp_us = timestamp_us;
     output.is_keyframe = (m_impl->packet->flags & AV_PKT_FLAG_KEY) != 0;
+    m_frames_since_keyframe = output.is_keyframe ? 0 : m_frames_since_keyframe + 1;
 
     av_packet_unref(m_impl->packet);
     return true;
 }
 
+double VAAPIEncoder::get_pending_rate_scale() const {
+    if (!m_reconfigure_pending) {
+        return 1.0;
+    }
+    double scale = 1.0;
+    if (m_config.bitrate < m_running_bitrate) {
+        scale = static_cast<double>(m_config.bitrate) / m_running_bitrate;
+    }
+    if (m_config.cqp > m_running_qp) {
+        // ~6 QP steps halve the bitrate
+        scale = std::min(scale, std::exp2((m_running_qp - m_config.cqp) / 6.0));
+    }
+    return std::max(scale, 0.25);
+}
+
 void VAAPIEncoder::set_bitrate(int bitrate) {
+    if (bitrate <= 0 || bitrate == m_config.bitrate) {
+        return;
+    }
     m_config.bitrate = bitrate;
-    // Would need to reinit encoder to change bitrate
+    m_reconfigure_pending = true;
+}
+
+void VAAPIEncoder::set_framerate(int fps) {
+    if (fps <= 0 || fps == m_config.framerate) {
+        return;
+    }
+    m_config.gop_size = std::max(1, m_config.gop_size * fps / m_config.framerate);
+    m_config.framerate = fps;
+    m_reconfigure_pending = true;
+}
+
+void VAAPIEncoder::set_qp(int qp) {
+    qp = std::clamp(qp, m_config.qp_min, m_config.qp_max);
+    if (qp == m_config.cqp) {
+        return;
+    }
+    m_config.cqp = qp;
+    m_reconfigure_pending = true;
+}
+
+void VAAPIEncoder::set_qp_range(int qp_min, int qp_max) {
+    qp_min = std::clamp(qp_min, 1, 51);
+    qp_max = std::clamp(qp_max, qp_min, 51);
+    if (qp_min == m_config.qp_min && qp_max == m_config.qp_max) {
+        return;
+    }
+    m_config.qp_min = qp_min;
+    m_config.qp_max = qp_max;
+    m_config.cqp = std::clamp(m_config.cqp, qp_min, qp_max);
+    m_reconfigure_pending = true;
 }
 
 }  // namespace stream_tablet
@@ -13,6 +13,14 @@ struct EncodedFrame {
     bool is_keyframe = false;
 };
 
+// Writable NV12 input surface of an encoder (CPU side, uploaded on encode)
+struct NV12Planes {
+    uint8_t* y = nullptr;
+    uint8_t* uv = nullptr;
+    int y_stride = 0;
+    int uv_stride = 0;
+};
+
 class VAAPIEncoder {
 public:
     VAAPIEncoder();
@@ -32,11 +40,39 @@ public:
     bool encode(const uint8_t* bgra_data, int width, int height, int stride,
                 uint64_t timestamp_us, EncodedFrame& output);
 
+    // Encode whatever was written to get_input_planes(). Lets the caller
+    // convert or scale straight into the upload buffer (simulcast rungs).
+    NV12Planes get_input_planes();
+    bool encode_input(uint64_t timestamp_us, EncodedFrame& output);
+
+    // BGRA -> NV12 (BT.601), the conversion encode() uses
+    static void convert_bgra_to_nv12(const uint8_t* bgra, int width, int height, int stride,
+                                     const NV12Planes& dst);
+
     // Force next frame to be a keyframe
     void request_keyframe() { m_force_keyframe = true; }
 
-    // Update bitrate dynamically
+    // Update bitrate / CQP level dynamically. VA-API cannot retune a running
+    // session, so the codec is reopened at the next keyframe boundary. With
+    // a GOP longer than 3 s, a lower bitrate or higher QP forces the reopen
+    // (and its IDR) 3 s after the last keyframe instead.
     void set_bitrate(int bitrate);
+    void set_qp(int qp);
+    // Same reopen path; the keyframe interval keeps its length in time
+    void set_framerate(int fps);
+    // Same reopen path; the CQP level is pulled inside the new bounds
+    void set_qp_range(int qp_min, int qp_max);
+    // Share of frames to encode until a pending decrease takes effect
+    // (pending / running rate, at least 0.25; 1.0 when nothing is pending).
+    // The caller drops the rest, so the output follows a backoff at once
+    // without an extra IDR.
+    double get_pending_rate_scale() const;
+    // A frame the caller dropped still counts toward the keyframe boundary,
+    // so the pending change lands when it would have without decimation
+    void skip_frame() { m_frames_since_keyframe++; }
+    int get_bitrate() const { return m_config.bitrate; }
+    int get_qp() const { return m_config.cqp; }
+    QualityMode get_quality_mode() const { return m_config.quality_mode; }
 
     // Get encoder info
     int get_width() const { return m_config.width; }
@@ -47,12 +83,18 @@ public:
     uint8_t get_codec_type() const { return m_actual_codec; }
 
 private:
+    bool reopen_codec();
+
     struct Impl;
     std::unique_ptr<Impl> m_impl;
 
     EncoderConfig m_config;
     uint64_t m_frame_count = 0;
     bool m_force_keyframe = false;
+    bool m_reconfigure_pending = false;
+    int m_running_bitrate = 0;  // What the open codec context was configured with
+    int m_running_qp = 0;
+    int m_frames_since_keyframe = 0;
     uint8_t m_actual_codec = 0;  // 0=AV1, 1=HEVC, 2=H264
 };
 
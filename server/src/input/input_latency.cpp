@@ -0,0 +1,120 @@
+#include "input_latency.hpp"
+#include <time.h>
+
+namespace stream_tablet {
+
+// The offset estimate follows drift by restarting the minimum this often
+// (the previous window's minimum stays in use for one more window)
+static constexpr uint64_t MIN_WINDOW_NS = 10000000000ULL;
+
+uint64_t InputLatency::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void InputLatency::set_clock_offset(int64_t offset_ms) {
+    m_synced_offset_ms = offset_ms;
+    m_synced = true;
+}
+
+void InputLatency::reset_clock() {
+    m_synced = false;
+    m_have_min = false;
+}
+
+void InputLatency::record(const InputEvent& event, uint64_t dispatch_ns, uint64_t done_ns) {
+    int type = static_cast<int>(event.type);
+    if (type <= 0 || type >= TYPE_COUNT || event.received_ns == 0) {
+        return;
+    }
+    TypeHistograms& h = m_types[type];
+
+    uint64_t received_ns = event.received_ns;
+    h.queue.record(dispatch_ns > received_ns ? (dispatch_ns - received_ns) / 1000 : 0);
+    h.write.record(done_ns > dispatch_ns ? (done_ns - dispatch_ns) / 1000 : 0);
+    h.total.record(done_ns > received_ns ? (done_ns - received_ns) / 1000 : 0);
+
+    // Client timestamps are 32-bit milliseconds, so work modulo 2^32
+    uint32_t received_ms = static_cast<uint32_t>(received_ns / 1000000);
+    uint32_t offset = received_ms - event.timestamp_ms;
+    uint32_t reference;
+    if (m_synced) {
+        reference = static_cast<uint32_t>(m_synced_offset_ms.load());
+    } else {
+        if (!m_have_min || received_ns - m_window_start_ns >= MIN_WINDOW_NS) {
+            m_prev_min_offset = m_have_min ? m_min_offset : offset;
+            m_min_offset = offset;
+            m_window_start_ns = received_ns;
+            m_have_min = true;
+        } else if (static_cast<int32_t>(offset - m_min_offset) < 0) {
+            m_min_offset = offset;
+        }
+        reference = static_cast<int32_t>(m_prev_min_offset - m_min_offset) < 0
+                        ? m_prev_min_offset : m_min_offset;
+    }
+    int32_t network_ms = static_cast<int32_t>(offset - reference);
+    h.network.record(network_ms > 0 ? static_cast<uint64_t>(network_ms) * 1000 : 0);
+}
+
+std::vector<InputLatencyStats> InputLatency::get_stats(bool reset) {
+    std::vector<InputLatencyStats> stats;
+    for (int type = 1; type < TYPE_COUNT; type++) {
+        TypeHistograms& h = m_types[type];
+        InputLatencyStats s;
+        s.type = static_cast<InputEventType>(type);
+        s.total = h.total.snapshot(reset);
+        s.network = h.network.snapshot(reset);
+        s.queue = h.queue.snapshot(reset);
+        s.write = h.write.snapshot(reset);
+        s.clock_synced = m_synced;
+        if (reset) {
+            m_last_interval[type] = s;
+        }
+        if (s.total.count > 0) {
+            stats.push_back(s);
+        }
+    }
+    return stats;
+}
+
+std::vector<InputLatencyStats> InputLatency::get_recent_stats() {
+    std::vector<InputLatencyStats> stats;
+    for (int type = 1; type < TYPE_COUNT; type++) {
+        TypeHistograms& h = m_types[type];
+        const InputLatencyStats& last = m_last_interval[type];
+        InputLatencyStats s;
+        s.type = static_cast<InputEventType>(type);
+        s.total = h.total.snapshot();
+        s.total.merge(last.total);
+        if (s.total.count == 0) {
+            continue;
+        }
+        s.network = h.network.snapshot();
+        s.network.merge(last.network);
+        s.queue = h.queue.snapshot();
+        s.queue.merge(last.queue);
+        s.write = h.write.snapshot();
+        s.write.merge(last.write);
+        s.clock_synced = m_synced;
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+const char* InputLatency::type_name(InputEventType type) {
+    switch (type) {
+        case InputEventType::TOUCH_DOWN: return "TOUCH_DOWN";
+        case InputEventType::TOUCH_MOVE: return "TOUCH_MOVE";
+        case InputEventType::TOUCH_UP: return "TOUCH_UP";
+        case InputEventType::STYLUS_DOWN: return "STYLUS_DOWN";
+        case InputEventType::STYLUS_MOVE: return "STYLUS_MOVE";
+        case InputEventType::STYLUS_UP: return "STYLUS_UP";
+        case InputEventType::STYLUS_HOVER: return "STYLUS_HOVER";
+        case InputEventType::KEY_DOWN: return "KEY_DOWN";
+        case InputEventType::KEY_UP: return "KEY_UP";
+    }
+    return "UNKNOWN";
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../network/input_receiver.hpp"
+#include "../util/latency_histogram.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace stream_tablet {
+
+// Where each input event spent its time on the way to /dev/uinput:
+//   network: client timestamp -> socket receive (clocks aligned, see below)
+//   queue:   socket receive -> dispatch (thread handoff, coalescing hold)
+//   write:   dispatch -> uinput write completed
+//   total:   socket receive -> uinput write completed
+// Histograms are kept per event type.
+//
+// Until a clock offset is set from a real sync, the client clock is aligned
+// by the smallest (receive - client timestamp) seen in the last ~20 s, so
+// network times are relative to the fastest recent packet (jitter and
+// queueing), not absolute one-way delay.
+struct InputLatencyStats {
+    InputEventType type;
+    LatencyHistogram::Snapshot network;
+    LatencyHistogram::Snapshot queue;
+    LatencyHistogram::Snapshot write;
+    LatencyHistogram::Snapshot total;
+    bool clock_synced = false;
+};
+
+class InputLatency {
+public:
+    InputLatency() = default;
+
+    // Record a dispatched event (received_ns set by InputReceiver). Callers
+    // serialize record() (Server holds its input lock); reading the stats
+    // needs no lock.
+    void record(const InputEvent& event, uint64_t dispatch_ns, uint64_t done_ns);
+
+    // Measured offset (ClockSync): server_ms = client timestamp_ms + offset_ms
+    void set_clock_offset(int64_t offset_ms);
+
+    // New client: forget the clock alignment
+    void reset_clock();
+
+    // Event types with samples; reset=true starts a new interval
+    std::vector<InputLatencyStats> get_stats(bool reset = false);
+
+    // The interval in progress plus the last one get_stats(true) ended,
+    // without resetting anything (for queries between the periodic logs).
+    // Call from the same thread as get_stats().
+    std::vector<InputLatencyStats> get_recent_stats();
+
+    static const char* type_name(InputEventType type);
+
+    // CLOCK_MONOTONIC, same clock as InputEvent::received_ns
+    static uint64_t now_ns();
+
+private:
+    static constexpr int TYPE_COUNT = 10;  // Indexed by InputEventType value
+
+    struct TypeHistograms {
+        LatencyHistogram network;
+        LatencyHistogram queue;
+        LatencyHistogram write;
+        LatencyHistogram total;
+    };
+    TypeHistograms m_types[TYPE_COUNT];
+    InputLatencyStats m_last_interval[TYPE_COUNT] = {};
+
+    std::atomic<bool> m_synced{false};
+    std::atomic<int64_t> m_synced_offset_ms{0};
+
+    // Windowed minimum of (receive ms - client ms), modulo 2^32
+    bool m_have_min = false;
+    uint32_t m_min_offset = 0;
+    uint32_t m_prev_min_offset = 0;
+    uint64_t m_window_start_ns = 0;
+};
+
+}  // namespace stream_tablet
@@ -0,0 +1,46 @@
+#include "input_pacer.hpp"
+#include <algorithm>
+
+namespace stream_tablet {
+
+void InputPacer::push(const InputEvent& event, uint64_t now_ns) {
+    Paced paced;
+    paced.event = event;
+    paced.received_ns = now_ns;
+
+    uint64_t due = now_ns;
+    if (m_have_last) {
+        // Client timestamps are 32-bit milliseconds; treat going backwards as 0
+        int32_t dt_ms = static_cast<int32_t>(event.timestamp_ms - m_last_timestamp_ms);
+        uint64_t spaced = m_last_due_ns + static_cast<uint64_t>(std::max(dt_ms, 0)) * 1000000;
+        if (spaced > now_ns + m_max_delay_ns) {
+            spaced = now_ns + m_max_delay_ns;
+            m_capped++;
+        }
+        due = std::max(due, spaced);
+    }
+    paced.due_ns = due;
+
+    m_have_last = true;
+    m_last_timestamp_ms = event.timestamp_ms;
+    m_last_due_ns = due;
+    m_queue.push_back(paced);
+}
+
+bool InputPacer::pop_due(uint64_t now_ns, InputEvent& out) {
+    if (m_queue.empty() || m_queue.front().due_ns > now_ns) {
+        return false;
+    }
+    const Paced& paced = m_queue.front();
+    out = paced.event;
+    m_hold.record(now_ns > paced.received_ns ? (now_ns - paced.received_ns) / 1000 : 0);
+    m_queue.pop_front();
+    return true;
+}
+
+void InputPacer::reset() {
+    m_queue.clear();
+    m_have_last = false;
+}
+
+}  // namespace stream_tablet
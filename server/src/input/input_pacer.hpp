@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../network/input_receiver.hpp"
+#include "../util/latency_histogram.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+namespace stream_tablet {
+
+// Releases stylus samples at their original spacing. Android hands the
+// client a vsync's worth of pen history at once, so without this uinput
+// sees several samples within microseconds and then nothing for the rest
+// of the frame, and apps derive velocity (and pressure dynamics) from
+// those bursts.
+//
+// Each sample is due at the previous sample's due time plus the client
+// timestamp difference, but never before it arrived and never more than
+// max_delay after. A late batch therefore restarts the schedule at its
+// arrival; an early one is spread over the time it covers. The added delay
+// is at most one batch's span (bounded by max_delay).
+class InputPacer {
+public:
+    InputPacer() = default;
+
+    void set_max_delay_us(int us) { m_max_delay_ns = static_cast<uint64_t>(us < 0 ? 0 : us) * 1000; }
+
+    // Queue a sample received at now_ns (CLOCK_MONOTONIC). Samples come out
+    // in the order they went in.
+    void push(const InputEvent& event, uint64_t now_ns);
+
+    // Take the next sample if it is due by now_ns
+    bool pop_due(uint64_t now_ns, InputEvent& out);
+
+    // Due time of the next sample (0 = queue empty)
+    uint64_t next_due_ns() const { return m_queue.empty() ? 0 : m_queue.front().due_ns; }
+
+    bool empty() const { return m_queue.empty(); }
+    size_t size() const { return m_queue.size(); }
+
+    // Drop queued samples and start a new schedule
+    void reset();
+
+    // Time samples were held, and how many hit the max_delay bound
+    LatencyHistogram::Snapshot get_hold_stats(bool reset = false) { return m_hold.snapshot(reset); }
+    uint64_t take_capped() { return m_capped.exchange(0); }
+
+private:
+    struct Paced {
+        InputEvent event;
+        uint64_t received_ns = 0;
+        uint64_t due_ns = 0;
+    };
+
+    std::deque<Paced> m_queue;
+    uint64_t m_max_delay_ns = 8000000;
+
+    bool m_have_last = false;
+    uint32_t m_last_timestamp_ms = 0;
+    uint64_t m_last_due_ns = 0;
+
+    LatencyHistogram m_hold;
+    std::atomic<uint64_t> m_capped{0};
+};
+
+}  // namespace stream_tablet
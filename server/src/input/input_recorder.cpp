@@ -0,0 +1,121 @@
+#include "input_recorder.hpp"
+#include "../network/input_codec.hpp"
+#include "../util/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace stream_tablet {
+
+static constexpr size_t HEADER_SIZE = 16;
+static constexpr size_t RECORD_SIZE = 4 + sizeof(InputEventPacket);
+static constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+bool InputRecorder::open(const std::string& path) {
+    close();
+    m_file = fopen(path.c_str(), "wbe");
+    if (!m_file) {
+        LOG_ERROR("Cannot create input recording %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    setvbuf(m_file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+    uint8_t header[HEADER_SIZE] = {};
+    memcpy(header, INPUT_RECORDING_MAGIC, 4);
+    header[4] = INPUT_RECORDING_VERSION & 0xFF;
+    header[5] = INPUT_RECORDING_VERSION >> 8;
+    header[6] = RECORD_SIZE & 0xFF;
+    header[7] = RECORD_SIZE >> 8;
+    if (fwrite(header, sizeof(header), 1, m_file) != 1) {
+        LOG_ERROR("Cannot write input recording %s: %s", path.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    m_last_ns = 0;
+    m_recorded = 0;
+    m_write_failed = false;
+    LOG_INFO("Recording input to %s", path.c_str());
+    return true;
+}
+
+void InputRecorder::close() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+        LOG_INFO("Input recording closed: %lu events", m_recorded);
+    }
+}
+
+void InputRecorder::record(const InputEvent& event) {
+    if (!m_file || m_write_failed) {
+        return;
+    }
+
+    uint64_t delta_us = 0;
+    if (m_recorded > 0 && event.received_ns > m_last_ns) {
+        delta_us = std::min<uint64_t>((event.received_ns - m_last_ns) / 1000, UINT32_MAX);
+    }
+    m_last_ns = event.received_ns;
+
+    uint8_t record[RECORD_SIZE];
+    uint32_t delta = static_cast<uint32_t>(delta_us);
+    for (int i = 0; i < 4; i++) {
+        record[i] = static_cast<uint8_t>(delta >> (8 * i));
+    }
+    InputEventPacket packet;
+    encode_legacy_packet(event, packet);
+    memcpy(record + 4, &packet, sizeof(packet));
+
+    if (fwrite(record, sizeof(record), 1, m_file) != 1) {
+        LOG_WARN("Input recording stopped: %s", strerror(errno));
+        m_write_failed = true;
+        return;
+    }
+    m_recorded++;
+}
+
+bool read_input_recording(const std::string& path, std::vector<RecordedInput>& out) {
+    FILE* f = fopen(path.c_str(), "rbe");
+    if (!f) {
+        return false;
+    }
+
+    // Newer versions may append fields to each record; they are skipped
+    uint8_t header[HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, f) != 1 || memcmp(header, INPUT_RECORDING_MAGIC, 4) != 0 ||
+        (header[4] | (header[5] << 8)) < INPUT_RECORDING_VERSION) {
+        fclose(f);
+        return false;
+    }
+    size_t record_size = header[6] | (header[7] << 8);
+    if (record_size < RECORD_SIZE) {
+        fclose(f);
+        return false;
+    }
+
+    std::vector<uint8_t> record(record_size);
+    uint64_t offset_us = 0;
+    bool first = true;
+    while (fread(record.data(), record_size, 1, f) == 1) {
+        uint32_t delta = static_cast<uint32_t>(record[0]) | (static_cast<uint32_t>(record[1]) << 8) |
+                         (static_cast<uint32_t>(record[2]) << 16) | (static_cast<uint32_t>(record[3]) << 24);
+        offset_us += first ? 0 : delta;
+        first = false;
+
+        InputEventPacket packet;
+        memcpy(&packet, record.data() + 4, sizeof(packet));
+        RecordedInput entry;
+        entry.offset_us = offset_us;
+        decode_legacy_packet(packet, entry.event);
+        out.push_back(entry);
+    }
+    fclose(f);
+    return true;
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../network/input_receiver.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace stream_tablet {
+
+// Input recording file (little-endian):
+//
+//   header: [magic:4 = "STIR"][version:2 = 1][record_size:2 = 32][reserved:8]
+//   record: [delta_us:4][InputEventPacket:28]
+//
+// delta_us is the receive time since the previous record (the first record
+// has 0; saturates at ~71 minutes). Events are stored as decoded, before
+// coalescing, with the client's own timestamps. Readers accept any later
+// version whose records start with these 32 bytes.
+constexpr char INPUT_RECORDING_MAGIC[4] = {'S', 'T', 'I', 'R'};
+constexpr uint16_t INPUT_RECORDING_VERSION = 1;
+
+struct RecordedInput {
+    uint64_t offset_us = 0;   // Receive time since the first record
+    InputEvent event = {};
+};
+
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder();
+
+    // Create (truncate) the file and write the header
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return m_file != nullptr; }
+
+    // Append one event (buffered; the stdio buffer absorbs thousands of
+    // events between writes)
+    void record(const InputEvent& event);
+
+    uint64_t get_recorded() const { return m_recorded; }
+
+private:
+    FILE* m_file = nullptr;
+    uint64_t m_last_ns = 0;
+    uint64_t m_recorded = 0;
+    bool m_write_failed = false;
+};
+
+// Load a whole recording (tools). Returns false if the file is missing or
+// not a recording; a truncated last record is ignored.
+bool read_input_recording(const std::string& path, std::vector<RecordedInput>& out);
+
+}  // namespace stream_tablet
@@ -0,0 +1,134 @@
+#include "stylus_predictor.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace stream_tablet {
+
+// Longer gaps than this start a new track (lost packets, pen paused)
+static constexpr uint32_t MAX_SAMPLE_GAP_MS = 50;
+
+// Samples before predictions are trusted (velocity and acceleration need
+// a few observations to converge)
+static constexpr int SETTLE_SAMPLES = 3;
+
+void StylusPredictor::Axis::init(float position, float sigma) {
+    state[0] = position;
+    state[1] = 0.0f;
+    state[2] = 0.0f;
+    for (auto& row : cov) {
+        for (float& v : row) v = 0.0f;
+    }
+    cov[0][0] = sigma * sigma;
+    cov[1][1] = 1.0f;     // Unknown velocity: up to ~1 screen/s
+    cov[2][2] = 100.0f;   // Unknown acceleration
+}
+
+void StylusPredictor::Axis::predict(float dt, float jerk) {
+    // x' = F x with F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+    const float dt2 = dt * dt / 2.0f;
+    state[0] += state[1] * dt + state[2] * dt2;
+    state[1] += state[2] * dt;
+
+    // P' = F P F^T + Q
+    float f[3][3] = {{1.0f, dt, dt2}, {0.0f, 1.0f, dt}, {0.0f, 0.0f, 1.0f}};
+    float fp[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            fp[i][j] = f[i][0] * cov[0][j] + f[i][1] * cov[1][j] + f[i][2] * cov[2][j];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            cov[i][j] = fp[i][0] * f[j][0] + fp[i][1] * f[j][1] + fp[i][2] * f[j][2];
+        }
+    }
+
+    // White jerk noise
+    const float t1 = dt, t2 = t1 * dt, t3 = t2 * dt, t4 = t3 * dt, t5 = t4 * dt;
+    const float q[3][3] = {{t5 / 20.0f, t4 / 8.0f, t3 / 6.0f},
+                           {t4 / 8.0f, t3 / 3.0f, t2 / 2.0f},
+                           {t3 / 6.0f, t2 / 2.0f, t1}};
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            cov[i][j] += jerk * q[i][j];
+        }
+    }
+}
+
+void StylusPredictor::Axis::correct(float measured, float sigma) {
+    // Position-only measurement: H = [1 0 0]
+    const float s = cov[0][0] + sigma * sigma;
+    const float k[3] = {cov[0][0] / s, cov[1][0] / s, cov[2][0] / s};
+    const float residual = measured - state[0];
+    for (int i = 0; i < 3; i++) {
+        state[i] += k[i] * residual;
+    }
+
+    const float row0[3] = {cov[0][0], cov[0][1], cov[0][2]};
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            cov[i][j] -= k[i] * row0[j];
+        }
+    }
+}
+
+float StylusPredictor::Axis::extrapolate(float t) const {
+    return state[0] + state[1] * t + state[2] * t * t / 2.0f;
+}
+
+void StylusPredictor::reset() {
+    m_active = false;
+    m_samples = 0;
+}
+
+bool StylusPredictor::update(float x, float y, uint32_t timestamp_ms, float& out_x, float& out_y) {
+    out_x = x;
+    out_y = y;
+
+    if (m_active && (timestamp_ms < m_last_ms || timestamp_ms - m_last_ms > MAX_SAMPLE_GAP_MS)) {
+        reset();
+    }
+
+    if (!m_active) {
+        m_x.init(x, m_sigma);
+        m_y.init(y, m_sigma);
+        m_active = true;
+        m_last_ms = timestamp_ms;
+        m_samples = 1;
+        return false;
+    }
+
+    // Samples within the same millisecond only refine the estimate
+    float dt = (timestamp_ms - m_last_ms) / 1000.0f;
+    if (dt > 0.0f) {
+        m_x.predict(dt, m_jerk);
+        m_y.predict(dt, m_jerk);
+        m_last_ms = timestamp_ms;
+    }
+    m_x.correct(x, m_sigma);
+    m_y.correct(y, m_sigma);
+    m_samples++;
+
+    if (m_samples < SETTLE_SAMPLES || m_horizon_s <= 0.0f) {
+        return false;
+    }
+
+    float px = m_x.extrapolate(m_horizon_s);
+    float py = m_y.extrapolate(m_horizon_s);
+
+    // Never lead the real pen by more than the cap
+    float dx = px - x;
+    float dy = py - y;
+    float distance = std::sqrt(dx * dx + dy * dy);
+    if (distance > m_max_distance) {
+        float scale = m_max_distance / distance;
+        px = x + dx * scale;
+        py = y + dy * scale;
+    }
+
+    out_x = std::clamp(px, 0.0f, 1.0f);
+    out_y = std::clamp(py, 0.0f, 1.0f);
+    return true;
+}
+
+}  // namespace stream_tablet
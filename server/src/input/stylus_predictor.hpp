@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+namespace stream_tablet {
+
+// Extrapolates pen position a few milliseconds ahead to hide network latency.
+// Each axis runs a constant-acceleration Kalman filter over the client
+// timestamps; the prediction is the filtered position advanced by the
+// horizon, capped so a sudden stop can't fling the cursor far off the stroke.
+// Coordinates are normalized (0-1), like InputEvent.
+class StylusPredictor {
+public:
+    StylusPredictor() = default;
+
+    void set_horizon_ms(float ms) { m_horizon_s = ms / 1000.0f; }
+    float get_horizon_ms() const { return m_horizon_s * 1000.0f; }
+
+    // Start of a new stroke (pen down, gap in samples)
+    void reset();
+
+    // Feed a true sample and get the predicted position. Returns false while
+    // the filter is still settling (first samples of a stroke); out_x/out_y
+    // are then the true position.
+    bool update(float x, float y, uint32_t timestamp_ms, float& out_x, float& out_y);
+
+    // Tuning
+    void set_process_noise(float jerk) { m_jerk = jerk; }
+    void set_measurement_noise(float sigma) { m_sigma = sigma; }
+    void set_max_distance(float distance) { m_max_distance = distance; }
+
+private:
+    // Position/velocity/acceleration along one axis
+    struct Axis {
+        float state[3] = {0.0f, 0.0f, 0.0f};
+        float cov[3][3] = {};
+
+        void init(float position, float sigma);
+        void predict(float dt, float jerk);
+        void correct(float measured, float sigma);
+        float extrapolate(float t) const;
+    };
+
+    Axis m_x;
+    Axis m_y;
+    bool m_active = false;
+    uint32_t m_last_ms = 0;
+    int m_samples = 0;
+
+    float m_horizon_s = 0.0f;
+    float m_jerk = 20000.0f;        // Process noise: jerk spectral density (screens/s^3)
+    float m_sigma = 0.0005f;        // Measurement noise: ~0.5 px on a 1000 px axis
+    float m_max_distance = 0.03f;   // Cap on how far ahead of the pen we draw
+};
+
+}  // namespace stream_tablet
@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <cmath>
+#include <cerrno>
 
 namespace stream_tablet {
 
@@ -282,12 +283,55 @@ void UInputBackend::destroy_touch_device() {
     }
 }
 
+EventBatch& UInputBackend::batch_for(int fd) {
+    if (fd == m_stylus_fd) return m_stylus_batch;
+    if (fd == m_mouse_fd) return m_mouse_batch;
+    return m_touch_batch;
+}
+
 void UInputBackend::emit(int fd, int type, int code, int value) {
-    struct input_event ev = {};
+    EventBatch& batch = batch_for(fd);
+    if (batch.count == EventBatch::MAX_EVENTS) {
+        // Oversized report: the kernel only acts on SYN_REPORT, so an early
+        // partial write is still applied atomically
+        flush(fd, batch);
+    }
+
+    struct input_event& ev = batch.events[batch.count++];
+    memset(&ev, 0, sizeof(ev));
     ev.type = type;
     ev.code = code;
     ev.value = value;
-    write(fd, &ev, sizeof(ev));
+
+    if (type == EV_SYN && code == SYN_REPORT) {
+        flush(fd, batch);
+    }
+}
+
+void UInputBackend::flush(int fd, EventBatch& batch) {
+    if (batch.count == 0) {
+        return;
+    }
+    size_t size = sizeof(struct input_event) * batch.count;
+    ssize_t n = write(fd, batch.events, size);
+    m_writes++;
+    if (n != static_cast<ssize_t>(size)) {
+        m_write_errors++;
+        if (m_write_errors == 1 || m_write_errors % 1000 == 0) {
+            LOG_WARN("uinput write failed (%lu so far): %s", m_write_errors,
+                     n < 0 ? strerror(errno) : "short write");
+        }
+    }
+    batch.count = 0;
+}
+
+void UInputBackend::attach_fds(int stylus_fd, int mouse_fd, int touch_fd,
+                               int screen_width, int screen_height) {
+    m_stylus_fd = stylus_fd;
+    m_mouse_fd = mouse_fd;
+    m_touch_fd = touch_fd;
+    m_screen_width = screen_width;
+    m_screen_height = screen_height;
 }
 
 // Transform screen coordinates to 0-65535 range
@@ -476,10 +520,6 @@ void UInputBackend::reset_all() {
     LOG_DEBUG("Reset all input state");
 }
 
-void UInputBackend::sync() {
-    // Each device syncs itself after events
-}
-
 void UInputBackend::shutdown() {
     reset_all();
     destroy_touch_device();
@@ -2,9 +2,17 @@
 
 #include <cstdint>
 #include <string>
+#include <linux/input.h>
 
 namespace stream_tablet {
 
+// Events of one report, written with a single write() at SYN_REPORT
+struct EventBatch {
+    static constexpr int MAX_EVENTS = 32;
+    struct input_event events[MAX_EVENTS];
+    int count = 0;
+};
+
 // Multi-touch slot state
 struct TouchSlot {
     bool active = false;
@@ -30,8 +38,13 @@ public:
     // Release all pressed buttons and tools (call on disconnect/shutdown)
     void reset_all();
 
-    // Sync events (call after sending events)
-    void sync();
+    // Benchmarks: drive already-open fds (e.g. pipes) instead of creating
+    // uinput devices. The backend takes ownership of the fds.
+    void attach_fds(int stylus_fd, int mouse_fd, int touch_fd, int screen_width, int screen_height);
+
+    // Statistics
+    uint64_t get_writes() const { return m_writes; }
+    uint64_t get_write_errors() const { return m_write_errors; }
 
     // Shutdown
     void shutdown();
@@ -41,7 +54,10 @@ public:
     }
 
 private:
+    // Queue an event; SYN_REPORT flushes the device's batch
     void emit(int fd, int type, int code, int value);
+    void flush(int fd, EventBatch& batch);
+    EventBatch& batch_for(int fd);
     int transform_coord(int val, int max);
 
     bool init_stylus_device();
@@ -65,6 +81,14 @@ private:
 
     // Touch state (5 slots like Weylus)
     TouchSlot m_touch_slots[5] = {};
+
+    // Pending report per device
+    EventBatch m_stylus_batch;
+    EventBatch m_mouse_batch;
+    EventBatch m_touch_batch;
+
+    uint64_t m_writes = 0;
+    uint64_t m_write_errors = 0;
 };
 
 }  // namespace stream_tablet
@@ -4,9 +4,42 @@
 #include <cstdlib>
 #include <cstring>
 #include <getopt.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <vector>
 
 using namespace stream_tablet;
 
+// Long-only options (no short equivalent)
+enum {
+    OPT_ECN_IMPAIR = 256,
+    OPT_MULTICAST_PORT,
+    OPT_MULTICAST_TTL,
+    OPT_FEC,
+    OPT_SIMULCAST,
+    OPT_COALESCE,
+    OPT_INPUT_POLL,
+    OPT_INPUT_RT,
+    OPT_PREDICT,
+    OPT_LEGACY_INPUT,
+    OPT_TCP_INPUT,
+    OPT_INPUT_TRIGGER,
+    OPT_TRIGGER_MAX_FPS,
+    OPT_RECORD_INPUT,
+    OPT_UINPUT_SINK,
+    OPT_NO_CLOCK_SYNC,
+    OPT_PACE_INPUT,
+    OPT_RESUME_GRACE,
+    OPT_HEARTBEAT,
+    OPT_HEARTBEAT_MISSES,
+    OPT_QP_RANGE,
+    OPT_ADMIN_SOCKET,
+    OPT_TLS,
+    OPT_TLS_CERT,
+    OPT_TLS_KEY,
+    OPT_NO_EARLY_DATA
+};
+
 static Server* g_server = nullptr;
 static volatile sig_atomic_t g_signal_count = 0;
 
@@ -30,6 +63,45 @@ static void signal_handler(int sig) {
     }
 }
 
+// Parse "SCALE:BITRATE[,SCALE:BITRATE...]", bitrate in bps with optional k/M suffix
+static bool parse_simulcast(const char* arg, std::vector<SimulcastRung>& rungs) {
+    rungs.clear();
+    const char* p = arg;
+    while (*p) {
+        char* end = nullptr;
+        SimulcastRung rung;
+        rung.scale = strtof(p, &end);
+        if (end == p || *end != ':' || rung.scale <= 0.0f || rung.scale > 1.0f) {
+            return false;
+        }
+        p = end + 1;
+        double bitrate = strtod(p, &end);
+        if (end == p || bitrate <= 0.0) {
+            return false;
+        }
+        if (*end == 'k' || *end == 'K') {
+            bitrate *= 1e3;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            bitrate *= 1e6;
+            end++;
+        }
+        rung.bitrate = static_cast<int>(bitrate);
+        rungs.push_back(rung);
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return false;
+        }
+        p = end;
+    }
+    // Highest bitrate first: rung 0 is the full-resolution encode
+    std::sort(rungs.begin(), rungs.end(), [](const SimulcastRung& a, const SimulcastRung& b) {
+        return a.bitrate > b.bitrate;
+    });
+    return !rungs.empty() && rungs.size() <= 4;
+}
+
 static void print_usage(const char* prog) {
     printf("Usage: %s [options]\n", prog);
     printf("Options:\n");
@@ -42,7 +114,47 @@ static void print_usage(const char* prog) {
     printf("  -q, --quality MODE      Quality mode: auto, low, balanced, high (default: auto)\n");
     printf("                          auto = adaptive CQP (sharp text + smooth motion)\n");
     printf("  -Q, --cqp VALUE         CQP quality value for auto/high mode, 1-51 (default: 24)\n");
+    printf("      --qp-range MIN:MAX  Keep the encoder QP within MIN-MAX in every mode (default: 1:51)\n");
     printf("  -P, --pacing MODE       Pacing mode: auto, none, light, aggressive, keyframe (default: auto)\n");
+    printf("  -E, --egress MODE       Egress scheduling: off, strict, weighted (default: off)\n");
+    printf("  -M, --mux               Multiplex video/audio/feedback on one UDP port (if client supports it;\n");
+    printf("                          input stays on its own port)\n");
+    printf("  -N, --ecn               Mark video ECT(1) and back off on CE marks (if client supports it)\n");
+    printf("      --ecn-impair PCT    Testing: send PCT%% of video packets already CE-marked\n");
+    printf("  -m, --multicast GROUP   Send video to an IPv4 multicast group (if client supports it)\n");
+    printf("      --multicast-port N  Multicast destination port (default: 9504)\n");
+    printf("      --multicast-ttl N   Multicast TTL (default: 1)\n");
+    printf("      --fec N             Multicast parity every N packets, 0 = off (default: adaptive)\n");
+    printf("  -C, --max-clients N     Fan one encode out to up to N clients (default: 1)\n");
+    printf("      --simulcast LADDER  Encode rungs SCALE:BITRATE,... and serve each client the\n");
+    printf("                          rung its link sustains, e.g. 1.0:20M,0.5:5M,0.25:1.5M\n");
+    printf("                          (highest bitrate rung is always full resolution)\n");
+    printf("      --coalesce US       Merge stylus/touch moves per pointer, holding samples up to\n");
+    printf("                          US microseconds (0 = per receive batch; default: off)\n");
+    printf("      --pace-input US     Replay batched stylus samples at their original spacing,\n");
+    printf("                          holding each at most US microseconds (e.g. 8000)\n");
+    printf("      --predict MS        Draw the stylus MS ahead of the last sample while inking, 1-50\n");
+    printf("      --input-trigger US  Capture US microseconds after input instead of waiting for\n");
+    printf("                          the next frame tick (lower pen-to-screen latency)\n");
+    printf("      --trigger-max-fps N Frame rate cap with --input-trigger (default: --fps; above it,\n");
+    printf("                          the bitrate rises while drawing)\n");
+    printf("      --input-rt PRIO     Run the input thread SCHED_FIFO at PRIO, 1-99 (needs CAP_SYS_NICE)\n");
+    printf("      --input-poll        Poll input from the frame loop instead of its own thread\n");
+    printf("      --record-input FILE Record received input events for stream_tablet_input_replay\n");
+    printf("      --uinput-sink FILE  Write input events to FILE instead of /dev/uinput\n");
+    printf("      --legacy-input      Always use 28-byte input packets (no compact format)\n");
+    printf("      --tcp-input         Always receive input over TCP (no UDP input)\n");
+    printf("      --no-clock-sync     Don't measure the client clock offset\n");
+    printf("      --resume-grace MS   Keep a dropped client's session MS for a quick reconnect,\n");
+    printf("                          0 = off (default: 10000)\n");
+    printf("      --heartbeat MS      Ping clients every MS and idle the pipeline when all are\n");
+    printf("                          silent, 0 = off (default: 1000)\n");
+    printf("      --heartbeat-misses N Missed heartbeats before a client counts as silent (default: 3)\n");
+    printf("      --admin-socket PATH Serve stats and live tuning on a UNIX socket (see stream_tablet_ctl)\n");
+    printf("      --tls               Use TLS 1.3 on the control channel (needs a TLS client)\n");
+    printf("      --tls-cert FILE     Certificate for --tls (default: server.crt)\n");
+    printf("      --tls-key FILE      Private key for --tls (default: server.key)\n");
+    printf("      --no-early-data     Don't accept the config request as TLS 0-RTT data\n");
     printf("  -p, --port PORT         Control port (default: 9500)\n");
     printf("  -A, --no-audio          Disable audio streaming\n");
     printf("  -a, --audio-bitrate BPS Audio bitrate in bps (default: 128000)\n");
@@ -65,6 +177,10 @@ static void print_usage(const char* prog) {
     printf("  none      No pacing - fastest, use for fast local networks\n");
     printf("  light     Light pacing - for WiFi connections\n");
     printf("  aggressive Aggressive pacing - for slow USB tethering\n");
+    printf("\nEgress scheduling (audio > delta video > keyframes):\n");
+    printf("  off       Each stream writes directly to its own socket\n");
+    printf("  strict    Strict priority queues with DSCP/SO_PRIORITY marking per class\n");
+    printf("  weighted  Weighted round robin between classes (keyframes cannot starve)\n");
     printf("\nVideo codecs:\n");
     printf("  auto      Auto-select best available (AV1 > HEVC > H.264)\n");
     printf("  av1       AV1 - best quality/compression, slower encoding\n");
@@ -85,7 +201,38 @@ int main(int argc, char* argv[]) {
         {"gop", required_argument, 0, 'g'},
         {"quality", required_argument, 0, 'q'},
         {"cqp", required_argument, 0, 'Q'},
+        {"qp-range", required_argument, 0, OPT_QP_RANGE},
         {"pacing", required_argument, 0, 'P'},
+        {"egress", required_argument, 0, 'E'},
+        {"mux", no_argument, 0, 'M'},
+        {"ecn", no_argument, 0, 'N'},
+        {"ecn-impair", required_argument, 0, OPT_ECN_IMPAIR},
+        {"multicast", required_argument, 0, 'm'},
+        {"max-clients", required_argument, 0, 'C'},
+        {"multicast-port", required_argument, 0, OPT_MULTICAST_PORT},
+        {"multicast-ttl", required_argument, 0, OPT_MULTICAST_TTL},
+        {"fec", required_argument, 0, OPT_FEC},
+        {"simulcast", required_argument, 0, OPT_SIMULCAST},
+        {"coalesce", required_argument, 0, OPT_COALESCE},
+        {"pace-input", required_argument, 0, OPT_PACE_INPUT},
+        {"input-rt", required_argument, 0, OPT_INPUT_RT},
+        {"predict", required_argument, 0, OPT_PREDICT},
+        {"input-poll", no_argument, 0, OPT_INPUT_POLL},
+        {"legacy-input", no_argument, 0, OPT_LEGACY_INPUT},
+        {"tcp-input", no_argument, 0, OPT_TCP_INPUT},
+        {"record-input", required_argument, 0, OPT_RECORD_INPUT},
+        {"uinput-sink", required_argument, 0, OPT_UINPUT_SINK},
+        {"no-clock-sync", no_argument, 0, OPT_NO_CLOCK_SYNC},
+        {"resume-grace", required_argument, 0, OPT_RESUME_GRACE},
+        {"heartbeat", required_argument, 0, OPT_HEARTBEAT},
+        {"heartbeat-misses", required_argument, 0, OPT_HEARTBEAT_MISSES},
+        {"admin-socket", required_argument, 0, OPT_ADMIN_SOCKET},
+        {"tls", no_argument, 0, OPT_TLS},
+        {"tls-cert", required_argument, 0, OPT_TLS_CERT},
+        {"tls-key", required_argument, 0, OPT_TLS_KEY},
+        {"no-early-data", no_argument, 0, OPT_NO_EARLY_DATA},
+        {"input-trigger", required_argument, 0, OPT_INPUT_TRIGGER},
+        {"trigger-max-fps", required_argument, 0, OPT_TRIGGER_MAX_FPS},
         {"port", required_argument, 0, 'p'},
         {"no-audio", no_argument, 0, 'A'},
         {"audio-bitrate", required_argument, 0, 'a'},
@@ -99,7 +246,7 @@ int main(int argc, char* argv[]) {
     int verbosity = 0;
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "d:c:e:f:b:g:q:Q:P:p:Aa:vh", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "d:c:e:f:b:g:q:Q:P:E:MNm:C:p:Aa:vh", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'd':
                 config.display = optarg;
@@ -165,6 +312,13 @@ int main(int argc, char* argv[]) {
                 if (config.cqp < 1) config.cqp = 1;
                 if (config.cqp > 51) config.cqp = 51;
                 break;
+            case OPT_QP_RANGE:
+                if (sscanf(optarg, "%d:%d", &config.qp_min, &config.qp_max) != 2 ||
+                    config.qp_min < 1 || config.qp_max > 51 || config.qp_min > config.qp_max) {
+                    fprintf(stderr, "Invalid QP range: %s (expected MIN:MAX within 1-51)\n", optarg);
+                    return 1;
+                }
+                break;
             case 'P':
                 if (strcmp(optarg, "auto") == 0) {
                     config.pacing_mode = 0;
@@ -182,6 +336,140 @@ int main(int argc, char* argv[]) {
                     return 1;
                 }
                 break;
+            case 'E':
+                if (strcmp(optarg, "off") == 0) {
+                    config.egress_mode = 0;
+                } else if (strcmp(optarg, "strict") == 0) {
+                    config.egress_mode = 1;
+                } else if (strcmp(optarg, "weighted") == 0) {
+                    config.egress_mode = 2;
+                } else {
+                    fprintf(stderr, "Unknown egress mode: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'M':
+                config.udp_mux = true;
+                break;
+            case 'N':
+                config.ecn = true;
+                break;
+            case OPT_ECN_IMPAIR:
+                config.ecn_impair_ce = static_cast<float>(atof(optarg)) / 100.0f;
+                if (config.ecn_impair_ce < 0.0f) config.ecn_impair_ce = 0.0f;
+                if (config.ecn_impair_ce > 1.0f) config.ecn_impair_ce = 1.0f;
+                break;
+            case 'm': {
+                struct in_addr group = {};
+                if (inet_pton(AF_INET, optarg, &group) != 1 || !IN_MULTICAST(ntohl(group.s_addr))) {
+                    fprintf(stderr, "Invalid multicast group: %s (expected 224.0.0.0-239.255.255.255)\n", optarg);
+                    return 1;
+                }
+                config.multicast_group = optarg;
+                break;
+            }
+            case OPT_MULTICAST_PORT:
+                config.multicast_port = static_cast<uint16_t>(atoi(optarg));
+                break;
+            case OPT_MULTICAST_TTL:
+                config.multicast_ttl = atoi(optarg);
+                if (config.multicast_ttl < 1) config.multicast_ttl = 1;
+                if (config.multicast_ttl > 255) config.multicast_ttl = 255;
+                break;
+            case OPT_FEC:
+                config.fec_group = atoi(optarg);
+                if (config.fec_group < 0) config.fec_group = 0;
+                break;
+            case OPT_SIMULCAST:
+                if (!parse_simulcast(optarg, config.simulcast_rungs)) {
+                    fprintf(stderr, "Invalid simulcast ladder: %s (expected 1-4 SCALE:BITRATE entries)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_COALESCE:
+                config.input_coalesce_us = atoi(optarg);
+                if (config.input_coalesce_us < 0) config.input_coalesce_us = 0;
+                if (config.input_coalesce_us > 50000) config.input_coalesce_us = 50000;
+                break;
+            case OPT_PACE_INPUT:
+                config.input_pace_us = atoi(optarg);
+                if (config.input_pace_us < 0) config.input_pace_us = 0;
+                if (config.input_pace_us > 50000) config.input_pace_us = 50000;
+                break;
+            case OPT_INPUT_RT:
+                config.input_rt_priority = atoi(optarg);
+                if (config.input_rt_priority < 0) config.input_rt_priority = 0;
+                if (config.input_rt_priority > 99) config.input_rt_priority = 99;
+                break;
+            case OPT_PREDICT:
+                config.stylus_predict_ms = atoi(optarg);
+                if (config.stylus_predict_ms < 0) config.stylus_predict_ms = 0;
+                if (config.stylus_predict_ms > 50) config.stylus_predict_ms = 50;
+                break;
+            case OPT_INPUT_POLL:
+                config.input_thread = false;
+                break;
+            case OPT_LEGACY_INPUT:
+                config.compact_input = false;
+                break;
+            case OPT_TCP_INPUT:
+                config.udp_input = false;
+                break;
+            case OPT_RECORD_INPUT:
+                config.input_record_path = optarg;
+                break;
+            case OPT_UINPUT_SINK:
+                config.uinput_sink = optarg;
+                break;
+            case OPT_NO_CLOCK_SYNC:
+                config.clock_sync = false;
+                break;
+            case OPT_RESUME_GRACE:
+                config.resume_grace_ms = atoi(optarg);
+                if (config.resume_grace_ms < 0) config.resume_grace_ms = 0;
+                if (config.resume_grace_ms > 600000) config.resume_grace_ms = 600000;
+                break;
+            case OPT_HEARTBEAT:
+                config.heartbeat_ms = atoi(optarg);
+                if (config.heartbeat_ms < 0) config.heartbeat_ms = 0;
+                if (config.heartbeat_ms > 60000) config.heartbeat_ms = 60000;
+                break;
+            case OPT_HEARTBEAT_MISSES:
+                config.heartbeat_misses = atoi(optarg);
+                if (config.heartbeat_misses < 1) config.heartbeat_misses = 1;
+                if (config.heartbeat_misses > 100) config.heartbeat_misses = 100;
+                break;
+            case OPT_ADMIN_SOCKET:
+                config.admin_socket = optarg;
+                break;
+            case OPT_TLS:
+                config.tls = true;
+                break;
+            case OPT_TLS_CERT:
+                config.cert_file = optarg;
+                break;
+            case OPT_TLS_KEY:
+                config.key_file = optarg;
+                break;
+            case OPT_NO_EARLY_DATA:
+                config.tls_early_data = false;
+                break;
+            case OPT_INPUT_TRIGGER:
+                config.input_trigger_us = atoi(optarg);
+                if (config.input_trigger_us < 0) config.input_trigger_us = 0;
+                if (config.input_trigger_us > 50000) config.input_trigger_us = 50000;
+                break;
+            case OPT_TRIGGER_MAX_FPS:
+                config.input_trigger_max_fps = atoi(optarg);
+                if (config.input_trigger_max_fps < 1) config.input_trigger_max_fps = 1;
+                if (config.input_trigger_max_fps > 240) config.input_trigger_max_fps = 240;
+                break;
+            case 'C':
+                config.max_clients = atoi(optarg);
+                if (config.max_clients < 1) config.max_clients = 1;
+                if (config.max_clients > 16) config.max_clients = 16;
+                break;
             case 'p':
                 config.control_port = static_cast<uint16_t>(atoi(optarg));
                 config.video_port = config.control_port + 1;
@@ -240,6 +528,8 @@ int main(int argc, char* argv[]) {
         if (config.gop_size < 1) config.gop_size = 1;
     }
 
+    config.cqp = std::clamp(config.cqp, config.qp_min, config.qp_max);
+
     // For AUTO mode, use keyframe pacing by default if not explicitly set
     if (config.quality_mode == QualityMode::AUTO && config.pacing_mode == 0) {
         config.pacing_mode = 4;  // KEYFRAME pacing
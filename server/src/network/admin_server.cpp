@@ -0,0 +1,345 @@
+#include "admin_server.hpp"
+#include "../util/logger.hpp"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+namespace stream_tablet {
+
+// Admin tools connect briefly; a handful is plenty, and a line longer than
+// this is not a command
+static constexpr size_t MAX_CONNECTIONS = 8;
+static constexpr size_t MAX_LINE = 4096;
+
+AdminServer::~AdminServer() {
+    shutdown();
+}
+
+bool AdminServer::init(const std::string& path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Admin socket path is empty or too long: %s", path.c_str());
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // Replace a socket left behind by a server that died, but never a
+    // live one or something that isn't a socket
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            LOG_ERROR("Admin socket path %s exists and is not a socket", path.c_str());
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (live) {
+            LOG_ERROR("Admin socket %s is in use by another server", path.c_str());
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    m_listen_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_socket < 0) {
+        LOG_ERROR("Failed to create admin socket: %s", strerror(errno));
+        return false;
+    }
+    if (bind(m_listen_socket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOG_ERROR("Failed to bind admin socket %s: %s", path.c_str(), strerror(errno));
+        close(m_listen_socket);
+        m_listen_socket = -1;
+        return false;
+    }
+    m_path = path;
+    // Owner only: the socket can retune the stream. Nothing can connect
+    // before listen(), so the window between bind and chmod is harmless.
+    chmod(path.c_str(), S_IRUSR | S_IWUSR);
+    if (listen(m_listen_socket, 4) < 0) {
+        LOG_ERROR("Failed to listen on admin socket: %s", strerror(errno));
+        shutdown();
+        return false;
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_wake_fd < 0) {
+        LOG_ERROR("Failed to create admin epoll: %s", strerror(errno));
+        shutdown();
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wake_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &ev);
+    ev.data.fd = m_listen_socket;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_socket, &ev);
+
+    m_running = true;
+    m_thread = std::thread(&AdminServer::connection_thread, this);
+    LOG_INFO("Admin socket listening on %s", path.c_str());
+    return true;
+}
+
+void AdminServer::process() {
+    std::vector<Command> commands;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        commands.swap(m_commands);
+        m_pending.store(false, std::memory_order_relaxed);
+    }
+    if (commands.empty()) {
+        return;
+    }
+
+    std::vector<Reply> replies;
+    for (const Command& command : commands) {
+        std::vector<std::string> args;
+        std::istringstream words(command.line);
+        for (std::string word; words >> word;) {
+            args.push_back(word);
+        }
+
+        std::string reply;
+        std::string error = "no command handler";
+        bool ok = m_handler && m_handler(args, reply, error);
+        reply += ok ? "ok\n" : "error " + error + "\n";
+        replies.push_back({command.fd, command.id, std::move(reply)});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Reply& reply : replies) {
+            m_replies.push_back(std::move(reply));
+        }
+    }
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN("Failed to wake admin thread: %s", strerror(errno));
+    }
+}
+
+void AdminServer::connection_thread() {
+    struct epoll_event events[8];
+    while (m_running) {
+        int n = epoll_wait(m_epoll_fd, events, 8, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Admin epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n && m_running; i++) {
+            int fd = events[i].data.fd;
+            if (fd == m_wake_fd) {
+                uint64_t value;
+                while (read(m_wake_fd, &value, sizeof(value)) > 0) {}
+                deliver_replies();
+                continue;
+            }
+            if (fd == m_listen_socket) {
+                accept_connections();
+                continue;
+            }
+
+            auto it = m_connections.find(fd);
+            if (it == m_connections.end()) {
+                continue;  // Closed earlier in this batch
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!flush_connection(fd, it->second)) {
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read_connection(fd, it->second);
+            }
+        }
+    }
+}
+
+void AdminServer::accept_connections() {
+    while (true) {
+        int fd = accept4(m_listen_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_WARN("Admin accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        if (m_connections.size() >= MAX_CONNECTIONS) {
+            const char busy[] = "error too many admin connections\n";
+            send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        m_connections[fd].id = m_next_id++;
+        LOG_DEBUG("Admin connection %d opened", fd);
+    }
+}
+
+void AdminServer::read_connection(int fd, Connection& conn) {
+    char buffer[1024];
+    while (true) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.in.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        // Peer closed (or failed); a reply still in flight is dropped
+        close_connection(fd);
+        return;
+    }
+
+    if (conn.in.size() > MAX_LINE && conn.in.find('\n') == std::string::npos) {
+        conn.in.clear();
+        conn.out += "error line too long\n";
+        conn.closing = true;
+        flush_connection(fd, conn);
+        return;
+    }
+    queue_next_command(fd, conn);
+}
+
+void AdminServer::queue_next_command(int fd, Connection& conn) {
+    while (!conn.busy && !conn.closing) {
+        size_t end = conn.in.find('\n');
+        if (end == std::string::npos) {
+            return;
+        }
+        std::string line = conn.in.substr(0, end);
+        conn.in.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") == std::string::npos) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.push_back({fd, conn.id, std::move(line)});
+        m_pending.store(true, std::memory_order_relaxed);
+        conn.busy = true;
+    }
+}
+
+void AdminServer::deliver_replies() {
+    std::vector<Reply> replies;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        replies.swap(m_replies);
+    }
+    for (Reply& reply : replies) {
+        auto it = m_connections.find(reply.fd);
+        if (it == m_connections.end() || it->second.id != reply.id) {
+            continue;  // Asker went away
+        }
+        Connection& conn = it->second;
+        conn.out += reply.text;
+        conn.busy = false;
+        if (flush_connection(reply.fd, conn)) {
+            queue_next_command(reply.fd, conn);
+        }
+    }
+}
+
+bool AdminServer::flush_connection(int fd, Connection& conn) {
+    while (!conn.out.empty()) {
+        ssize_t n = send(fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            conn.out.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Slow reader: finish when the socket drains
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+            return true;
+        }
+        close_connection(fd);
+        return false;
+    }
+
+    if (conn.closing) {
+        close_connection(fd);
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    return true;
+}
+
+void AdminServer::close_connection(int fd) {
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    m_connections.erase(fd);
+    LOG_DEBUG("Admin connection %d closed", fd);
+}
+
+void AdminServer::shutdown() {
+    if (m_running) {
+        m_running = false;
+        uint64_t one = 1;
+        if (write(m_wake_fd, &one, sizeof(one)) < 0) {
+            LOG_WARN("Failed to wake admin thread: %s", strerror(errno));
+        }
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    for (const auto& entry : m_connections) {
+        close(entry.first);
+    }
+    m_connections.clear();
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    if (m_wake_fd >= 0) {
+        close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+    if (m_listen_socket >= 0) {
+        close(m_listen_socket);
+        m_listen_socket = -1;
+    }
+    if (!m_path.empty()) {
+        unlink(m_path.c_str());
+        m_path.clear();
+    }
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stream_tablet {
+
+// Local admin socket (UNIX domain, owner-only) with a line protocol: one
+// command per line, words separated by spaces. Each command is answered
+// with zero or more "key=value ..." lines and then "ok" or "error <reason>".
+//
+// Connections are served by a thread of their own. Commands are queued for
+// the thread that owns the pipeline, which runs them from process(), so a
+// handler can read and change stream state without locks and the stream
+// loop pays for the admin socket only when a command is waiting.
+class AdminServer {
+public:
+    // Run one command. Append reply lines (each ending in '\n') to 'reply';
+    // return false with the reason in 'error' to fail it.
+    using CommandHandler = std::function<bool(const std::vector<std::string>& args,
+                                              std::string& reply, std::string& error)>;
+
+    AdminServer() = default;
+    ~AdminServer();
+
+    AdminServer(const AdminServer&) = delete;
+    AdminServer& operator=(const AdminServer&) = delete;
+
+    // Listen on 'path' (a stale socket file there is replaced) and start
+    // the connection thread
+    bool init(const std::string& path);
+
+    void set_command_handler(CommandHandler cb) { m_handler = std::move(cb); }
+
+    // A command is waiting for process() (one relaxed load)
+    bool has_pending() const { return m_pending.load(std::memory_order_relaxed); }
+
+    // Run queued commands and hand the replies to the connection thread
+    void process();
+
+    void shutdown();
+
+private:
+    // A connection has at most one command in flight; further lines wait
+    // in 'in', which keeps replies in order and bounds the queue
+    struct Connection {
+        uint64_t id = 0;  // fds are reused, ids are not
+        std::string in;
+        std::string out;
+        bool busy = false;
+        bool closing = false;  // Close once 'out' is written
+    };
+    struct Command {
+        int fd;
+        uint64_t id;
+        std::string line;
+    };
+    struct Reply {
+        int fd;
+        uint64_t id;
+        std::string text;
+    };
+
+    void connection_thread();
+    void accept_connections();
+    void read_connection(int fd, Connection& conn);
+    void queue_next_command(int fd, Connection& conn);
+    void deliver_replies();
+    bool flush_connection(int fd, Connection& conn);  // false: connection closed
+    void close_connection(int fd);
+
+    std::string m_path;
+    int m_listen_socket = -1;
+    int m_epoll_fd = -1;
+    int m_wake_fd = -1;  // eventfd: replies ready or stop request
+
+    CommandHandler m_handler;
+
+    // Owned by the connection thread
+    std::map<int, Connection> m_connections;
+    uint64_t m_next_id = 1;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    // Hand-off between the connection thread and process()
+    std::mutex m_mutex;
+    std::vector<Command> m_commands;
+    std::vector<Reply> m_replies;
+    std::atomic<bool> m_pending{false};
+};
+
+}  // namespace stream_tablet
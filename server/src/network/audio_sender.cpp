@@ -1,5 +1,7 @@
 #include "audio_sender.hpp"
+#include "egress_scheduler.hpp"
 #include "../util/logger.hpp"
+#include "stream_tablet/config.hpp"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -52,15 +54,30 @@ void AudioSender::set_client(const std::string& host, uint16_t port) {
     LOG_INFO("Audio client set to %s:%d", host.c_str(), port);
 }
 
+void AudioSender::set_scheduler(EgressScheduler* scheduler) {
+    m_scheduler = scheduler;
+    if (m_scheduler) {
+        EgressScheduler::mark_socket(m_socket, TrafficClass::AUDIO);
+    }
+}
+
 bool AudioSender::send_packet(const uint8_t* data, size_t size,
                                uint32_t sequence, uint64_t timestamp_us) {
     if (!m_client_set || m_socket < 0) {
         return false;
     }
 
+    // Multiplexed mode: send on the shared socket with a stream id prefix
+    bool multiplexed = (m_shared_socket >= 0);
+    int fd = multiplexed ? m_shared_socket : m_socket;
+    size_t prefix_size = multiplexed ? 1 : 0;
+
     // Build packet with header
-    std::vector<uint8_t> packet(sizeof(AudioPacketHeader) + size);
-    AudioPacketHeader* header = reinterpret_cast<AudioPacketHeader*>(packet.data());
+    std::vector<uint8_t> packet(prefix_size + sizeof(AudioPacketHeader) + size);
+    if (multiplexed) {
+        packet[0] = STREAM_ID_AUDIO;
+    }
+    AudioPacketHeader* header = reinterpret_cast<AudioPacketHeader*>(packet.data() + prefix_size);
 
     header->magic = AUDIO_MAGIC;
     header->sequence = static_cast<uint16_t>(sequence & 0xFFFF);
@@ -71,10 +88,20 @@ bool AudioSender::send_packet(const uint8_t* data, size_t size,
     header->reserved = 0;
 
     // Copy payload
-    memcpy(packet.data() + sizeof(AudioPacketHeader), data, size);
+    memcpy(packet.data() + prefix_size + sizeof(AudioPacketHeader), data, size);
+
+    if (m_scheduler) {
+        if (!m_scheduler->enqueue(TrafficClass::AUDIO, fd, m_client_addr,
+                                  packet.data(), packet.size())) {
+            return false;
+        }
+        m_bytes_sent += packet.size();
+        m_packets_sent++;
+        return true;
+    }
 
     // Send
-    ssize_t sent = sendto(m_socket, packet.data(), packet.size(), 0,
+    ssize_t sent = sendto(fd, packet.data(), packet.size(), 0,
                           reinterpret_cast<struct sockaddr*>(&m_client_addr),
                           sizeof(m_client_addr));
     if (sent < 0) {
@@ -6,6 +6,8 @@
 
 namespace stream_tablet {
 
+class EgressScheduler;
+
 class AudioSender {
 public:
     AudioSender();
@@ -17,6 +19,13 @@ public:
     // Set client address (called when client connects)
     void set_client(const std::string& host, uint16_t port);
 
+    // Route packets through a shared egress scheduler (nullptr = send directly)
+    void set_scheduler(EgressScheduler* scheduler);
+
+    // Send through another sender's socket with a stream-id prefix (multiplexed mode).
+    // Pass -1 to go back to the dedicated audio socket.
+    void set_shared_socket(int socket_fd) { m_shared_socket = socket_fd; }
+
     // Send encoded Opus packet
     bool send_packet(const uint8_t* data, size_t size,
                      uint32_t sequence, uint64_t timestamp_us);
@@ -32,9 +41,12 @@ public:
 
 private:
     int m_socket = -1;
+    int m_shared_socket = -1;  // Not owned
     struct sockaddr_in m_client_addr = {};
     bool m_client_set = false;
 
+    EgressScheduler* m_scheduler = nullptr;
+
     uint64_t m_bytes_sent = 0;
     uint64_t m_packets_sent = 0;
 };
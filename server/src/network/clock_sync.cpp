@@ -0,0 +1,120 @@
+#include "clock_sync.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace stream_tablet {
+
+// Exchanges per point (the one with the smallest RTT wins)
+static constexpr int SAMPLES_PER_POINT = 4;
+// Points kept for the skew fit (~4 minutes at one exchange per 2 s)
+static constexpr size_t MAX_POINTS = 32;
+// The fit needs this much history; until then the offset follows the
+// latest point
+static constexpr int64_t MIN_FIT_SPAN_US = 30000000;
+static constexpr size_t MIN_FIT_POINTS = 3;
+// Points within this much of the best RTT take part in the estimate
+static constexpr int64_t RTT_SLACK_US = 500;
+static constexpr int64_t MAX_RTT_US = 1000000;
+// Crystal oscillators are within ~100 ppm; beyond this is noise
+static constexpr double MAX_SKEW = 500e-6;
+
+void ClockSync::reset() {
+    *this = ClockSync();
+}
+
+bool ClockSync::add_sample(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    int64_t rtt = (t4 - t1) - (t3 - t2);
+    if (t4 < t1 || t3 < t2 || rtt < 0 || rtt > MAX_RTT_US) {
+        return false;
+    }
+    m_samples++;
+
+    Point point;
+    point.server_us = t1 + (t4 - t1) / 2;
+    point.offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    point.rtt_us = rtt;
+    if (m_candidate_samples == 0 || rtt < m_candidate.rtt_us) {
+        m_candidate = point;
+    }
+    if (++m_candidate_samples < SAMPLES_PER_POINT) {
+        return true;
+    }
+
+    m_points.push_back(m_candidate);
+    if (m_points.size() > MAX_POINTS) {
+        m_points.erase(m_points.begin());
+    }
+    m_candidate_samples = 0;
+    fit();
+    return true;
+}
+
+void ClockSync::fit() {
+    int64_t min_rtt = get_min_rtt_us();
+    int64_t max_rtt = min_rtt + std::max(min_rtt / 2, RTT_SLACK_US);
+
+    double mean_x = 0.0;
+    double mean_y = 0.0;
+    size_t count = 0;
+    const Point* first = nullptr;
+    const Point* last = nullptr;
+    for (const Point& p : m_points) {
+        if (p.rtt_us > max_rtt) {
+            continue;
+        }
+        if (!first) {
+            first = &p;
+        }
+        last = &p;
+        // Relative to the first point to keep the doubles exact
+        mean_x += static_cast<double>(p.server_us - m_points[0].server_us);
+        mean_y += static_cast<double>(p.offset_us - m_points[0].offset_us);
+        count++;
+    }
+    if (!last) {
+        return;  // Can't happen: the best point always qualifies
+    }
+
+    if (count < MIN_FIT_POINTS || last->server_us - first->server_us < MIN_FIT_SPAN_US) {
+        // Not enough history for a slope: anchor on the newest good point
+        // and keep whatever skew an earlier fit found
+        m_base_server_us = last->server_us;
+        m_base_offset_us = last->offset_us;
+        m_synced = true;
+        return;
+    }
+
+    mean_x /= count;
+    mean_y /= count;
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (const Point& p : m_points) {
+        if (p.rtt_us > max_rtt) {
+            continue;
+        }
+        double dx = static_cast<double>(p.server_us - m_points[0].server_us) - mean_x;
+        double dy = static_cast<double>(p.offset_us - m_points[0].offset_us) - mean_y;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    m_skew = std::clamp(sxy / sxx, -MAX_SKEW, MAX_SKEW);
+    m_base_server_us = m_points[0].server_us + std::llround(mean_x);
+    m_base_offset_us = m_points[0].offset_us + std::llround(mean_y);
+    m_synced = true;
+}
+
+int64_t ClockSync::get_offset_us(int64_t server_us) const {
+    return m_base_offset_us + std::llround(m_skew * static_cast<double>(server_us - m_base_server_us));
+}
+
+int64_t ClockSync::get_min_rtt_us() const {
+    int64_t min_rtt = -1;
+    for (const Point& p : m_points) {
+        if (min_rtt < 0 || p.rtt_us < min_rtt) {
+            min_rtt = p.rtt_us;
+        }
+    }
+    return min_rtt;
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace stream_tablet {
+
+// NTP-style offset and skew estimate between the server's CLOCK_MONOTONIC
+// and a client's clock, both in microseconds.
+//
+// Each exchange gives t1 (server send), t2 (client receive), t3 (client
+// send) and t4 (server receive):
+//   rtt    = (t4 - t1) - (t3 - t2)
+//   offset = ((t2 - t1) + (t3 - t4)) / 2      (client - server)
+// Queueing only ever adds delay, so the exchange with the smallest RTT out
+// of every few is kept as a point. Points whose RTT is well above the best
+// recent one are ignored, and once the rest span long enough a least-squares
+// line through them gives the skew; the offset is read off that line.
+class ClockSync {
+public:
+    ClockSync() = default;
+
+    void reset();
+
+    // Returns false if the exchange is implausible (negative or huge RTT)
+    bool add_sample(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+    bool is_synced() const { return m_synced; }
+
+    // Client clock minus server clock at server time 'server_us'
+    int64_t get_offset_us(int64_t server_us) const;
+
+    // Client clock rate relative to the server's, in parts per million
+    double get_skew_ppm() const { return m_skew * 1e6; }
+
+    // Smallest RTT among the current points (-1 before the first point)
+    int64_t get_min_rtt_us() const;
+
+    uint64_t get_sample_count() const { return m_samples; }
+
+private:
+    struct Point {
+        int64_t server_us = 0;   // Midpoint of t1 and t4
+        int64_t offset_us = 0;
+        int64_t rtt_us = 0;
+    };
+
+    void fit();
+
+    Point m_candidate;
+    int m_candidate_samples = 0;
+    std::vector<Point> m_points;  // Oldest first
+
+    bool m_synced = false;
+    int64_t m_base_server_us = 0;
+    int64_t m_base_offset_us = 0;
+    double m_skew = 0.0;
+    uint64_t m_samples = 0;
+};
+
+}  // namespace stream_tablet
@@ -1,14 +1,109 @@
 #include "control_server.hpp"
 #include "../util/logger.hpp"
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <cerrno>
+#include <openssl/err.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
 namespace stream_tablet {
 
+// Clock pings: a burst to converge quickly, then a slow trickle to track drift
+static constexpr int CLOCK_BURST_PINGS = 8;
+static constexpr int64_t CLOCK_BURST_INTERVAL_US = 100000;
+static constexpr int64_t CLOCK_PING_INTERVAL_US = 2000000;
+
+// Per-state limits: setup must finish in time, and an active client can't
+// leave half a message hanging forever
+static constexpr int64_t TLS_HANDSHAKE_TIMEOUT_US = 3000000;
+static constexpr int64_t CONFIG_TIMEOUT_US = 3000000;
+static constexpr int64_t MESSAGE_TIMEOUT_US = 5000000;
+static constexpr size_t MAX_PENDING = 4;
+static constexpr size_t MAX_BUFFERED_BYTES = 256 * 1024;
+
+// Session tickets stay valid this long, so a tablet that roams or sleeps
+// within the hour resumes. 0-RTT data is capped at what a config request
+// with a session token needs, with room to spare.
+static constexpr long SESSION_TICKET_LIFETIME_S = 3600;
+static constexpr uint32_t MAX_EARLY_DATA = 256;
+
+// A heartbeat client that stays silent this long (at least) is dropped; by
+// then a returning client reconnects rather than revives the connection
+static constexpr int64_t SILENT_DROP_US = 30000000;
+
+static void put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+    }
+}
+
+static int64_t get_i64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return static_cast<int64_t>(v);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<uint8_t>(v >> (24 - 8 * i));
+    }
+}
+
+static int32_t get_i32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v = (v << 8) | p[i];
+    }
+    return static_cast<int32_t>(v);
+}
+
+// When the data now at the head of the socket queue arrived (SO_TIMESTAMPNS,
+// converted to CLOCK_MONOTONIC). The stream loop only looks at the control
+// socket once per iteration, which would add up to a frame interval to the
+// measured RTT. Peeking leaves the data for the TLS layer.
+static int64_t socket_receive_us(int fd) {
+    int64_t now = ControlServer::now_us();
+    uint8_t byte;
+    struct iovec iov = {&byte, 1};
+    alignas(struct cmsghdr) uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_PEEK | MSG_DONTWAIT) <= 0) {
+        return now;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec stamp;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            struct timespec real;
+            clock_gettime(CLOCK_REALTIME, &real);
+            int64_t age_us = (static_cast<int64_t>(real.tv_sec - stamp.tv_sec) * 1000000000LL +
+                              (real.tv_nsec - stamp.tv_nsec)) / 1000;
+            return (age_us > 0 && age_us < 1000000) ? now - age_us : now;
+        }
+    }
+    return now;
+}
+
+int64_t ControlServer::now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 ControlServer::ControlServer() = default;
 
 ControlServer::~ControlServer() {
@@ -39,21 +134,29 @@ bool ControlServer::init_plain(uint16_t port) {
         return false;
     }
 
-    if (listen(m_listen_socket, 1) < 0) {
+    if (listen(m_listen_socket, m_max_clients) < 0) {
         LOG_ERROR("Failed to listen on control socket");
         close(m_listen_socket);
         m_listen_socket = -1;
         return false;
     }
 
+    if (!init_poller()) {
+        close(m_listen_socket);
+        m_listen_socket = -1;
+        return false;
+    }
+
     LOG_INFO("Control server listening on port %d (no TLS)", port);
     return true;
 }
 
 bool ControlServer::init(uint16_t port, const std::string& cert_file, const std::string& key_file) {
+    // No fallback to plain TCP: whoever asked for TLS must not end up
+    // sending session tokens in the clear
     if (!init_tls(cert_file, key_file)) {
-        LOG_WARN("TLS init failed, falling back to plain TCP");
-        return init_plain(port);
+        LOG_ERROR("TLS init failed, not starting the control channel");
+        return false;
     }
 
     m_use_tls = true;
@@ -79,13 +182,19 @@ bool ControlServer::init(uint16_t port, const std::string& cert_file, const std:
         return false;
     }
 
-    if (listen(m_listen_socket, 1) < 0) {
+    if (listen(m_listen_socket, m_max_clients) < 0) {
         LOG_ERROR("Failed to listen on control socket");
         close(m_listen_socket);
         m_listen_socket = -1;
         return false;
     }
 
+    if (!init_poller()) {
+        close(m_listen_socket);
+        m_listen_socket = -1;
+        return false;
+    }
+
     LOG_INFO("Control server listening on port %d (TLS)", port);
     return true;
 }
@@ -115,7 +224,32 @@ bool ControlServer::init_tls(const std::string& cert_file, const std::string& ke
         return false;
     }
 
-    LOG_INFO("TLS initialized");
+    if (SSL_CTX_check_private_key(m_ssl_ctx) != 1) {
+        LOG_ERROR("Private key %s does not match certificate %s", key_file.c_str(), cert_file.c_str());
+        SSL_CTX_free(m_ssl_ctx);
+        m_ssl_ctx = nullptr;
+        return false;
+    }
+
+    // Non-blocking sockets: SSL_write may take part of a message and be
+    // retried with a grown buffer
+    SSL_CTX_set_mode(m_ssl_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    // TLS 1.3 only: a full handshake takes one round trip, and a client
+    // that comes back with a session ticket skips the certificate
+    // exchange. Two tickets per connection, so a reconnect racing the
+    // first one still has a spare.
+    SSL_CTX_set_min_proto_version(m_ssl_ctx, TLS1_3_VERSION);
+    SSL_CTX_set_num_tickets(m_ssl_ctx, 2);
+    SSL_CTX_set_timeout(m_ssl_ctx, SESSION_TICKET_LIFETIME_S);
+    if (m_early_data) {
+        // OpenSSL's anti-replay check (on by default, backed by the server
+        // session cache) lets each ticket carry early data only once
+        SSL_CTX_set_max_early_data(m_ssl_ctx, MAX_EARLY_DATA);
+        SSL_CTX_set_recv_max_early_data(m_ssl_ctx, MAX_EARLY_DATA);
+    }
+
+    LOG_INFO("TLS initialized (session tickets%s)", m_early_data ? ", 0-RTT config request" : "");
     return true;
 }
 
@@ -124,62 +258,657 @@ bool ControlServer::accept_client(ClientInfo& out_info) {
         return false;
     }
 
-    struct sockaddr_in client_addr = {};
-    socklen_t client_len = sizeof(client_addr);
-
     LOG_INFO("Waiting for client connection...");
-    m_client_socket = accept(m_listen_socket, reinterpret_cast<struct sockaddr*>(&client_addr), &client_len);
-    if (m_client_socket < 0) {
-        LOG_ERROR("Failed to accept client");
+    // Connections in setup advance side by side, so one stalled peer only
+    // holds up itself; a signal ends the wait
+    while (m_listen_socket >= 0) {
+        if (take_ready(out_info)) {
+            return true;
+        }
+        if (!pump(100, true)) {
+            return false;
+        }
+        if (m_idle_cb) {
+            m_idle_cb();
+        }
+    }
+    return false;
+}
+
+bool ControlServer::poll_accept(ClientInfo& out_info) {
+    if (m_listen_socket < 0) {
         return false;
     }
+    pump(0, true);
+    return take_ready(out_info);
+}
 
-    char host[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_addr.sin_addr, host, sizeof(host));
-    m_client_host = host;
+bool ControlServer::init_poller() {
+    int flags = fcntl(m_listen_socket, F_GETFL, 0);
+    fcntl(m_listen_socket, F_SETFL, flags | O_NONBLOCK);
 
-    LOG_INFO("Client connected from %s", m_client_host.c_str());
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        LOG_ERROR("Failed to create control epoll: %s", strerror(errno));
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_listen_socket;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_socket, &ev);
+    return true;
+}
 
-    if (m_use_tls && m_ssl_ctx) {
-        m_ssl = SSL_new(m_ssl_ctx);
-        SSL_set_fd(m_ssl, m_client_socket);
+void ControlServer::accept_pending() {
+    for (;;) {
+        struct sockaddr_in client_addr = {};
+        socklen_t client_len = sizeof(client_addr);
+        int fd = accept4(m_listen_socket, reinterpret_cast<struct sockaddr*>(&client_addr), &client_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR("Failed to accept client: %s", strerror(errno));
+            }
+            return;
+        }
+        // When full, only a client coming back for its session can get in
+        // (its old connection may not have timed out yet)
+        bool resumable = std::any_of(m_clients.begin(), m_clients.end(),
+                                     [](const Client& c) { return !c.session_token.empty(); });
+        if (static_cast<int>(m_clients.size()) >= m_max_clients && !resumable) {
+            LOG_WARN("Rejecting client: %d clients already connected", m_max_clients);
+            close(fd);
+            continue;
+        }
+        if (m_pending.size() >= MAX_PENDING) {
+            LOG_WARN("Rejecting client: %zu connections still in setup", m_pending.size());
+            close(fd);
+            continue;
+        }
 
-        if (SSL_accept(m_ssl) <= 0) {
-            LOG_ERROR("TLS handshake failed");
-            SSL_free(m_ssl);
-            m_ssl = nullptr;
-            close(m_client_socket);
-            m_client_socket = -1;
-            return false;
+        Client client;
+        client.socket = fd;
+        char host[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, host, sizeof(host));
+        client.host = host;
+        // Receive timestamps for clock sync
+        int timestamps = 1;
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &timestamps, sizeof(timestamps));
+        // Control messages and TLS flights are small and each one is waited
+        // for: without this, Nagle holds a reply behind the peer's delayed ACK
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        LOG_INFO("Client connected from %s", client.host.c_str());
+
+        if (m_use_tls && m_ssl_ctx) {
+            client.ssl = SSL_new(m_ssl_ctx);
+            SSL_set_fd(client.ssl, fd);
+            SSL_set_accept_state(client.ssl);
+            client.handshaking = true;
+            client.handshake_start_us = now_us();
+            set_state(client, ConnState::TLS_HANDSHAKE, TLS_HANDSHAKE_TIMEOUT_US);
+        } else {
+            set_state(client, ConnState::CONFIG, CONFIG_TIMEOUT_US);
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        client.epoll_events = EPOLLIN;
+        m_pending.push_back(std::move(client));
+    }
+}
+
+void ControlServer::set_state(Client& client, ConnState state, int64_t timeout_us) {
+    client.state = state;
+    client.deadline_us = timeout_us > 0 ? now_us() + timeout_us : 0;
+}
+
+bool ControlServer::take_ready(ClientInfo& out_info) {
+    for (size_t i = 0; i < m_pending.size(); i++) {
+        if (m_pending[i].state != ConnState::READY) {
+            continue;
+        }
+        Client client = std::move(m_pending[i]);
+        m_pending.erase(m_pending.begin() + i);
+        i--;
+        if (!client.info.resume_token.empty() && drop_replaced(client.info.resume_token)) {
+            // The server parks the old session before this one asks for it
+            reap_disconnected();
+        }
+        if (static_cast<int>(m_clients.size()) >= m_max_clients) {
+            LOG_WARN("Rejecting client: %d clients already connected", m_max_clients);
+            close_client(client);
+            continue;
+        }
+
+        client.id = m_next_client_id++;
+        client.connected = true;
+        set_state(client, ConnState::ACTIVE, 0);
+        if (m_heartbeat_ms > 0) {
+            client.heartbeat = (client.info.capabilities & CLIENT_CAP_HEARTBEAT) != 0;
+            client.last_rx_us = now_us();
+            client.next_ping_us = client.last_rx_us + static_cast<int64_t>(m_heartbeat_ms) * 1000;
+            configure_keepalive(client);
+        }
+        out_info = client.info;
+        out_info.id = client.id;
+        out_info.host = client.host;
+
+        LOG_INFO("Client %u config: %dx%d, video_port=%d, input_port=%d, caps=0x%02x",
+                 out_info.id, out_info.width, out_info.height, out_info.video_port, out_info.input_port,
+                 out_info.capabilities);
+
+        m_clients.push_back(std::move(client));
+        return true;
+    }
+    return false;
+}
+
+bool ControlServer::drop_replaced(const std::vector<uint8_t>& token) {
+    for (auto& client : m_clients) {
+        if (client.connected && client.session_token == token) {
+            LOG_INFO("Client %u reconnected, dropping its old connection", client.id);
+            client.connected = false;
+            return true;
         }
-        LOG_INFO("TLS handshake completed");
     }
+    return false;
+}
 
-    // Read config request from client
-    uint8_t msg_type;
-    std::vector<uint8_t> msg_data;
-    if (!read_message(msg_type, msg_data) || msg_type != MSG_CONFIG_REQUEST) {
-        LOG_ERROR("Expected config request from client");
+bool ControlServer::pump(int timeout_ms, bool accept_new) {
+    if (m_epoll_fd < 0) {
         return false;
     }
+    struct epoll_event events[16];
+    int n = epoll_wait(m_epoll_fd, events, 16, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) {
+            LOG_ERROR("Control epoll_wait failed: %s", strerror(errno));
+        }
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == m_listen_socket) {
+            // Single-client mode leaves later connections in the backlog
+            // until the session ends
+            if (accept_new) {
+                accept_pending();
+            }
+            continue;
+        }
+        Client* client = find_by_fd(fd);
+        if (client && client->state != ConnState::CLOSED) {
+            advance(*client, events[i].events);
+        }
+    }
+
+    // Setup must finish in time; drop whatever has stalled or failed
+    int64_t now = now_us();
+    for (size_t i = 0; i < m_pending.size();) {
+        Client& client = m_pending[i];
+        if (client.state != ConnState::CLOSED && client.deadline_us != 0 && now > client.deadline_us) {
+            LOG_WARN("Client %s: %s timed out", client.host.c_str(),
+                     client.state == ConnState::TLS_HANDSHAKE ? "TLS handshake" : "config request");
+            client.state = ConnState::CLOSED;
+        }
+        if (client.state == ConnState::CLOSED) {
+            close_client(client);
+            m_pending.erase(m_pending.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+void ControlServer::advance(Client& client, uint32_t events) {
+    // TLS may need the socket writable to make progress on a read
+    bool retry_read = client.want_write && (events & EPOLLOUT);
+    client.want_write = false;
+
+    if (client.handshaking) {
+        if (!continue_handshake(client)) {
+            client.state = ConnState::CLOSED;
+            return;
+        }
+        if (client.state == ConnState::TLS_HANDSHAKE) {
+            update_events(client);
+            return;
+        }
+        retry_read = true;  // Application data may already be decrypted
+    }
+
+    if (!flush_tx(client)) {
+        client.state = ConnState::CLOSED;
+        return;
+    }
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) || retry_read) {
+        if (!read_available(client)) {
+            // Active clients: process() handles what arrived before the
+            // close, then reports the disconnect
+            client.state = ConnState::CLOSED;
+            return;
+        }
+    }
+
+    if (client.state == ConnState::CONFIG) {
+        uint8_t msg_type;
+        std::vector<uint8_t> msg_data;
+        if (take_message(client, msg_type, msg_data)) {
+            if (msg_type != MSG_CONFIG_REQUEST) {
+                LOG_ERROR("Expected config request from client");
+                client.state = ConnState::CLOSED;
+                return;
+            }
+            // Parse config request (simple format: width(2), height(2), video_port(2), input_port(2))
+            ClientInfo& info = client.info;
+            if (msg_data.size() >= 8) {
+                info.width = (msg_data[0] << 8) | msg_data[1];
+                info.height = (msg_data[2] << 8) | msg_data[3];
+                info.video_port = (msg_data[4] << 8) | msg_data[5];
+                info.input_port = (msg_data[6] << 8) | msg_data[7];
+            }
+            // Optional capability byte (newer clients only)
+            info.capabilities = (msg_data.size() >= 9) ? msg_data[8] : 0;
+            info.resume_token.clear();
+            if ((info.capabilities & CLIENT_CAP_RESUME) && msg_data.size() >= 9 + SESSION_TOKEN_SIZE) {
+                info.resume_token.assign(msg_data.begin() + 9, msg_data.begin() + 9 + SESSION_TOKEN_SIZE);
+            }
+            if (client.early_bytes > 3 + msg_data.size()) {
+                // The config request is the only message safe to act on
+                // before the handshake completes (early data can be replayed)
+                LOG_ERROR("Client %s sent more than the config request as 0-RTT data", client.host.c_str());
+                client.state = ConnState::CLOSED;
+                return;
+            }
+            set_state(client, ConnState::READY, 0);
+        }
+    }
+    update_events(client);
+}
+
+bool ControlServer::continue_handshake(Client& client) {
+    // SSL_get_error() reads the thread's error queue, which must not hold
+    // leftovers from another connection
+    ERR_clear_error();
+    int64_t started = now_us();
+    int err = SSL_ERROR_NONE;
+
+    // 0-RTT: a resuming client may send its config request along with the
+    // ClientHello. It is taken here, so the server can hand the client
+    // over and answer (as 0.5-RTT data, see flush_tx) before the client's
+    // Finished arrives. Without early data this returns FINISH at once.
+    while (m_early_data && !client.early_done) {
+        uint8_t buf[MAX_EARLY_DATA];
+        size_t n = 0;
+        int ret = SSL_read_early_data(client.ssl, buf, sizeof(buf), &n);
+        if (ret == SSL_READ_EARLY_DATA_SUCCESS) {
+            if (client.state != ConnState::TLS_HANDSHAKE && client.state != ConnState::CONFIG) {
+                LOG_ERROR("Client %s sent more than the config request as 0-RTT data", client.host.c_str());
+                err = SSL_ERROR_SSL;
+                break;
+            }
+            if (client.early_bytes == 0) {
+                set_state(client, ConnState::CONFIG, CONFIG_TIMEOUT_US);
+            }
+            client.rx.insert(client.rx.end(), buf, buf + n);
+            client.early_bytes += n;
+            continue;
+        }
+        if (ret == SSL_READ_EARLY_DATA_FINISH) {
+            client.early_done = true;
+            break;
+        }
+        err = SSL_get_error(client.ssl, 0);
+        break;
+    }
 
-    // Parse config request (simple format: width(2), height(2), video_port(2), input_port(2))
-    if (msg_data.size() >= 8) {
-        out_info.width = (msg_data[0] << 8) | msg_data[1];
-        out_info.height = (msg_data[2] << 8) | msg_data[3];
-        out_info.video_port = (msg_data[4] << 8) | msg_data[5];
-        out_info.input_port = (msg_data[6] << 8) | msg_data[7];
+    if (err == SSL_ERROR_NONE) {
+        int ret = SSL_do_handshake(client.ssl);
+        err = (ret == 1) ? SSL_ERROR_NONE : SSL_get_error(client.ssl, ret);
+    }
+    client.handshake_cpu_us += now_us() - started;
+
+    if (err == SSL_ERROR_NONE) {
+        finish_handshake(client);
+        return true;
+    }
+    if (err == SSL_ERROR_WANT_READ) {
+        return true;
+    }
+    if (err == SSL_ERROR_WANT_WRITE) {
+        client.want_write = true;
+        return true;
+    }
+    LOG_ERROR("TLS handshake with %s failed", client.host.c_str());
+    m_tls_counts.failed++;
+    return false;
+}
+
+void ControlServer::finish_handshake(Client& client) {
+    client.handshaking = false;
+    int64_t elapsed_us = now_us() - client.handshake_start_us;
+    bool resumed = SSL_session_reused(client.ssl) == 1;
+    if (resumed) {
+        m_tls_counts.resumed++;
+        m_tls_resumed_us.record(static_cast<uint64_t>(elapsed_us));
+    } else {
+        m_tls_counts.full++;
+        m_tls_full_us.record(static_cast<uint64_t>(elapsed_us));
+    }
+    m_tls_cpu_us.record(static_cast<uint64_t>(client.handshake_cpu_us));
+    int early_status = SSL_get_early_data_status(client.ssl);
+    if (early_status == SSL_EARLY_DATA_ACCEPTED) {
+        m_tls_counts.early_accepted++;
+    } else if (early_status == SSL_EARLY_DATA_REJECTED) {
+        m_tls_counts.early_rejected++;
+    }
+
+    LOG_INFO("TLS handshake with %s: %s%s in %.2f ms (%.2f ms CPU)", client.host.c_str(),
+             resumed ? "resumed" : "full",
+             early_status == SSL_EARLY_DATA_ACCEPTED ? ", config request as 0-RTT data" :
+             (early_status == SSL_EARLY_DATA_REJECTED ? ", 0-RTT data refused" : ""),
+             elapsed_us / 1000.0, client.handshake_cpu_us / 1000.0);
+    if (client.state == ConnState::TLS_HANDSHAKE) {
+        set_state(client, ConnState::CONFIG, CONFIG_TIMEOUT_US);
+    }
+}
+
+TlsStats ControlServer::get_tls_stats() {
+    TlsStats stats = m_tls_counts;
+    stats.full_us = m_tls_full_us.snapshot();
+    stats.resumed_us = m_tls_resumed_us.snapshot();
+    stats.cpu_us = m_tls_cpu_us.snapshot();
+    return stats;
+}
+
+bool ControlServer::read_available(Client& client) {
+    if (client.clock_sync) {
+        client.rx_stamp_us = socket_receive_us(client.socket);
+    }
+    uint8_t buf[4096];
+    for (;;) {
+        if (client.rx.size() > MAX_BUFFERED_BYTES) {
+            LOG_WARN("Client %s: too much unprocessed control data", client.host.c_str());
+            return false;
+        }
+        if (client.ssl && client.handshaking) {
+            return true;  // Early data is read by continue_handshake()
+        }
+        if (client.ssl) {
+            ERR_clear_error();
+            int n = SSL_read(client.ssl, buf, sizeof(buf));
+            if (n > 0) {
+                client.rx.insert(client.rx.end(), buf, buf + n);
+                client.last_rx_us = now_us();
+                continue;
+            }
+            int err = SSL_get_error(client.ssl, n);
+            if (err == SSL_ERROR_WANT_READ) {
+                return true;
+            }
+            if (err == SSL_ERROR_WANT_WRITE) {
+                client.want_write = true;
+                return true;
+            }
+            return false;  // Closed (close_notify or EOF) or TLS error
+        }
+        ssize_t n = recv(client.socket, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) {
+            client.rx.insert(client.rx.end(), buf, buf + n);
+            client.last_rx_us = now_us();
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
     }
-    out_info.host = m_client_host;
+}
 
-    LOG_INFO("Client config: %dx%d, video_port=%d, input_port=%d",
-             out_info.width, out_info.height, out_info.video_port, out_info.input_port);
+bool ControlServer::flush_tx(Client& client) {
+    while (!client.tx.empty()) {
+        if (client.ssl && client.handshaking) {
+            if (client.early_bytes == 0 || client.early_done) {
+                return true;  // Sent once the handshake completes
+            }
+            ERR_clear_error();
+            size_t written = 0;
+            if (SSL_write_early_data(client.ssl, client.tx.data(), client.tx.size(), &written) == 1) {
+                client.tx.erase(client.tx.begin(), client.tx.begin() + written);
+                continue;
+            }
+            int err = SSL_get_error(client.ssl, 0);
+            return err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ;
+        }
+        if (client.ssl) {
+            ERR_clear_error();
+            int n = SSL_write(client.ssl, client.tx.data(), static_cast<int>(client.tx.size()));
+            if (n > 0) {
+                client.tx.erase(client.tx.begin(), client.tx.begin() + n);
+                continue;
+            }
+            int err = SSL_get_error(client.ssl, n);
+            return err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ;
+        }
+        ssize_t n = send(client.socket, client.tx.data(), client.tx.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            client.tx.erase(client.tx.begin(), client.tx.begin() + n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
 
-    m_client_connected = true;
+bool ControlServer::take_message(Client& client, uint8_t& type, std::vector<uint8_t>& data) {
+    // Message format: [length:2][type:1][data:length-1]
+    if (client.rx.size() < 3) {
+        return false;
+    }
+    uint16_t length = (client.rx[0] << 8) | client.rx[1];
+    size_t payload = length > 1 ? length - 1 : 0;
+    if (client.rx.size() < 3 + payload) {
+        return false;
+    }
+    type = client.rx[2];
+    data.assign(client.rx.begin() + 3, client.rx.begin() + 3 + payload);
+    client.rx.erase(client.rx.begin(), client.rx.begin() + 3 + payload);
+    // The timeout is for a stalled message, not for steady traffic that
+    // always leaves the next one half read
+    client.partial_since_us = 0;
     return true;
 }
 
-bool ControlServer::send_config(int screen_width, int screen_height, int video_port, int input_port) {
+void ControlServer::update_events(Client& client) {
+    if (client.socket < 0) {
+        return;
+    }
+    uint32_t wanted = EPOLLIN;
+    bool tx_held = client.handshaking && (client.early_bytes == 0 || client.early_done);
+    if ((!client.tx.empty() && !tx_held) || client.want_write) {
+        wanted |= EPOLLOUT;
+    }
+    if (wanted != client.epoll_events) {
+        struct epoll_event ev = {};
+        ev.events = wanted;
+        ev.data.fd = client.socket;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, client.socket, &ev);
+        client.epoll_events = wanted;
+    }
+}
+
+ControlServer::Client* ControlServer::find_by_fd(int fd) {
+    for (auto& client : m_clients) {
+        if (client.socket == fd) return &client;
+    }
+    for (auto& client : m_pending) {
+        if (client.socket == fd) return &client;
+    }
+    return nullptr;
+}
+
+ControlServer::Client* ControlServer::find_client(uint32_t id) {
+    for (auto& client : m_clients) {
+        if (client.id == id) return &client;
+    }
+    return nullptr;
+}
+
+const ClockSync* ControlServer::get_clock_sync(uint32_t client_id) const {
+    for (const auto& client : m_clients) {
+        if (client.id == client_id) {
+            return client.clock_sync ? &client.clock : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void ControlServer::send_clock_ping(Client& client, int64_t now) {
+    uint8_t data[CLOCK_PING_SIZE];
+    put_u64(data, static_cast<uint64_t>(now));
+    send_message(client, MSG_PING, data, sizeof(data));
+    client.pings_sent++;
+    int64_t interval = CLOCK_PING_INTERVAL_US;
+    if (client.clock_sync && client.pings_sent < CLOCK_BURST_PINGS) {
+        interval = CLOCK_BURST_INTERVAL_US;
+    }
+    if (client.heartbeat) {
+        interval = std::min(interval, static_cast<int64_t>(m_heartbeat_ms) * 1000);
+    }
+    client.next_ping_us = now + interval;
+}
+
+void ControlServer::set_heartbeat(int interval_ms, int misses) {
+    m_heartbeat_ms = interval_ms < 0 ? 0 : interval_ms;
+    m_heartbeat_misses = misses < 1 ? 1 : misses;
+}
+
+void ControlServer::check_heartbeat(Client& client, int64_t now) {
+    int64_t window = static_cast<int64_t>(m_heartbeat_ms) * 1000 * m_heartbeat_misses;
+    int64_t silent = now - client.last_rx_us;
+    if (silent > std::max(SILENT_DROP_US, 4 * window)) {
+        LOG_WARN("Client %u silent for %lld s, dropping it", client.id,
+                 static_cast<long long>(silent / 1000000));
+        client.connected = false;
+        return;
+    }
+
+    bool responsive = silent <= window;
+    if (responsive == client.responsive) {
+        return;
+    }
+    client.responsive = responsive;
+    if (responsive) {
+        LOG_INFO("Client %u is back", client.id);
+    } else {
+        LOG_WARN("Client %u missed %d heartbeats", client.id, m_heartbeat_misses);
+    }
+}
+
+void ControlServer::configure_keepalive(Client& client) {
+    // Heartbeat clients are judged by their pongs on the short window. The
+    // kernel only gives up on a connection after SILENT_DROP_US without an
+    // answer: clients without heartbeats (the shipped app) can't resume,
+    // so a Wi-Fi stall must not end their session. A tablet that vanished
+    // is still noticed within that, not after TCP's default two hours.
+    int interval_s = std::max(1, m_heartbeat_ms / 1000);
+    int silent_s = static_cast<int>(SILENT_DROP_US / 1000000);
+    int probes = std::max(1, silent_s / interval_s);
+    int user_timeout_ms = static_cast<int>(SILENT_DROP_US / 1000);
+    int on = 1;
+    setsockopt(client.socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(client.socket, IPPROTO_TCP, TCP_KEEPIDLE, &interval_s, sizeof(interval_s));
+    setsockopt(client.socket, IPPROTO_TCP, TCP_KEEPINTVL, &interval_s, sizeof(interval_s));
+    setsockopt(client.socket, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+    setsockopt(client.socket, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout_ms, sizeof(user_timeout_ms));
+}
+
+bool ControlServer::has_active_client() const {
+    for (const auto& client : m_clients) {
+        if (client.connected && client.responsive && !client.paused) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ControlServer::is_client_paused(uint32_t client_id) const {
+    for (const auto& client : m_clients) {
+        if (client.id == client_id) {
+            return client.paused;
+        }
+    }
+    return false;
+}
+
+void ControlServer::handle_clock_pong(Client& client, const std::vector<uint8_t>& data, int64_t received_us) {
+    if (!client.clock_sync || data.size() != CLOCK_PONG_SIZE) {
+        return;
+    }
+    int64_t t1 = get_i64(data.data());
+    int64_t t2 = get_i64(data.data() + 8);
+    int64_t t3 = get_i64(data.data() + 16);
+    bool was_synced = client.clock.is_synced();
+    if (!client.clock.add_sample(t1, t2, t3, received_us)) {
+        LOG_DEBUG("Client %u: clock sample rejected (t1=%ld t4=%ld)", client.id, t1, received_us);
+        return;
+    }
+    if (!was_synced && client.clock.is_synced()) {
+        LOG_INFO("Client %u clock synced: offset=%+.3fms rtt=%.2fms", client.id,
+                 client.clock.get_offset_us(received_us) / 1000.0, client.clock.get_min_rtt_us() / 1000.0);
+    }
+}
+
+void ControlServer::handle_set_param(Client& client, const std::vector<uint8_t>& data) {
+    if (data.empty() || data.size() % PARAM_ENTRY_SIZE != 0) {
+        LOG_WARN("Client %u: malformed parameter request (%zu bytes)", client.id, data.size());
+        return;
+    }
+
+    size_t count = data.size() / PARAM_ENTRY_SIZE;
+    std::vector<uint8_t> result(count * (PARAM_ENTRY_SIZE + 1));
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* entry = &data[i * PARAM_ENTRY_SIZE];
+        uint8_t param = entry[0];
+        int32_t value = get_i32(entry + 1);
+        uint8_t status = m_param_cb ? m_param_cb(client.id, param, value) : PARAM_UNKNOWN;
+
+        uint8_t* out = &result[i * (PARAM_ENTRY_SIZE + 1)];
+        out[0] = param;
+        out[1] = status;
+        put_u32(out + 2, static_cast<uint32_t>(value));
+    }
+    send_message(client, MSG_PARAM_RESULT, result.data(), result.size());
+}
+
+void ControlServer::close_client(Client& client) {
+    if (client.ssl) {
+        // Best effort close_notify (the socket is non-blocking), only once
+        // the handshake got through
+        if (SSL_is_init_finished(client.ssl)) {
+            SSL_shutdown(client.ssl);
+        }
+        ERR_clear_error();
+        SSL_free(client.ssl);
+        client.ssl = nullptr;
+    }
+    if (client.socket >= 0) {
+        close(client.socket);  // Also leaves the epoll set
+        client.socket = -1;
+    }
+    client.connected = false;
+    client.state = ConnState::CLOSED;
+}
+
+bool ControlServer::send_config(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port) {
     std::vector<uint8_t> data(8);
     data[0] = (screen_width >> 8) & 0xFF;
     data[1] = screen_width & 0xFF;
@@ -190,10 +919,10 @@ bool ControlServer::send_config(int screen_width, int screen_height, int video_p
     data[6] = (input_port >> 8) & 0xFF;
     data[7] = input_port & 0xFF;
 
-    return send_message(MSG_CONFIG_RESPONSE, data.data(), data.size());
+    return send_message(client_id, MSG_CONFIG_RESPONSE, data.data(), data.size());
 }
 
-bool ControlServer::send_config_with_audio(int screen_width, int screen_height, int video_port, int input_port,
+bool ControlServer::send_config_with_audio(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port,
                                             int audio_port, int audio_sample_rate, int audio_channels, int audio_frame_ms) {
     // Extended config: 14 bytes
     // [width:2][height:2][video_port:2][input_port:2][audio_port:2][sample_rate:2][channels:1][frame_ms:1]
@@ -217,15 +946,19 @@ bool ControlServer::send_config_with_audio(int screen_width, int screen_height,
              screen_width, screen_height, video_port, input_port, audio_port,
              audio_sample_rate, audio_channels, audio_frame_ms);
 
-    return send_message(MSG_CONFIG_RESPONSE, data.data(), data.size());
+    return send_message(client_id, MSG_CONFIG_RESPONSE, data.data(), data.size());
 }
 
-bool ControlServer::send_config_full(int screen_width, int screen_height, int video_port, int input_port,
+bool ControlServer::send_config_full(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port,
                                       int audio_port, int audio_sample_rate, int audio_channels, int audio_frame_ms,
-                                      uint8_t codec_type) {
-    // Full config: 15 bytes
-    // [width:2][height:2][video_port:2][input_port:2][audio_port:2][sample_rate:2][channels:1][frame_ms:1][codec:1]
-    std::vector<uint8_t> data(15);
+                                      uint8_t codec_type, uint8_t stream_flags,
+                                      const std::string& multicast_group, int multicast_port,
+                                      const std::vector<uint8_t>& session_token) {
+    // Full config: 16 bytes
+    // [width:2][height:2][video_port:2][input_port:2][audio_port:2][sample_rate:2][channels:1][frame_ms:1][codec:1][flags:1]
+    // With STREAM_FLAG_MULTICAST: 22 bytes, followed by [group_addr:4][group_port:2]
+    // With STREAM_FLAG_RESUME: [session_token:16] last
+    std::vector<uint8_t> data((stream_flags & STREAM_FLAG_MULTICAST) ? 22 : 16);
     data[0] = (screen_width >> 8) & 0xFF;
     data[1] = screen_width & 0xFF;
     data[2] = (screen_height >> 8) & 0xFF;
@@ -241,124 +974,193 @@ bool ControlServer::send_config_full(int screen_width, int screen_height, int vi
     data[12] = static_cast<uint8_t>(audio_channels);
     data[13] = static_cast<uint8_t>(audio_frame_ms);
     data[14] = codec_type;
+    data[15] = stream_flags;
+    if (stream_flags & STREAM_FLAG_CLOCK_SYNC) {
+        Client* client = find_client(client_id);
+        if (client) {
+            client->clock_sync = true;
+            client->clock.reset();
+            client->pings_sent = 0;
+            client->next_ping_us = 0;  // First ping right after the config
+        }
+    }
+    if (stream_flags & STREAM_FLAG_MULTICAST) {
+        struct in_addr group = {};
+        inet_pton(AF_INET, multicast_group.c_str(), &group);
+        memcpy(&data[16], &group.s_addr, 4);  // Already network byte order
+        data[20] = (multicast_port >> 8) & 0xFF;
+        data[21] = multicast_port & 0xFF;
+    }
+    if (stream_flags & STREAM_FLAG_RESUME) {
+        if (session_token.size() != SESSION_TOKEN_SIZE) {
+            LOG_ERROR("Session token must be %zu bytes", SESSION_TOKEN_SIZE);
+            return false;
+        }
+        data.insert(data.end(), session_token.begin(), session_token.end());
+        Client* client = find_client(client_id);
+        if (client) {
+            client->session_token = session_token;
+        }
+    }
 
     const char* codec_names[] = {"AV1", "HEVC", "H.264"};
     const char* codec_name = (codec_type < 3) ? codec_names[codec_type] : "unknown";
 
-    LOG_INFO("Sending config: %dx%d, video=%d, input=%d, audio=%d, %dHz, %dch, %dms, codec=%s",
+    LOG_INFO("Sending config: %dx%d, video=%d, input=%d, audio=%d, %dHz, %dch, %dms, codec=%s, flags=0x%02x",
              screen_width, screen_height, video_port, input_port, audio_port,
-             audio_sample_rate, audio_channels, audio_frame_ms, codec_name);
+             audio_sample_rate, audio_channels, audio_frame_ms, codec_name, stream_flags);
 
-    return send_message(MSG_CONFIG_RESPONSE, data.data(), data.size());
+    return send_message(client_id, MSG_CONFIG_RESPONSE, data.data(), data.size());
 }
 
-bool ControlServer::read_message(uint8_t& type, std::vector<uint8_t>& data) {
-    // Message format: [length:2][type:1][data:length-1]
-    uint8_t header[3];
-    ssize_t n;
-
-    if (m_use_tls && m_ssl) {
-        n = SSL_read(m_ssl, header, 3);
-    } else {
-        n = recv(m_client_socket, header, 3, MSG_WAITALL);
+bool ControlServer::send_message(uint32_t client_id, uint8_t type, const uint8_t* data, size_t len) {
+    Client* client = find_client(client_id);
+    if (!client) {
+        return false;
     }
+    return send_message(*client, type, data, len);
+}
 
-    if (n != 3) {
+bool ControlServer::send_message(Client& client, uint8_t type, const uint8_t* data, size_t len) {
+    if (client.socket < 0 || client.state == ConnState::CLOSED) {
         return false;
     }
-
-    uint16_t length = (header[0] << 8) | header[1];
-    type = header[2];
-
-    if (length > 1) {
-        data.resize(length - 1);
-        if (m_use_tls && m_ssl) {
-            n = SSL_read(m_ssl, data.data(), data.size());
-        } else {
-            n = recv(m_client_socket, data.data(), data.size(), MSG_WAITALL);
-        }
-        if (n != static_cast<ssize_t>(data.size())) {
-            return false;
-        }
-    } else {
-        data.clear();
+    if (client.tx.size() + 3 + len > MAX_BUFFERED_BYTES) {
+        LOG_WARN("Client %u is not reading control messages, dropping it", client.id);
+        client.state = ConnState::CLOSED;
+        return false;
     }
 
-    return true;
-}
-
-bool ControlServer::send_message(uint8_t type, const uint8_t* data, size_t len) {
-    std::vector<uint8_t> msg(3 + len);
+    // Queue, then write as much as the socket takes; the rest goes out when
+    // it becomes writable
     uint16_t length = static_cast<uint16_t>(len + 1);
-    msg[0] = (length >> 8) & 0xFF;
-    msg[1] = length & 0xFF;
-    msg[2] = type;
+    client.tx.push_back((length >> 8) & 0xFF);
+    client.tx.push_back(length & 0xFF);
+    client.tx.push_back(type);
     if (len > 0) {
-        memcpy(msg.data() + 3, data, len);
+        client.tx.insert(client.tx.end(), data, data + len);
     }
-
-    ssize_t n;
-    if (m_use_tls && m_ssl) {
-        n = SSL_write(m_ssl, msg.data(), msg.size());
-    } else {
-        n = send(m_client_socket, msg.data(), msg.size(), 0);
+    if (!flush_tx(client)) {
+        client.state = ConnState::CLOSED;
+        return false;
     }
+    update_events(client);
+    return true;
+}
 
-    return n == static_cast<ssize_t>(msg.size());
+void ControlServer::handle_message(Client& client, uint8_t type, const std::vector<uint8_t>& data) {
+    switch (type) {
+        case MSG_KEYFRAME_REQUEST:
+            if (m_keyframe_cb) {
+                m_keyframe_cb(client.id);
+            }
+            break;
+        case MSG_PING: {
+            // Echo back as pong
+            send_message(client, MSG_PONG, data.data(), data.size());
+            break;
+        }
+        case MSG_PONG:
+            handle_clock_pong(client, data, client.rx_stamp_us);
+            break;
+        case MSG_DISCONNECT:
+            LOG_INFO("Client %u sent disconnect message", client.id);
+            client.connected = false;
+            break;
+        case MSG_SET_PARAM:
+            handle_set_param(client, data);
+            break;
+        case MSG_PAUSE:
+        case MSG_RESUME: {
+            bool paused = (type == MSG_PAUSE);
+            if (client.paused == paused) {
+                break;
+            }
+            client.paused = paused;
+            LOG_INFO("Client %u %s", client.id, paused ? "paused" : "resumed");
+            if (m_pause_cb) {
+                m_pause_cb(client.id, paused);
+            }
+            break;
+        }
+    }
 }
 
 void ControlServer::process() {
-    if (m_client_socket < 0 || !m_client_connected) {
-        return;
-    }
+    // Never blocks: reads and writes whatever the sockets allow
+    pump(0, false);
 
-    // Check for incoming messages (non-blocking)
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(m_client_socket, &readfds);
+    int64_t now = now_us();
+    for (auto& client : m_clients) {
+        if (!client.connected) {
+            continue;
+        }
+
+        if ((client.clock_sync || client.heartbeat) && client.state != ConnState::CLOSED &&
+            now >= client.next_ping_us) {
+            send_clock_ping(client, now);
+        }
 
-    struct timeval tv = {0, 0};  // Non-blocking
-    if (select(m_client_socket + 1, &readfds, nullptr, nullptr, &tv) > 0) {
         uint8_t msg_type;
         std::vector<uint8_t> msg_data;
-        if (read_message(msg_type, msg_data)) {
-            switch (msg_type) {
-                case MSG_KEYFRAME_REQUEST:
-                    if (m_keyframe_cb) {
-                        m_keyframe_cb();
-                    }
-                    break;
-                case MSG_PING: {
-                    // Echo back as pong
-                    send_message(MSG_PONG, msg_data.data(), msg_data.size());
-                    break;
-                }
-                case MSG_DISCONNECT:
-                    LOG_INFO("Client sent disconnect message");
-                    m_client_connected = false;
-                    break;
-            }
-        } else {
-            // read_message failed - client disconnected
-            LOG_INFO("Client connection lost");
-            m_client_connected = false;
+        while (client.connected && take_message(client, msg_type, msg_data)) {
+            handle_message(client, msg_type, msg_data);
+        }
+
+        if (client.heartbeat && client.connected) {
+            check_heartbeat(client, now);
+        }
+
+        // Handed over on its 0-RTT config request; the handshake must
+        // still finish in time
+        if (client.handshaking && client.connected && now - client.handshake_start_us > TLS_HANDSHAKE_TIMEOUT_US) {
+            LOG_WARN("Client %u: TLS handshake did not complete, dropping it", client.id);
+            client.connected = false;
+        }
+
+        if (client.connected && client.state == ConnState::CLOSED) {
+            LOG_INFO("Client %u connection lost", client.id);
+            client.connected = false;
+        } else if (client.rx.empty()) {
+            client.partial_since_us = 0;
+        } else if (client.partial_since_us == 0) {
+            client.partial_since_us = now;
+        } else if (now - client.partial_since_us > MESSAGE_TIMEOUT_US) {
+            LOG_WARN("Client %u: incomplete control message for %lld ms, dropping it", client.id,
+                     static_cast<long long>(MESSAGE_TIMEOUT_US / 1000));
+            client.connected = false;
+        }
+    }
+
+    reap_disconnected();
+}
+
+void ControlServer::reap_disconnected() {
+    // Drop disconnected clients and let the server release their resources
+    for (size_t i = 0; i < m_clients.size();) {
+        if (m_clients[i].connected) {
+            i++;
+            continue;
+        }
+        Client client = std::move(m_clients[i]);
+        m_clients.erase(m_clients.begin() + i);
+        close_client(client);
+        if (m_disconnect_cb) {
+            m_disconnect_cb(client.id);
         }
     }
 }
 
 void ControlServer::reset() {
-    // Close client connection but keep listen socket
-    if (m_ssl) {
-        SSL_shutdown(m_ssl);
-        SSL_free(m_ssl);
-        m_ssl = nullptr;
+    // Close client connections but keep listen socket
+    for (auto& client : m_clients) {
+        close_client(client);
     }
-    if (m_client_socket >= 0) {
-        close(m_client_socket);
-        m_client_socket = -1;
+    m_clients.clear();
+    for (auto& client : m_pending) {
+        close_client(client);
     }
-    m_client_connected = false;
-    m_client_host.clear();
+    m_pending.clear();
 }
 
 void ControlServer::shutdown() {
@@ -371,6 +1173,10 @@ void ControlServer::shutdown() {
         close(m_listen_socket);
         m_listen_socket = -1;
     }
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
 }
 
 }  // namespace stream_tablet
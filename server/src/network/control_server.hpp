@@ -1,83 +1,241 @@
 #pragma once
 
+#include "clock_sync.hpp"
+#include "../util/latency_histogram.hpp"
 #include <cstdint>
 #include <string>
 #include <functional>
 #include <memory>
+#include <vector>
 #include <openssl/ssl.h>
 
 namespace stream_tablet {
 
 struct ClientInfo {
+    uint32_t id = 0;           // Control connection id (unique per server run)
     std::string host;
     uint16_t video_port = 0;
     uint16_t input_port = 0;
     int width = 0;
     int height = 0;
+    uint8_t capabilities = 0;  // CLIENT_CAP_* flags (0 for older clients)
+    std::vector<uint8_t> resume_token;  // Session token presented with CLIENT_CAP_RESUME
+};
+
+// TLS handshakes since the server started. Times run from accepting the
+// connection to the end of the handshake; cpu_us is the server's own time
+// in OpenSSL for it.
+struct TlsStats {
+    uint64_t full = 0;
+    uint64_t resumed = 0;          // Session ticket accepted
+    uint64_t early_accepted = 0;   // Config request arrived as 0-RTT data
+    uint64_t early_rejected = 0;   // Client offered 0-RTT data, server refused it
+    uint64_t failed = 0;
+    LatencyHistogram::Snapshot full_us;
+    LatencyHistogram::Snapshot resumed_us;
+    LatencyHistogram::Snapshot cpu_us;
 };
 
 class ControlServer {
 public:
     using ClientConnectCallback = std::function<void(const ClientInfo&)>;
-    using ClientDisconnectCallback = std::function<void()>;
-    using KeyframeRequestCallback = std::function<void()>;
+    using ClientDisconnectCallback = std::function<void(uint32_t client_id)>;
+    using KeyframeRequestCallback = std::function<void(uint32_t client_id)>;
+    using PauseCallback = std::function<void(uint32_t client_id, bool paused)>;
+    // Apply a PARAM_* change; set 'value' to what is now in effect and
+    // return a PARAM_* status
+    using ParamCallback = std::function<uint8_t(uint32_t client_id, uint8_t param, int32_t& value)>;
+    // Runs between waits while accept_client() blocks (about every 100 ms)
+    using IdleCallback = std::function<void()>;
 
     ControlServer();
     ~ControlServer();
 
-    // Initialize server with TLS
+    // Initialize server with TLS 1.3. Clients get session tickets, so a
+    // reconnect resumes without the certificate exchange. Fails (never
+    // falls back to plain TCP) if the certificate or key can't be used.
     bool init(uint16_t port, const std::string& cert_file, const std::string& key_file);
 
+    // Accept the config request as 0-RTT data from resuming clients and
+    // answer it before their handshake completes (call before init).
+    // Tickets are single-use for 0-RTT, so early data can't be replayed.
+    void set_early_data(bool enabled) { m_early_data = enabled; }
+
     // Initialize server without TLS (for development)
     bool init_plain(uint16_t port);
 
-    // Accept client connection (blocking)
+    bool is_tls() const { return m_use_tls; }
+
+    // Allow this many concurrent clients (call before init)
+    void set_max_clients(int max_clients) { m_max_clients = max_clients < 1 ? 1 : max_clients; }
+
+    // Ping clients with CLIENT_CAP_HEARTBEAT at least every interval_ms and
+    // call them unresponsive after 'misses' intervals without hearing from
+    // them (0 = off). All client sockets also get TCP keepalive on that
+    // schedule, so peers that vanish without a FIN are noticed.
+    void set_heartbeat(int interval_ms, int misses);
+
+    // Wait until a client has completed setup (TLS handshake and config
+    // request). Connections in setup progress side by side with per-state
+    // timeouts, so a stalled peer doesn't hold up others. Returns false if
+    // interrupted by a signal.
     bool accept_client(ClientInfo& out_info);
 
+    // Hand over a client that completed setup, if any (non-blocking, call
+    // from the stream loop). Connections beyond the client limit are closed
+    // right away.
+    bool poll_accept(ClientInfo& out_info);
+
     // Send configuration to client
-    bool send_config(int screen_width, int screen_height, int video_port, int input_port);
+    bool send_config(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port);
 
     // Send configuration with audio info
-    bool send_config_with_audio(int screen_width, int screen_height, int video_port, int input_port,
+    bool send_config_with_audio(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port,
                                  int audio_port, int audio_sample_rate, int audio_channels, int audio_frame_ms);
 
-    // Send configuration with audio and codec info
-    bool send_config_full(int screen_width, int screen_height, int video_port, int input_port,
+    // Send configuration with audio, codec and stream flags (STREAM_FLAG_*).
+    // STREAM_FLAG_CLOCK_SYNC also starts the clock pings to that client.
+    bool send_config_full(uint32_t client_id, int screen_width, int screen_height, int video_port, int input_port,
                           int audio_port, int audio_sample_rate, int audio_channels, int audio_frame_ms,
-                          uint8_t codec_type);
+                          uint8_t codec_type, uint8_t stream_flags = 0,
+                          const std::string& multicast_group = "", int multicast_port = 0,
+                          const std::vector<uint8_t>& session_token = {});
 
-    // Process incoming messages (call periodically)
+    // Process incoming messages (call periodically; never blocks)
     void process();
 
     // Callbacks
     void set_keyframe_callback(KeyframeRequestCallback cb) { m_keyframe_cb = std::move(cb); }
+    void set_disconnect_callback(ClientDisconnectCallback cb) { m_disconnect_cb = std::move(cb); }
+    void set_pause_callback(PauseCallback cb) { m_pause_cb = std::move(cb); }
+    void set_param_callback(ParamCallback cb) { m_param_cb = std::move(cb); }
+    void set_idle_callback(IdleCallback cb) { m_idle_cb = std::move(cb); }
 
-    // Get client address (for video sender)
-    std::string get_client_host() const { return m_client_host; }
+    // Check if any client is still connected
+    bool is_client_connected() const { return !m_clients.empty(); }
+    size_t get_client_count() const { return m_clients.size(); }
 
-    // Check if client is still connected
-    bool is_client_connected() const { return m_client_connected; }
+    // Any connected client that wants video: not paused and not known to be
+    // silent (clients without heartbeats always count)
+    bool has_active_client() const;
+    bool is_client_paused(uint32_t client_id) const;
 
-    // Reset for new connection
+    // Clock estimate for a client that was sent STREAM_FLAG_CLOCK_SYNC
+    // (nullptr for unknown clients; check is_synced())
+    const ClockSync* get_clock_sync(uint32_t client_id) const;
+
+    // Server side of the clock exchange (CLOCK_MONOTONIC, microseconds)
+    static int64_t now_us();
+
+    TlsStats get_tls_stats();
+
+    // Reset for new connection (closes all clients)
     void reset();
 
     void shutdown();
 
 private:
+    // All sockets are non-blocking and driven from one epoll set
+    enum class ConnState {
+        TLS_HANDSHAKE,  // SSL handshake in progress
+        CONFIG,         // Waiting for MSG_CONFIG_REQUEST
+        READY,          // Config received, not handed to the server yet
+        ACTIVE,         // Streaming
+        CLOSED          // Peer gone or protocol error; reaped by process()
+    };
+
+    struct Client {
+        uint32_t id = 0;
+        int socket = -1;
+        SSL* ssl = nullptr;
+        std::string host;
+        bool connected = false;   // Active and not disconnected
+
+        ConnState state = ConnState::CONFIG;
+        int64_t deadline_us = 0;  // Setup state must end by then (0 = none)
+        ClientInfo info;          // From the config request
+        std::vector<uint8_t> rx;  // Received, not yet a whole message
+        std::vector<uint8_t> tx;  // Queued, not yet accepted by the socket
+        bool want_write = false;  // TLS needs a writable socket to go on
+
+        // TLS handshake, which may still be finishing after a config
+        // request that came as early data has moved the client on
+        bool handshaking = false;
+        size_t early_bytes = 0;   // 0-RTT data accepted: replies go out as 0.5-RTT data
+        bool early_done = false;  // No more early data; replies wait for the handshake
+        int64_t handshake_start_us = 0;
+        int64_t handshake_cpu_us = 0;
+        uint32_t epoll_events = 0;
+        int64_t partial_since_us = 0;  // rx has held an incomplete message since (0 = none)
+        int64_t rx_stamp_us = 0;  // Arrival of the last read (clock sync)
+
+        // Clock sync: server-initiated pings, burst first
+        bool clock_sync = false;
+        ClockSync clock;
+        int pings_sent = 0;
+        int64_t next_ping_us = 0;
+
+        // Heartbeats (CLIENT_CAP_HEARTBEAT): any received byte counts
+        bool heartbeat = false;
+        bool responsive = true;
+        int64_t last_rx_us = 0;
+
+        bool paused = false;      // MSG_PAUSE until MSG_RESUME
+
+        // Sent with STREAM_FLAG_RESUME; a new connection presenting it
+        // replaces this one
+        std::vector<uint8_t> session_token;
+    };
+
     bool init_tls(const std::string& cert_file, const std::string& key_file);
-    bool read_message(uint8_t& type, std::vector<uint8_t>& data);
-    bool send_message(uint8_t type, const uint8_t* data, size_t len);
+    bool init_poller();
+    bool pump(int timeout_ms, bool accept_new);
+    void accept_pending();
+    void set_state(Client& client, ConnState state, int64_t timeout_us);
+    bool take_ready(ClientInfo& out_info);
+    bool drop_replaced(const std::vector<uint8_t>& token);
+    void reap_disconnected();
+    void advance(Client& client, uint32_t events);
+    bool continue_handshake(Client& client);
+    void finish_handshake(Client& client);
+    bool read_available(Client& client);
+    bool flush_tx(Client& client);
+    bool take_message(Client& client, uint8_t& type, std::vector<uint8_t>& data);
+    void update_events(Client& client);
+    void handle_message(Client& client, uint8_t type, const std::vector<uint8_t>& data);
+    Client* find_client(uint32_t id);
+    Client* find_by_fd(int fd);
+    void send_clock_ping(Client& client, int64_t now);
+    void check_heartbeat(Client& client, int64_t now);
+    void configure_keepalive(Client& client);
+    void handle_clock_pong(Client& client, const std::vector<uint8_t>& data, int64_t received_us);
+    void handle_set_param(Client& client, const std::vector<uint8_t>& data);
+    void close_client(Client& client);
+    bool send_message(Client& client, uint8_t type, const uint8_t* data, size_t len);
+    bool send_message(uint32_t client_id, uint8_t type, const uint8_t* data, size_t len);
 
     int m_listen_socket = -1;
-    int m_client_socket = -1;
-    std::string m_client_host;
-    bool m_client_connected = false;
+    int m_epoll_fd = -1;
+    int m_max_clients = 1;
+    int m_heartbeat_ms = 0;
+    int m_heartbeat_misses = 3;
+    std::vector<Client> m_clients;   // Active
+    std::vector<Client> m_pending;   // In setup
+    uint32_t m_next_client_id = 1;
 
     SSL_CTX* m_ssl_ctx = nullptr;
-    SSL* m_ssl = nullptr;
     bool m_use_tls = false;
+    bool m_early_data = true;
+    TlsStats m_tls_counts;  // Counters only; the times are in the histograms
+    LatencyHistogram m_tls_full_us;
+    LatencyHistogram m_tls_resumed_us;
+    LatencyHistogram m_tls_cpu_us;
 
     KeyframeRequestCallback m_keyframe_cb;
+    ClientDisconnectCallback m_disconnect_cb;
+    PauseCallback m_pause_cb;
+    ParamCallback m_param_cb;
+    IdleCallback m_idle_cb;
 };
 
 // Control message types
@@ -89,5 +247,65 @@ constexpr uint8_t MSG_KEYFRAME_REQUEST = 0x05;
 constexpr uint8_t MSG_PING = 0x06;
 constexpr uint8_t MSG_PONG = 0x07;
 constexpr uint8_t MSG_DISCONNECT = 0x08;
+constexpr uint8_t MSG_PAUSE = 0x09;   // Client can't show video (screen off, app in background)
+constexpr uint8_t MSG_RESUME = 0x0A;  // Client shows video again; a keyframe follows
+constexpr uint8_t MSG_SET_PARAM = 0x0B;     // Change stream parameters (below)
+constexpr uint8_t MSG_PARAM_RESULT = 0x0C;  // Answer to MSG_SET_PARAM
+
+// Client capability flags (optional config request byte 8)
+constexpr uint8_t CLIENT_CAP_MUX = 0x01;     // Can receive multiplexed UDP
+constexpr uint8_t CLIENT_CAP_ECN = 0x02;     // Reads ECN bits and sends receiver reports
+constexpr uint8_t CLIENT_CAP_MULTICAST = 0x04;  // Can join a multicast group for video
+constexpr uint8_t CLIENT_CAP_COMPACT_INPUT = 0x08;  // Can send compact input batches
+constexpr uint8_t CLIENT_CAP_UDP_INPUT = 0x10;   // Can send redundant input datagrams
+constexpr uint8_t CLIENT_CAP_CLOCK_SYNC = 0x20;  // Answers server pings with its clock
+constexpr uint8_t CLIENT_CAP_RESUME = 0x40;      // Keeps a session token across reconnects
+constexpr uint8_t CLIENT_CAP_HEARTBEAT = 0x80;   // Answers every server ping (see below)
+
+// Stream flags (optional config response byte 15)
+constexpr uint8_t STREAM_FLAG_MUX = 0x01;    // Video/audio/feedback share the video port
+constexpr uint8_t STREAM_FLAG_ECN = 0x02;    // Video is ECT(1)-marked, CE counts expected in reports
+constexpr uint8_t STREAM_FLAG_MULTICAST = 0x04;  // Video goes to the group in bytes 16-21
+constexpr uint8_t STREAM_FLAG_COMPACT_INPUT = 0x08;  // Input connection uses the compact format
+constexpr uint8_t STREAM_FLAG_UDP_INPUT = 0x10;  // Send input as datagrams to the input port
+constexpr uint8_t STREAM_FLAG_CLOCK_SYNC = 0x20;  // Server will send clock pings
+constexpr uint8_t STREAM_FLAG_RESUME = 0x40;   // Response ends with a session token
+constexpr uint8_t STREAM_FLAG_RESUMED = 0x80;  // Token accepted, stream state was kept
+
+// Clock sync (STREAM_FLAG_CLOCK_SYNC), all fields big-endian microseconds:
+//   server -> client MSG_PING [t1:8]               t1 = server send time
+//   client -> server MSG_PONG [t1:8][t2:8][t3:8]   t2/t3 = client receive/send
+// t2 and t3 are on the clock the client's input timestamps come from
+// (timestamp_ms = low 32 bits of that clock in ms). Client-initiated pings
+// are still echoed unchanged.
+constexpr size_t CLOCK_PING_SIZE = 8;
+constexpr size_t CLOCK_PONG_SIZE = 24;
+
+// Heartbeats (CLIENT_CAP_HEARTBEAT): the server sends MSG_PING at least once
+// per heartbeat interval (default 1 s) and the client answers each with
+// MSG_PONG (the clock form above, or [t1:8] echoed). Either side can treat a
+// few silent intervals as the other one being gone.
+
+// Runtime parameters: MSG_SET_PARAM carries [param:1][value:4] pairs, the
+// answer has [param:1][status:1][value:4] for each, value being what is now
+// in effect (requests are clamped to the valid range). Values are signed
+// big-endian. Only the primary client may change the shared stream.
+constexpr uint8_t PARAM_FPS = 0x01;         // Capture frame rate
+constexpr uint8_t PARAM_BITRATE = 0x02;     // Bitrate ceiling of the full-size encode, bps
+constexpr uint8_t PARAM_QP = 0x03;          // CQP level (auto and high quality modes)
+constexpr uint8_t PARAM_PACING = 0x04;      // PacingMode (0 = auto ... 4 = keyframe)
+constexpr uint8_t PARAM_RESOLUTION = 0x05;  // (width << 16) | height, 0 = capture size
+constexpr size_t PARAM_ENTRY_SIZE = 5;
+
+constexpr uint8_t PARAM_OK = 0;
+constexpr uint8_t PARAM_UNKNOWN = 1;
+constexpr uint8_t PARAM_REJECTED = 2;       // Not allowed now, or failed
+
+// Session resume (CLIENT_CAP_RESUME): a response with STREAM_FLAG_RESUME ends
+// with [session_token:16]. A client that reconnects within the server's grace
+// period appends that token to its config request, after the capability
+// byte. With STREAM_FLAG_RESUMED the rate estimate and rung carry over and
+// the last keyframe follows the config immediately.
+constexpr size_t SESSION_TOKEN_SIZE = 16;
 
 }  // namespace stream_tablet
@@ -0,0 +1,264 @@
+#include "egress_scheduler.hpp"
+#include "../util/logger.hpp"
+#include <sys/socket.h>
+#include <netinet/ip.h>
+#include <cerrno>
+#include <cstring>
+
+namespace stream_tablet {
+
+namespace {
+
+struct ClassParams {
+    const char* name;
+    int dscp;           // DiffServ codepoint (upper 6 bits of TOS)
+    int priority;       // SO_PRIORITY (0-6 allowed without CAP_NET_ADMIN)
+    size_t quantum;     // DRR quantum in bytes per round
+    size_t max_queue;   // Max queued packets before dropping
+};
+
+// audio > delta video > keyframe/refresh
+constexpr ClassParams CLASS_PARAMS[TRAFFIC_CLASS_COUNT] = {
+    {"audio",    46, 6, 8 * 1500,  256},   // EF
+    {"delta",    34, 4, 2 * 1500,  4096},  // AF41
+    {"keyframe", 36, 3, 1 * 1500,  4096},  // AF42
+};
+
+}  // namespace
+
+EgressScheduler::EgressScheduler() = default;
+
+EgressScheduler::~EgressScheduler() {
+    stop();
+}
+
+const char* EgressScheduler::class_name(TrafficClass cls) {
+    size_t idx = static_cast<size_t>(cls);
+    return idx < TRAFFIC_CLASS_COUNT ? CLASS_PARAMS[idx].name : "unknown";
+}
+
+bool send_datagram_tos(int fd, const struct sockaddr_in& dest,
+                       const uint8_t* data, size_t size, int tos) {
+    struct iovec iov;
+    iov.iov_base = const_cast<uint8_t*>(data);
+    iov.iov_len = size;
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+    struct msghdr msg = {};
+    msg.msg_name = const_cast<struct sockaddr_in*>(&dest);
+    msg.msg_namelen = sizeof(dest);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_TOS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &tos, sizeof(tos));
+
+    return sendmsg(fd, &msg, 0) >= 0;
+}
+
+void EgressScheduler::mark_socket(int fd, TrafficClass cls, uint8_t ecn) {
+    if (fd < 0) return;
+    const ClassParams& params = CLASS_PARAMS[static_cast<size_t>(cls)];
+
+    int priority = params.priority;
+    if (setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority)) < 0) {
+        LOG_WARN("Failed to set SO_PRIORITY %d: %s", priority, strerror(errno));
+    }
+
+    int tos = (params.dscp << 2) | (ecn & 0x03);
+    if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0) {
+        LOG_WARN("Failed to set IP_TOS 0x%02x: %s", tos, strerror(errno));
+    }
+}
+
+bool EgressScheduler::start(EgressMode mode) {
+    if (mode == EgressMode::OFF) {
+        return false;
+    }
+    if (m_running) {
+        return true;
+    }
+
+    m_mode = mode;
+    m_last_stats_log = std::chrono::steady_clock::now();
+    m_running = true;
+    m_thread = std::thread(&EgressScheduler::sender_thread, this);
+
+    LOG_INFO("Egress scheduler started (%s)",
+             mode == EgressMode::STRICT ? "strict priority" : "weighted");
+    return true;
+}
+
+void EgressScheduler::stop() {
+    if (!m_running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    clear();
+}
+
+bool EgressScheduler::enqueue(TrafficClass cls, int fd, const struct sockaddr_in& dest,
+                              const uint8_t* data, size_t size, uint8_t ecn) {
+    size_t idx = static_cast<size_t>(cls);
+    if (idx >= TRAFFIC_CLASS_COUNT || fd < 0) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return false;
+        }
+        auto& queue = m_queues[idx];
+        if (queue.size() >= CLASS_PARAMS[idx].max_queue) {
+            m_stats[idx].drops++;
+            return false;
+        }
+        queue.push_back(Packet{fd, dest, std::vector<uint8_t>(data, data + size),
+                               std::chrono::steady_clock::now(), ecn});
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+void EgressScheduler::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; i++) {
+        m_queues[i].clear();
+        m_deficit[i] = 0;
+    }
+    m_drr_current = 0;
+    m_drr_fresh = true;
+}
+
+EgressClassStats EgressScheduler::get_stats(TrafficClass cls) const {
+    size_t idx = static_cast<size_t>(cls);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EgressClassStats stats = m_stats[idx];
+    stats.queue_depth = m_queues[idx].size();
+    return stats;
+}
+
+int EgressScheduler::pick_class_locked() {
+    if (m_mode == EgressMode::STRICT) {
+        for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; i++) {
+            if (!m_queues[i].empty()) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Deficit round robin: each visit grants the class its quantum, and the
+    // class is served while its head packet fits in the accumulated deficit.
+    // Quanta are >= one MTU, so a non-empty class is served within two rounds.
+    for (size_t attempts = 0; attempts < 4 * TRAFFIC_CLASS_COUNT; attempts++) {
+        size_t idx = m_drr_current;
+        auto& queue = m_queues[idx];
+
+        if (queue.empty()) {
+            m_deficit[idx] = 0;
+        } else {
+            if (m_drr_fresh) {
+                m_deficit[idx] += CLASS_PARAMS[idx].quantum;
+                m_drr_fresh = false;
+            }
+            size_t size = queue.front().data.size();
+            if (size <= m_deficit[idx]) {
+                m_deficit[idx] -= size;
+                return static_cast<int>(idx);
+            }
+        }
+
+        m_drr_current = (m_drr_current + 1) % TRAFFIC_CLASS_COUNT;
+        m_drr_fresh = true;
+    }
+
+    return -1;
+}
+
+bool EgressScheduler::send_packet(TrafficClass cls, const Packet& packet) {
+    // Per-packet TOS so classes sharing a socket (delta vs keyframe) keep their own DSCP
+    int tos = (CLASS_PARAMS[static_cast<size_t>(cls)].dscp << 2) | (packet.ecn & 0x03);
+
+    if (!send_datagram_tos(packet.fd, packet.dest, packet.data.data(), packet.data.size(), tos)) {
+        LOG_ERROR("Egress send failed (%s): %s", class_name(cls), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EgressScheduler::sender_thread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running) {
+        int cls = pick_class_locked();
+        if (cls < 0) {
+            // Wake periodically so stats are logged even when idle
+            m_cv.wait_for(lock, std::chrono::seconds(1));
+            log_stats_locked();
+            continue;
+        }
+
+        Packet packet = std::move(m_queues[cls].front());
+        m_queues[cls].pop_front();
+
+        lock.unlock();
+        auto now = std::chrono::steady_clock::now();
+        bool ok = send_packet(static_cast<TrafficClass>(cls), packet);
+        lock.lock();
+
+        uint64_t delay_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - packet.enqueued).count();
+        EgressClassStats& stats = m_stats[cls];
+        if (ok) {
+            stats.packets++;
+            stats.bytes += packet.data.size();
+        } else {
+            stats.drops++;
+        }
+        stats.window_packets++;
+        stats.window_delay_us += delay_us;
+        if (delay_us > stats.max_delay_us) stats.max_delay_us = delay_us;
+
+        log_stats_locked();
+    }
+}
+
+void EgressScheduler::log_stats_locked() {
+    // Log queue delay stats every 5 seconds
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration_cast<std::chrono::seconds>(now - m_last_stats_log).count() < 5) {
+        return;
+    }
+    m_last_stats_log = now;
+
+    for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; i++) {
+        EgressClassStats& stats = m_stats[i];
+        if (stats.window_packets > 0) {
+            LOG_INFO("Egress %s: queue delay avg=%.2fms max=%.2fms | depth=%zu drops=%lu packets=%lu",
+                     CLASS_PARAMS[i].name,
+                     stats.window_delay_us / 1000.0 / stats.window_packets,
+                     stats.max_delay_us / 1000.0,
+                     m_queues[i].size(), stats.drops, stats.packets);
+        }
+        stats.window_packets = 0;
+        stats.window_delay_us = 0;
+        stats.max_delay_us = 0;
+    }
+}
+
+}  // namespace stream_tablet
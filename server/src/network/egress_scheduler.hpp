@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <netinet/in.h>
+
+namespace stream_tablet {
+
+// Traffic classes, highest priority first
+enum class TrafficClass : uint8_t {
+    AUDIO = 0,          // Opus packets (small, latency critical)
+    VIDEO_DELTA = 1,    // Inter frames
+    VIDEO_KEYFRAME = 2, // Keyframes / refresh frames (large bursts)
+    COUNT
+};
+
+constexpr size_t TRAFFIC_CLASS_COUNT = static_cast<size_t>(TrafficClass::COUNT);
+
+enum class EgressMode {
+    OFF,        // Senders write directly to their sockets
+    STRICT,     // Strict priority: always drain the highest non-empty class first
+    WEIGHTED    // Deficit round robin with per-class byte quanta
+};
+
+// Per-class counters. Delay fields cover the current stats window.
+struct EgressClassStats {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t drops = 0;
+    uint64_t window_packets = 0;
+    uint64_t window_delay_us = 0;
+    uint64_t max_delay_us = 0;
+    size_t queue_depth = 0;
+};
+
+// Unified egress scheduler for all UDP media sockets.
+// Senders enqueue datagrams tagged with a traffic class; a single sender thread
+// drains the queues so a keyframe burst cannot sit in front of audio packets.
+// Each class is marked with its own DSCP codepoint and socket priority.
+class EgressScheduler {
+public:
+    EgressScheduler();
+    ~EgressScheduler();
+
+    EgressScheduler(const EgressScheduler&) = delete;
+    EgressScheduler& operator=(const EgressScheduler&) = delete;
+
+    // Start the sender thread
+    bool start(EgressMode mode);
+
+    // Stop the sender thread and drop anything still queued
+    void stop();
+
+    // Queue a datagram for sending (copies data). Returns false if the class queue is full.
+    // ecn is OR-ed into the class TOS byte (ECN_* codepoint).
+    bool enqueue(TrafficClass cls, int fd, const struct sockaddr_in& dest,
+                 const uint8_t* data, size_t size, uint8_t ecn = 0);
+
+    // Drop all queued packets (e.g. on client disconnect)
+    void clear();
+
+    // Apply the default DSCP (plus ECN bits) and SO_PRIORITY of a class to a socket
+    static void mark_socket(int fd, TrafficClass cls, uint8_t ecn = 0);
+
+    EgressClassStats get_stats(TrafficClass cls) const;
+
+    EgressMode get_mode() const { return m_mode; }
+    bool is_running() const { return m_running; }
+
+    static const char* class_name(TrafficClass cls);
+
+private:
+    struct Packet {
+        int fd;
+        struct sockaddr_in dest;
+        std::vector<uint8_t> data;
+        std::chrono::steady_clock::time_point enqueued;
+        uint8_t ecn;
+    };
+
+    void sender_thread();
+    int pick_class_locked();
+    bool send_packet(TrafficClass cls, const Packet& packet);
+    void log_stats_locked();
+
+    EgressMode m_mode = EgressMode::OFF;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Packet> m_queues[TRAFFIC_CLASS_COUNT];
+    EgressClassStats m_stats[TRAFFIC_CLASS_COUNT];
+    std::chrono::steady_clock::time_point m_last_stats_log;
+
+    // Deficit round robin state (WEIGHTED mode)
+    size_t m_deficit[TRAFFIC_CLASS_COUNT] = {};
+    size_t m_drr_current = 0;
+    bool m_drr_fresh = true;
+};
+
+// Send one datagram with an explicit TOS byte (per-packet IP_TOS cmsg)
+bool send_datagram_tos(int fd, const struct sockaddr_in& dest,
+                       const uint8_t* data, size_t size, int tos);
+
+}  // namespace stream_tablet
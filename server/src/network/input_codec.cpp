@@ -0,0 +1,226 @@
+#include "input_codec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace stream_tablet {
+
+static constexpr float UNIT_SCALE = 65535.0f;
+static constexpr float TILT_SCALE = 32767.0f / 3.14159265f;
+
+static inline uint16_t load16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline void store16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+static inline uint16_t quantize_unit(float v) {
+    // NaN compares false and ends up as 0
+    float clamped = (v > 0.0f) ? std::min(v, 1.0f) : 0.0f;
+    return static_cast<uint16_t>(std::lround(clamped * UNIT_SCALE));
+}
+
+static inline int16_t quantize_tilt(float v) {
+    float scaled = (v == v) ? v * TILT_SCALE : 0.0f;
+    return static_cast<int16_t>(std::lround(std::clamp(scaled, -32767.0f, 32767.0f)));
+}
+
+void decode_legacy_packet(const InputEventPacket& packet, InputEvent& event) {
+    event.type = static_cast<InputEventType>(packet.type);
+    event.pointer_id = packet.pointer_id;
+    event.x = packet.x;
+    event.y = packet.y;
+    event.pressure = packet.pressure;
+    event.tilt_x = packet.tilt_x;
+    event.tilt_y = packet.tilt_y;
+    event.buttons = packet.buttons;
+    event.timestamp_ms = packet.timestamp;
+}
+
+void encode_legacy_packet(const InputEvent& event, InputEventPacket& packet) {
+    packet.type = static_cast<uint8_t>(event.type);
+    packet.pointer_id = event.pointer_id;
+    packet.x = event.x;
+    packet.y = event.y;
+    packet.pressure = event.pressure;
+    packet.tilt_x = event.tilt_x;
+    packet.tilt_y = event.tilt_y;
+    packet.buttons = event.buttons;
+    packet.timestamp = event.timestamp_ms;
+}
+
+bool is_input_transition(InputEventType type) {
+    switch (type) {
+        case InputEventType::TOUCH_MOVE:
+        case InputEventType::STYLUS_MOVE:
+        case InputEventType::STYLUS_HOVER:
+            return false;
+        default:
+            return true;
+    }
+}
+
+bool build_input_datagram(uint32_t first_seq, const InputEvent* events, size_t count,
+                          std::vector<uint8_t>& out) {
+    CompactInputEncoder encoder;
+    for (size_t i = 0; i < count; i++) {
+        if (!encoder.add(events[i])) {
+            return false;
+        }
+    }
+    std::vector<uint8_t> batch;
+    encoder.finish(batch);
+
+    out.clear();
+    store16(out, INPUT_DATAGRAM_MAGIC);
+    store16(out, static_cast<uint16_t>(first_seq));
+    store16(out, static_cast<uint16_t>(first_seq >> 16));
+    if (batch.size() > 2) {
+        out.insert(out.end(), batch.begin() + 2, batch.end());  // Without the length prefix
+    }
+    return true;
+}
+
+void CompactInputDecoder::reset() {
+    *this = CompactInputDecoder();
+}
+
+bool CompactInputDecoder::decode(const uint8_t* payload, size_t size, std::vector<InputEvent>& out) {
+    const uint8_t* p = payload;
+    const uint8_t* end = payload + size;
+
+    while (p < end) {
+        const uint8_t head = p[0];
+        const uint8_t type = head & COMPACT_TYPE_MASK;
+        if (type == 0 || type > static_cast<uint8_t>(InputEventType::KEY_UP)) {
+            return false;
+        }
+
+        // Timestamp delta: nearly always one byte
+        uint32_t dt = p[1] & 0x7F;
+        p += 2;
+        if (p[-1] & 0x80) {
+            int shift = 7;
+            do {
+                if (shift > 28) {
+                    return false;
+                }
+                dt |= static_cast<uint32_t>(p[0] & 0x7F) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+        }
+
+        // Optional fields: load unconditionally (the scratch is padded),
+        // select by flag and advance by the flag mask
+        const uint16_t x = load16(p);
+        const uint16_t y = load16(p + 2);
+        p += 4;
+
+        const uint32_t has_pointer = (head >> 4) & 1;
+        m_pointer = has_pointer ? p[0] : m_pointer;
+        p += has_pointer;
+
+        const uint32_t has_pressure = (head >> 5) & 1;
+        const uint16_t pressure = load16(p);
+        m_pressure = has_pressure ? pressure : m_pressure;
+        p += 2 * has_pressure;
+
+        const uint32_t has_tilt = (head >> 6) & 1;
+        const int16_t tilt_x = static_cast<int16_t>(load16(p));
+        const int16_t tilt_y = static_cast<int16_t>(load16(p + 2));
+        m_tilt_x = has_tilt ? tilt_x : m_tilt_x;
+        m_tilt_y = has_tilt ? tilt_y : m_tilt_y;
+        p += 4 * has_tilt;
+
+        const uint32_t has_buttons = (head >> 7) & 1;
+        const uint16_t buttons = load16(p);
+        m_buttons = has_buttons ? buttons : m_buttons;
+        p += 2 * has_buttons;
+
+        if (p > end) {
+            return false;  // Sample ran past the batch
+        }
+
+        m_timestamp += dt;
+
+        InputEvent event;
+        event.type = static_cast<InputEventType>(type);
+        event.pointer_id = m_pointer;
+        event.x = x * (1.0f / UNIT_SCALE);
+        event.y = y * (1.0f / UNIT_SCALE);
+        event.pressure = m_pressure * (1.0f / UNIT_SCALE);
+        event.tilt_x = m_tilt_x * (1.0f / TILT_SCALE);
+        event.tilt_y = m_tilt_y * (1.0f / TILT_SCALE);
+        event.buttons = m_buttons;
+        event.timestamp_ms = m_timestamp;
+        out.push_back(event);
+    }
+    return true;
+}
+
+void CompactInputEncoder::reset() {
+    *this = CompactInputEncoder();
+}
+
+bool CompactInputEncoder::add(const InputEvent& event) {
+    if (m_payload.size() + COMPACT_MAX_SAMPLE > COMPACT_MAX_PAYLOAD) {
+        return false;
+    }
+
+    const uint16_t pressure = quantize_unit(event.pressure);
+    const int16_t tilt_x = quantize_tilt(event.tilt_x);
+    const int16_t tilt_y = quantize_tilt(event.tilt_y);
+
+    uint8_t head = static_cast<uint8_t>(event.type) & COMPACT_TYPE_MASK;
+    if (m_first || event.pointer_id != m_pointer) head |= COMPACT_HAS_POINTER;
+    if (m_first || pressure != m_pressure) head |= COMPACT_HAS_PRESSURE;
+    if (m_first || tilt_x != m_tilt_x || tilt_y != m_tilt_y) head |= COMPACT_HAS_TILT;
+    if (m_first || event.buttons != m_buttons) head |= COMPACT_HAS_BUTTONS;
+    m_payload.push_back(head);
+
+    uint32_t dt = event.timestamp_ms - m_timestamp;
+    do {
+        uint8_t byte = dt & 0x7F;
+        dt >>= 7;
+        m_payload.push_back(dt ? (byte | 0x80) : byte);
+    } while (dt);
+
+    store16(m_payload, quantize_unit(event.x));
+    store16(m_payload, quantize_unit(event.y));
+    if (head & COMPACT_HAS_POINTER) {
+        m_payload.push_back(event.pointer_id);
+    }
+    if (head & COMPACT_HAS_PRESSURE) {
+        store16(m_payload, pressure);
+    }
+    if (head & COMPACT_HAS_TILT) {
+        store16(m_payload, static_cast<uint16_t>(tilt_x));
+        store16(m_payload, static_cast<uint16_t>(tilt_y));
+    }
+    if (head & COMPACT_HAS_BUTTONS) {
+        store16(m_payload, event.buttons);
+    }
+
+    m_first = false;
+    m_timestamp = event.timestamp_ms;
+    m_pointer = event.pointer_id;
+    m_pressure = pressure;
+    m_tilt_x = tilt_x;
+    m_tilt_y = tilt_y;
+    m_buttons = event.buttons;
+    return true;
+}
+
+void CompactInputEncoder::finish(std::vector<uint8_t>& out) {
+    if (m_payload.empty()) {
+        return;
+    }
+    store16(out, static_cast<uint16_t>(m_payload.size()));
+    out.insert(out.end(), m_payload.begin(), m_payload.end());
+    m_payload.clear();
+}
+
+}  // namespace stream_tablet
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "input_receiver.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace stream_tablet {
+
+// Compact input wire format (negotiated with CLIENT_CAP_COMPACT_INPUT).
+// Little-endian like InputEventPacket. The stream is a sequence of batches:
+//
+//   [payload_len:2][sample]...           1 <= payload_len <= COMPACT_MAX_PAYLOAD
+//
+//   sample: [head:1][dt:varint][x:2][y:2]
+//           [pointer_id:1]               if head & COMPACT_HAS_POINTER
+//           [pressure:2]                 if head & COMPACT_HAS_PRESSURE
+//           [tilt_x:2][tilt_y:2]         if head & COMPACT_HAS_TILT
+//           [buttons:2]                  if head & COMPACT_HAS_BUTTONS
+//
+// head bits 0-3 are the InputEventType. dt is the LEB128 timestamp delta in
+// ms from the previous sample of the connection (the first sample carries
+// the absolute timestamp; deltas wrap modulo 2^32). x, y and pressure are
+// 0-65535 for 0-1; tilts are signed, 32767 = pi. A field that is left out
+// repeats the previous sample's value (zero at connection start).
+//
+// A pen-down move with pressure and tilt is 12-13 bytes instead of 28.
+
+constexpr uint8_t COMPACT_TYPE_MASK = 0x0F;
+constexpr uint8_t COMPACT_HAS_POINTER = 0x10;
+constexpr uint8_t COMPACT_HAS_PRESSURE = 0x20;
+constexpr uint8_t COMPACT_HAS_TILT = 0x40;
+constexpr uint8_t COMPACT_HAS_BUTTONS = 0x80;
+
+constexpr size_t COMPACT_MAX_PAYLOAD = 1024;
+constexpr size_t COMPACT_MAX_SAMPLE = 19;
+
+// Decoder scratch must have this much readable slack past the payload:
+// fields are loaded unconditionally and the pointer advanced by flag masks
+constexpr size_t COMPACT_DECODE_PADDING = 32;
+
+// UDP input datagram (negotiated with CLIENT_CAP_UDP_INPUT), client -> server:
+//
+//   [magic:2][first_seq:4][sample]...
+//
+// Samples use the compact layout above with sequence numbers first_seq,
+// first_seq + 1, ...; decoding starts from zero state in every datagram, so
+// each one stands alone. A datagram carries the newest sample plus the K
+// before it, and reaches back further to the oldest DOWN/UP/KEY sample the
+// server hasn't acknowledged yet: transitions are resent until acked,
+// moves are simply superseded. The server applies each sequence number
+// once, in order, and skips ones it never saw.
+//
+// Ack, server -> client: [magic:2][seq:4], the highest sequence applied.
+// Sent after datagrams that carry a transition and every ~100 ms otherwise.
+
+constexpr uint16_t INPUT_DATAGRAM_MAGIC = 0x5349;  // "SI"
+constexpr size_t INPUT_DATAGRAM_HEADER = 6;
+constexpr size_t INPUT_DATAGRAM_MAX = INPUT_DATAGRAM_HEADER + COMPACT_MAX_PAYLOAD;
+
+// DOWN/UP/KEY samples: must not be lost
+bool is_input_transition(InputEventType type);
+
+// Build a datagram from consecutive samples (first one has first_seq).
+// Returns false if they don't fit in INPUT_DATAGRAM_MAX.
+bool build_input_datagram(uint32_t first_seq, const InputEvent* events, size_t count,
+                          std::vector<uint8_t>& out);
+
+// Legacy 28-byte packet <-> event
+void decode_legacy_packet(const InputEventPacket& packet, InputEvent& event);
+void encode_legacy_packet(const InputEvent& event, InputEventPacket& packet);
+
+class CompactInputDecoder {
+public:
+    CompactInputDecoder() = default;
+
+    // New connection
+    void reset();
+
+    // Decode one batch payload (without the length prefix). 'payload' must
+    // be followed by COMPACT_DECODE_PADDING readable bytes. Appends events
+    // to 'out'; returns false on a malformed batch (the stream can't be
+    // resynchronized after that, so drop the connection).
+    bool decode(const uint8_t* payload, size_t size, std::vector<InputEvent>& out);
+
+private:
+    // Previous sample, in wire units
+    uint32_t m_timestamp = 0;
+    uint8_t m_pointer = 0;
+    uint16_t m_pressure = 0;
+    int16_t m_tilt_x = 0;
+    int16_t m_tilt_y = 0;
+    uint16_t m_buttons = 0;
+};
+
+// Reference encoder (what clients implement); used by tools
+class CompactInputEncoder {
+public:
+    CompactInputEncoder() = default;
+
+    void reset();
+
+    // Append a sample to the open batch. Returns false if it doesn't fit:
+    // finish() the batch and add again.
+    bool add(const InputEvent& event);
+
+    bool empty() const { return m_payload.empty(); }
+
+    // Append the length-prefixed batch to 'out' and start a new one
+    void finish(std::vector<uint8_t>& out);
+
+private:
+    std::vector<uint8_t> m_payload;
+    bool m_first = true;
+    uint32_t m_timestamp = 0;
+    uint8_t m_pointer = 0;
+    uint16_t m_pressure = 0;
+    int16_t m_tilt_x = 0;
+    int16_t m_tilt_y = 0;
+    uint16_t m_buttons = 0;
+};
+
+}  // namespace stream_tablet
@@ -1,17 +1,41 @@
 #include "input_receiver.hpp"
+#include "input_codec.hpp"
 #include "../util/logger.hpp"
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
 #include <fcntl.h>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
 
 namespace stream_tablet {
 
-InputReceiver::InputReceiver() = default;
+// Enough for ~580 packets: several frames of 480 Hz stylus input per wakeup
+static constexpr size_t RX_RING_SIZE = 16384;
+
+// Acks while only moves arrive let the client trim its window
+static constexpr uint64_t UDP_ACK_INTERVAL_NS = 100000000;
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+InputReceiver::InputReceiver()
+    : m_decoder(std::make_unique<CompactInputDecoder>()),
+      m_udp_decoder(std::make_unique<CompactInputDecoder>()) {}
 
 InputReceiver::~InputReceiver() {
     shutdown();
@@ -50,6 +74,38 @@ bool InputReceiver::init(uint16_t port) {
     return true;
 }
 
+bool InputReceiver::init_udp(uint16_t port) {
+    m_udp_socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_udp_socket < 0) {
+        LOG_ERROR("Failed to create UDP input socket");
+        return false;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(m_udp_socket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOG_ERROR("Failed to bind UDP input socket to port %d", port);
+        close(m_udp_socket);
+        m_udp_socket = -1;
+        return false;
+    }
+
+    m_datagram.assign(INPUT_DATAGRAM_MAX + COMPACT_DECODE_PADDING, 0);
+    LOG_INFO("Input receiver listening for datagrams on UDP port %d", port);
+    return true;
+}
+
+void InputReceiver::set_udp_peer(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    struct in_addr addr = {};
+    m_udp_peer_addr = (inet_pton(AF_INET, host.c_str(), &addr) == 1) ? addr.s_addr : 0;
+    m_udp_have_seq = false;
+    m_udp_active = false;
+}
+
 bool InputReceiver::accept_client() {
     if (m_listen_socket < 0) {
         return false;
@@ -72,41 +128,263 @@ bool InputReceiver::accept_client() {
     int flags = fcntl(m_client_socket, F_GETFL, 0);
     fcntl(m_client_socket, F_SETFL, flags | O_NONBLOCK);
 
+    m_rx_ring.assign(RX_RING_SIZE, 0);
+    m_rx_head = m_rx_tail = 0;
+    m_format = m_next_format;
+    m_protocol_error = false;
+    m_decoder->reset();
+    m_decoded.clear();
+    m_decoded_pos = 0;
+    if (m_format == InputWireFormat::COMPACT) {
+        m_batch.assign(COMPACT_MAX_PAYLOAD + COMPACT_DECODE_PADDING, 0);
+    }
+
+    // Input thread: watch the client; stop watching the listener so a
+    // second connection waiting in the backlog doesn't wake us constantly
+    if (m_epoll_fd >= 0) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = m_client_socket;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_listen_socket, nullptr);
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_client_socket, &ev);
+    }
+
     char host[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &client_addr.sin_addr, host, sizeof(host));
-    LOG_INFO("Input client connected from %s", host);
+    LOG_INFO("Input client connected from %s (%s format)", host,
+             m_format == InputWireFormat::COMPACT ? "compact" : "legacy");
 
     return true;
 }
 
+// Read everything available into the free part of the ring (two segments
+// when it wraps) with one readv. Sets 'more' if the ring filled up before
+// the socket drained. Returns false once the client is gone.
+bool InputReceiver::fill_buffer(bool& more) {
+    const size_t size = m_rx_ring.size();
+    more = false;
+    while (m_rx_tail - m_rx_head < size) {
+        size_t free_bytes = size - (m_rx_tail - m_rx_head);
+        size_t start = m_rx_tail % size;
+        size_t first = std::min(free_bytes, size - start);
+
+        struct iovec iov[2];
+        iov[0].iov_base = m_rx_ring.data() + start;
+        iov[0].iov_len = first;
+        iov[1].iov_base = m_rx_ring.data();
+        iov[1].iov_len = free_bytes - first;
+
+        ssize_t n = readv(m_client_socket, iov, iov[1].iov_len ? 2 : 1);
+        m_recv_calls++;
+        if (n > 0) {
+            m_rx_time_ns = monotonic_ns();
+            m_rx_tail += static_cast<size_t>(n);
+            more = (static_cast<size_t>(n) == free_bytes);
+            break;
+        }
+        if (n == 0) {
+            LOG_INFO("Input client disconnected");
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_WARN("Input receive failed: %s", strerror(errno));
+            return false;
+        }
+        break;
+    }
+    return true;
+}
+
+// Copy buffered bytes starting 'offset' past the head, splitting at the
+// wrap point if needed
+void InputReceiver::copy_out(size_t offset, void* dst, size_t len) const {
+    const size_t size = m_rx_ring.size();
+    size_t start = (m_rx_head + offset) % size;
+    size_t first = std::min(len, size - start);
+    memcpy(dst, m_rx_ring.data() + start, first);
+    if (first < len) {
+        memcpy(static_cast<uint8_t*>(dst) + first, m_rx_ring.data(), len - first);
+    }
+}
+
 bool InputReceiver::read_event(InputEvent& event) {
-    InputEventPacket packet;
-    ssize_t n = recv(m_client_socket, &packet, sizeof(packet), MSG_DONTWAIT);
-
-    if (n == sizeof(packet)) {
-        event.type = static_cast<InputEventType>(packet.type);
-        event.pointer_id = packet.pointer_id;
-        event.x = packet.x;
-        event.y = packet.y;
-        event.pressure = packet.pressure;
-        event.tilt_x = packet.tilt_x;
-        event.tilt_y = packet.tilt_y;
-        event.buttons = packet.buttons;
-        event.timestamp_ms = packet.timestamp;
+    if (m_format == InputWireFormat::COMPACT) {
+        if (m_decoded_pos == m_decoded.size() && !read_compact_batch()) {
+            return false;
+        }
+        event = m_decoded[m_decoded_pos++];
         return true;
     }
 
-    if (n == 0) {
-        // Client disconnected
-        LOG_INFO("Input client disconnected");
+    if (m_rx_tail - m_rx_head < sizeof(InputEventPacket)) {
+        return false;  // Partial packet stays buffered
+    }
+
+    InputEventPacket packet;
+    copy_out(0, &packet, sizeof(packet));
+    m_rx_head += sizeof(packet);
+
+    decode_legacy_packet(packet, event);
+    event.received_ns = m_rx_time_ns;
+    m_events_received++;
+    return true;
+}
+
+// Decode the next complete batch into m_decoded. Returns false if none is
+// buffered yet, or on a malformed batch (sets m_protocol_error).
+bool InputReceiver::read_compact_batch() {
+    m_decoded.clear();
+    m_decoded_pos = 0;
+
+    size_t available = m_rx_tail - m_rx_head;
+    if (available < 2) {
+        return false;
+    }
+    uint8_t prefix[2];
+    copy_out(0, prefix, sizeof(prefix));
+    size_t length = prefix[0] | (prefix[1] << 8);
+    if (length == 0 || length > COMPACT_MAX_PAYLOAD) {
+        LOG_WARN("Invalid compact input batch length %zu", length);
+        m_protocol_error = true;
+        return false;
+    }
+    if (available < 2 + length) {
+        return false;  // Partial batch stays buffered
+    }
+
+    copy_out(2, m_batch.data(), length);
+    m_rx_head += 2 + length;
+    if (!m_decoder->decode(m_batch.data(), length, m_decoded)) {
+        LOG_WARN("Malformed compact input batch (%zu bytes)", length);
+        m_decoded.clear();
+        m_protocol_error = true;
+        return false;
+    }
+
+    for (InputEvent& event : m_decoded) {
+        event.received_ns = m_rx_time_ns;
+    }
+    m_events_received += m_decoded.size();
+    return !m_decoded.empty();
+}
+
+void InputReceiver::close_client() {
+    if (m_client_socket >= 0) {
+        if (m_epoll_fd >= 0) {
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = m_listen_socket;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_client_socket, nullptr);
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_socket, &ev);
+        }
         close(m_client_socket);
         m_client_socket = -1;
     }
+    m_rx_head = m_rx_tail = 0;
+    m_decoded.clear();
+    m_decoded_pos = 0;
+}
+
+// Apply the new samples of every queued datagram, in sequence order
+void InputReceiver::receive_datagrams() {
+    for (;;) {
+        struct sockaddr_in from = {};
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(m_udp_socket, m_datagram.data(), INPUT_DATAGRAM_MAX, MSG_DONTWAIT,
+                             reinterpret_cast<struct sockaddr*>(&from), &from_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        m_recv_calls++;
+        uint64_t now = monotonic_ns();
 
-    return false;
+        const uint8_t* data = m_datagram.data();
+        if (m_udp_peer_addr == 0 || from.sin_addr.s_addr != m_udp_peer_addr ||
+            static_cast<size_t>(n) <= INPUT_DATAGRAM_HEADER ||
+            (data[0] | (data[1] << 8)) != INPUT_DATAGRAM_MAGIC) {
+            m_udp_rejected++;
+            continue;
+        }
+        uint32_t first_seq = static_cast<uint32_t>(data[2]) | (static_cast<uint32_t>(data[3]) << 8) |
+                             (static_cast<uint32_t>(data[4]) << 16) | (static_cast<uint32_t>(data[5]) << 24);
+
+        // Every datagram decodes from zero state
+        m_udp_events.clear();
+        m_udp_decoder->reset();
+        if (!m_udp_decoder->decode(data + INPUT_DATAGRAM_HEADER, n - INPUT_DATAGRAM_HEADER, m_udp_events)) {
+            m_udp_rejected++;
+            continue;
+        }
+        if (!m_udp_active) {
+            char host[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+            LOG_INFO("UDP input from %s:%d", host, ntohs(from.sin_port));
+            m_udp_active = true;
+        }
+
+        bool transition = false;
+        for (size_t i = 0; i < m_udp_events.size(); i++) {
+            uint32_t seq = first_seq + static_cast<uint32_t>(i);
+            transition |= is_input_transition(m_udp_events[i].type);
+            if (m_udp_have_seq) {
+                int32_t ahead = static_cast<int32_t>(seq - m_udp_last_seq);
+                if (ahead <= 0) {
+                    m_udp_duplicates++;
+                    continue;
+                }
+                m_udp_lost += static_cast<uint32_t>(ahead - 1);
+            }
+            m_udp_have_seq = true;
+            m_udp_last_seq = seq;
+
+            InputEvent& event = m_udp_events[i];
+            event.received_ns = now;
+            m_events_received++;
+            if (m_callback) {
+                m_callback(event);
+            }
+        }
+
+        // Resent transitions are re-acked too: the previous ack may be lost
+        if (m_udp_have_seq && (transition || now - m_udp_last_ack_ns >= UDP_ACK_INTERVAL_NS)) {
+            send_udp_ack(from);
+            m_udp_last_ack_ns = now;
+        }
+    }
+}
+
+void InputReceiver::send_udp_ack(const struct sockaddr_in& to) {
+    uint8_t ack[INPUT_DATAGRAM_HEADER];
+    ack[0] = INPUT_DATAGRAM_MAGIC & 0xFF;
+    ack[1] = INPUT_DATAGRAM_MAGIC >> 8;
+    for (int i = 0; i < 4; i++) {
+        ack[2 + i] = static_cast<uint8_t>(m_udp_last_seq >> (8 * i));
+    }
+    if (sendto(m_udp_socket, ack, sizeof(ack), MSG_DONTWAIT,
+               reinterpret_cast<const struct sockaddr*>(&to), sizeof(to)) < 0) {
+        LOG_DEBUG("UDP input ack failed: %s", strerror(errno));
+    }
 }
 
 void InputReceiver::process() {
+    if (m_thread_running) {
+        return;  // The input thread owns the socket
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    process_locked();
+}
+
+void InputReceiver::process_locked() {
+    if (m_udp_socket >= 0) {
+        receive_datagrams();
+    }
+
     // Try to accept new client if not connected
     if (m_client_socket < 0 && m_listen_socket >= 0) {
         // Non-blocking check for new connection
@@ -120,27 +398,162 @@ void InputReceiver::process() {
         return;
     }
 
-    InputEvent event;
-    while (read_event(event)) {
-        if (m_callback) {
-            m_callback(event);
+    // One read per pass; only loop again if the ring filled up
+    bool connected = true;
+    bool more = false;
+    do {
+        connected = fill_buffer(more);
+
+        InputEvent event;
+        while (read_event(event)) {
+            if (m_callback) {
+                m_callback(event);
+            }
         }
+    } while (connected && more && !m_protocol_error);
+
+    if (m_protocol_error) {
+        connected = false;
+    }
+
+    if (!connected) {
+        close_client();
     }
 }
 
-void InputReceiver::reset() {
-    if (m_client_socket >= 0) {
-        close(m_client_socket);
-        m_client_socket = -1;
+bool InputReceiver::start_thread(int rt_priority) {
+    if (m_thread_running) {
+        return true;
+    }
+    if (m_listen_socket < 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_wake_fd < 0 || m_timer_fd < 0) {
+        LOG_ERROR("Failed to create input epoll: %s", strerror(errno));
+        if (m_epoll_fd >= 0) close(m_epoll_fd);
+        if (m_wake_fd >= 0) close(m_wake_fd);
+        if (m_timer_fd >= 0) close(m_timer_fd);
+        m_epoll_fd = m_wake_fd = m_timer_fd = -1;
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wake_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &ev);
+    ev.data.fd = m_timer_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &ev);
+    ev.data.fd = (m_client_socket >= 0) ? m_client_socket.load() : m_listen_socket;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    if (m_udp_socket >= 0) {
+        ev.data.fd = m_udp_socket;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_udp_socket, &ev);
+    }
+
+    m_thread_running = true;
+    m_thread = std::thread(&InputReceiver::input_thread, this, rt_priority);
+    return true;
+}
+
+void InputReceiver::stop_thread() {
+    if (!m_thread_running) {
+        return;
+    }
+    m_thread_running = false;
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN("Failed to wake input thread: %s", strerror(errno));
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close(m_epoll_fd);
+    close(m_wake_fd);
+    close(m_timer_fd);
+    m_epoll_fd = m_wake_fd = m_timer_fd = -1;
+}
+
+void InputReceiver::set_wake_time(uint64_t monotonic_ns) {
+    if (m_timer_fd < 0) {
+        return;
     }
+    // An absolute time already past fires right away; all zero disarms
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = static_cast<time_t>(monotonic_ns / 1000000000ULL);
+    spec.it_value.tv_nsec = static_cast<long>(monotonic_ns % 1000000000ULL);
+    timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void InputReceiver::input_thread(int rt_priority) {
+    if (rt_priority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = std::min(rt_priority, sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            LOG_WARN("Input thread: SCHED_FIFO %d not permitted (%s), using normal priority",
+                     param.sched_priority, strerror(err));
+        } else {
+            LOG_INFO("Input thread running SCHED_FIFO priority %d", param.sched_priority);
+        }
+    }
+    LOG_INFO("Input thread started");
+
+    struct epoll_event events[4];
+    while (m_thread_running) {
+        // Held samples need a timely flush; otherwise sleep until input arrives
+        int timeout_ms = (m_idle_callback && is_connected()) ? 1 : -1;
+        int n = epoll_wait(m_epoll_fd, events, 4, timeout_ms);
+        if (n < 0 && errno != EINTR) {
+            LOG_ERROR("Input epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == m_wake_fd || events[i].data.fd == m_timer_fd) {
+                uint64_t value;
+                while (read(events[i].data.fd, &value, sizeof(value)) > 0) {}
+            }
+        }
+        if (!m_thread_running) {
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            process_locked();
+        }
+        if (m_idle_callback) {
+            m_idle_callback();
+        }
+    }
+    LOG_INFO("Input thread stopped");
+}
+
+void InputReceiver::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close_client();
+    m_udp_peer_addr = 0;
+    m_udp_have_seq = false;
+    m_udp_active = false;
 }
 
 void InputReceiver::shutdown() {
+    stop_thread();
     reset();
     if (m_listen_socket >= 0) {
         close(m_listen_socket);
         m_listen_socket = -1;
     }
+    if (m_udp_socket >= 0) {
+        close(m_udp_socket);
+        m_udp_socket = -1;
+    }
 }
 
 }  // namespace stream_tablet
@@ -3,10 +3,18 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <netinet/in.h>
 #include <openssl/ssl.h>
 
 namespace stream_tablet {
 
+class CompactInputDecoder;
+
 // Input event types
 enum class InputEventType : uint8_t {
     TOUCH_DOWN = 0x01,
@@ -20,6 +28,12 @@ enum class InputEventType : uint8_t {
     KEY_UP = 0x09
 };
 
+// Wire format of the input connection
+enum class InputWireFormat : uint8_t {
+    LEGACY,     // 28-byte InputEventPacket per sample
+    COMPACT     // Length-prefixed batches of quantized samples (input_codec.hpp)
+};
+
 struct InputEvent {
     InputEventType type;
     uint8_t pointer_id;
@@ -30,11 +44,13 @@ struct InputEvent {
     float tilt_y;     // Radians (orientation)
     uint16_t buttons; // Button state bitfield
     uint32_t timestamp_ms;
+    uint64_t received_ns = 0;  // Server CLOCK_MONOTONIC when the bytes were read
 };
 
 class InputReceiver {
 public:
     using InputCallback = std::function<void(const InputEvent&)>;
+    using IdleCallback = std::function<void()>;
 
     InputReceiver();
     ~InputReceiver();
@@ -42,30 +58,116 @@ public:
     // Initialize TCP listener
     bool init(uint16_t port);
 
+    // Also receive redundant input datagrams on this UDP port (input_codec.hpp)
+    bool init_udp(uint16_t port);
+
+    // Only datagrams from this host are applied (the primary client)
+    void set_udp_peer(const std::string& host);
+
     // Accept client connection
     bool accept_client();
 
     // Set callback for received events
     void set_callback(InputCallback cb) { m_callback = std::move(cb); }
 
-    // Process incoming events (call from event loop)
+    // Called after each batch of events and at least every millisecond on
+    // the input thread (flushes held samples). Set before start_thread().
+    void set_idle_callback(IdleCallback cb) { m_idle_callback = std::move(cb); }
+
+    // Also run the idle callback at this CLOCK_MONOTONIC time (timerfd, so
+    // well below the millisecond poll; 0 = cancel). Only while threaded.
+    void set_wake_time(uint64_t monotonic_ns);
+
+    // Format the next input connection uses (negotiated over control)
+    void set_wire_format(InputWireFormat format) { m_next_format = format; }
+
+    // Process incoming events (call from event loop; no-op while threaded)
     void process();
 
-    // Check if connected
-    bool is_connected() const { return m_client_socket >= 0; }
+    // Receive on a dedicated thread blocked in epoll_wait, so input does not
+    // wait for the frame loop. Callbacks then run on that thread.
+    // rt_priority > 0 requests SCHED_FIFO at that priority (needs CAP_SYS_NICE).
+    bool start_thread(int rt_priority = 0);
+    void stop_thread();
+    bool is_threaded() const { return m_thread_running; }
+
+    // Check if connected (TCP client, or datagrams from the UDP peer)
+    bool is_connected() const { return m_client_socket >= 0 || m_udp_active; }
 
     // Reset for new connection
     void reset();
 
     void shutdown();
 
+    // Statistics
+    uint64_t get_events_received() const { return m_events_received; }
+    uint64_t get_recv_calls() const { return m_recv_calls; }           // Socket reads (TCP and UDP)
+    uint64_t get_udp_lost() const { return m_udp_lost; }               // Samples never seen
+    uint64_t get_udp_duplicates() const { return m_udp_duplicates; }   // Redundant copies
+    uint64_t get_udp_rejected() const { return m_udp_rejected; }       // Bad or foreign datagrams
+
 private:
+    void process_locked();
+    bool fill_buffer(bool& more);
     bool read_event(InputEvent& event);
+    bool read_compact_batch();
+    void copy_out(size_t offset, void* dst, size_t len) const;
+    void close_client();
+    void receive_datagrams();
+    void send_udp_ack(const struct sockaddr_in& to);
+    void input_thread(int rt_priority);
 
     int m_listen_socket = -1;
-    int m_client_socket = -1;
+    std::atomic<int> m_client_socket{-1};
+
+    // Input thread (socket state is guarded by m_mutex while it runs)
+    std::thread m_thread;
+    std::atomic<bool> m_thread_running{false};
+    std::mutex m_mutex;
+    int m_epoll_fd = -1;
+    int m_wake_fd = -1;          // eventfd: stop request
+    int m_timer_fd = -1;         // timerfd: set_wake_time()
+
+    // Receive ring: TCP may split a packet anywhere, so partial tails stay
+    // here until the rest arrives. Head/tail are free-running byte counts.
+    std::vector<uint8_t> m_rx_ring;
+    size_t m_rx_head = 0;   // Next byte to parse
+    size_t m_rx_tail = 0;   // Next byte to fill
+    uint64_t m_rx_time_ns = 0;  // When the last read returned data
+
+    // Wire format, latched per connection
+    std::atomic<InputWireFormat> m_next_format{InputWireFormat::LEGACY};
+    InputWireFormat m_format = InputWireFormat::LEGACY;
+    bool m_protocol_error = false;
+
+    // Compact format: one batch copied out of the ring (with decode
+    // padding) and the events decoded from it
+    std::unique_ptr<CompactInputDecoder> m_decoder;
+    std::vector<uint8_t> m_batch;
+    std::vector<InputEvent> m_decoded;
+    size_t m_decoded_pos = 0;
+
+    // UDP input: datagram scratch (with decode padding), sequence state
+    int m_udp_socket = -1;
+    uint32_t m_udp_peer_addr = 0;    // Network order; 0 = no peer yet
+    std::atomic<bool> m_udp_active{false};
+    std::unique_ptr<CompactInputDecoder> m_udp_decoder;
+    std::vector<uint8_t> m_datagram;
+    std::vector<InputEvent> m_udp_events;
+    bool m_udp_have_seq = false;
+    uint32_t m_udp_last_seq = 0;     // Highest sequence applied
+    uint64_t m_udp_last_ack_ns = 0;
+
+    std::atomic<uint64_t> m_udp_lost{0};
+    std::atomic<uint64_t> m_udp_duplicates{0};
+    std::atomic<uint64_t> m_udp_rejected{0};
+
+    // Written by the input thread, read by anyone
+    std::atomic<uint64_t> m_events_received{0};
+    std::atomic<uint64_t> m_recv_calls{0};
 
     InputCallback m_callback;
+    IdleCallback m_idle_callback;
 };
 
 // Input event binary format (28 bytes)
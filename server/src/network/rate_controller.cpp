@@ -0,0 +1,112 @@
+#include "rate_controller.hpp"
+#include "video_sender.hpp"
+#include "../util/logger.hpp"
+#include <algorithm>
+
+namespace stream_tablet {
+
+namespace {
+
+constexpr double ALPHA_GAIN = 1.0 / 16.0;          // EWMA gain for CE fraction (as in DCTCP)
+constexpr double LOSS_THRESHOLD = 0.02;            // Loss fraction treated as congestion
+constexpr double LOSS_DECREASE = 0.85;             // Multiplicative decrease on loss
+constexpr double INCREASE_PER_SECOND = 0.05;       // Additive increase, fraction of max per second
+constexpr auto CE_REACTION_INTERVAL = std::chrono::milliseconds(100);
+constexpr auto LOSS_REACTION_INTERVAL = std::chrono::milliseconds(200);
+constexpr auto INCREASE_HOLDOFF = std::chrono::milliseconds(500);
+constexpr int BLEACH_REPORTS = 20;                 // Reports with traffic but no ECT before giving up
+
+}  // namespace
+
+void RateController::init(int start_bitrate, int min_bitrate, int max_bitrate) {
+    m_min = min_bitrate;
+    m_max = max_bitrate;
+    m_target = std::clamp(start_bitrate, min_bitrate, max_bitrate);
+    m_alpha = 0.0;
+    reset();
+}
+
+void RateController::set_max_bitrate(int max_bitrate) {
+    m_max = std::max(max_bitrate, m_min);
+    m_target = std::min(m_target, static_cast<double>(m_max));
+}
+
+void RateController::reset() {
+    m_have_last = false;
+    m_loss_fraction = 0.0;
+    m_reports_without_ect = 0;
+    m_ecn_bleached = false;
+}
+
+bool RateController::on_receiver_report(const ReceiverReport& report) {
+    auto now = std::chrono::steady_clock::now();
+
+    if (!m_have_last) {
+        m_last_received = report.packets_received;
+        m_last_lost = report.packets_lost;
+        m_last_ect = report.ect_received;
+        m_last_ce = report.ce_received;
+        m_last_report = now;
+        m_last_decrease = now;
+        m_have_last = true;
+        return false;
+    }
+
+    // Deltas since last report (unsigned arithmetic handles counter wrap)
+    uint32_t received = report.packets_received - m_last_received;
+    uint32_t lost = report.packets_lost - m_last_lost;
+    uint32_t ect = report.ect_received - m_last_ect;
+    uint32_t ce = report.ce_received - m_last_ce;
+
+    // A reordered (older) report shows up as a huge unsigned delta
+    if (received + lost == 0 || received > (1u << 30) || lost > (1u << 30)) {
+        return false;
+    }
+
+    m_last_received = report.packets_received;
+    m_last_lost = report.packets_lost;
+    m_last_ect = report.ect_received;
+    m_last_ce = report.ce_received;
+
+    double dt = std::chrono::duration<double>(now - m_last_report).count();
+    dt = std::clamp(dt, 0.001, 1.0);
+    m_last_report = now;
+
+    // ECN bleaching: marked packets arrive without any ECN bits
+    if (m_ecn_enabled && !m_ecn_bleached) {
+        m_reports_without_ect = (received > 0 && ect == 0) ? m_reports_without_ect + 1 : 0;
+        if (m_reports_without_ect >= BLEACH_REPORTS) {
+            m_ecn_bleached = true;
+            LOG_WARN("ECN: no ECT marks reaching the receiver, path bleaches ECN (loss-based only)");
+        }
+    }
+
+    double ce_fraction = received > 0 ? static_cast<double>(ce) / received : 0.0;
+    m_alpha += ALPHA_GAIN * (ce_fraction - m_alpha);
+    m_loss_fraction = static_cast<double>(lost) / (received + lost);
+
+    double old_target = m_target;
+
+    if (ce > 0 && now - m_last_decrease >= CE_REACTION_INTERVAL) {
+        // Scalable decrease: back off in proportion to how much is being marked
+        m_target *= (1.0 - m_alpha / 2.0);
+        m_last_decrease = now;
+    } else if (m_loss_fraction > LOSS_THRESHOLD && now - m_last_decrease >= LOSS_REACTION_INTERVAL) {
+        m_target *= LOSS_DECREASE;
+        m_last_decrease = now;
+    } else if (ce == 0 && m_loss_fraction <= LOSS_THRESHOLD &&
+               now - m_last_decrease >= INCREASE_HOLDOFF) {
+        m_target += m_max * INCREASE_PER_SECOND * dt;
+    }
+
+    m_target = std::clamp(m_target, static_cast<double>(m_min), static_cast<double>(m_max));
+
+    if (m_target < old_target) {
+        LOG_DEBUG("Rate: %.2f -> %.2f Mbps (ce=%u/%u alpha=%.3f loss=%.1f%%)",
+                  old_target / 1e6, m_target / 1e6, ce, received, m_alpha, m_loss_fraction * 100.0);
+    }
+
+    return static_cast<int>(m_target) != static_cast<int>(old_target);
+}
+
+}  // namespace stream_tablet
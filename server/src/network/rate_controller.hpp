@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+namespace stream_tablet {
+
+struct ReceiverReport;
+
+// Sender-side rate controller driven by receiver reports.
+// CE marks trigger a scalable (DCTCP/L4S-style) decrease proportional to the
+// smoothed marking fraction, so the rate backs off while queues are still
+// shallow. Loss is handled as a classic multiplicative decrease for paths
+// that do not support ECN. Otherwise the target creeps back up additively.
+class RateController {
+public:
+    RateController() = default;
+
+    // Set bitrate bounds and start from start_bitrate
+    void init(int start_bitrate, int min_bitrate, int max_bitrate);
+
+    // Forget report history (e.g. on reconnect); keeps the current target
+    void reset();
+
+    // Whether packets are sent ECT-marked (enables bleaching detection)
+    void set_ecn_enabled(bool enabled) { m_ecn_enabled = enabled; }
+
+    // Process a receiver report. Returns true if the target bitrate changed.
+    bool on_receiver_report(const ReceiverReport& report);
+
+    int get_target_bitrate() const { return static_cast<int>(m_target); }
+    int get_max_bitrate() const { return m_max; }
+
+    // Move the ceiling; the target drops to it at once but only climbs
+    // toward a raised one at the usual pace
+    void set_max_bitrate(int max_bitrate);
+
+    // Smoothed fraction of CE-marked packets (0-1)
+    double get_ce_alpha() const { return m_alpha; }
+
+    // Loss fraction of the last report interval
+    double get_loss_fraction() const { return m_loss_fraction; }
+
+    // False once reports show ECT packets arriving without ECN bits (bleached path)
+    bool is_ecn_path_ok() const { return !m_ecn_bleached; }
+
+private:
+    double m_target = 0.0;
+    int m_min = 0;
+    int m_max = 0;
+
+    double m_alpha = 0.0;          // EWMA of CE fraction
+    double m_loss_fraction = 0.0;
+
+    bool m_have_last = false;
+    uint32_t m_last_received = 0;
+    uint32_t m_last_lost = 0;
+    uint32_t m_last_ect = 0;
+    uint32_t m_last_ce = 0;
+
+    bool m_ecn_enabled = false;
+    int m_reports_without_ect = 0;
+    bool m_ecn_bleached = false;
+
+    std::chrono::steady_clock::time_point m_last_report;
+    std::chrono::steady_clock::time_point m_last_decrease;
+};
+
+}  // namespace stream_tablet
@@ -1,10 +1,14 @@
 #include "video_sender.hpp"
+#include "egress_scheduler.hpp"
 #include "../util/logger.hpp"
+#include "stream_tablet/config.hpp"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -12,6 +16,12 @@ namespace stream_tablet {
 
 constexpr size_t MAX_PAYLOAD_SIZE = 1200;  // MTU safe
 
+// Retransmission / multicast receiver tracking
+constexpr size_t NACK_HISTORY_SIZE = 2048;                     // ~2.4 MB of sent video per subscriber
+constexpr auto NACK_HOLDOFF = std::chrono::milliseconds(20);   // Min gap between resends of a packet
+constexpr size_t MAX_RECEIVERS = 64;
+constexpr auto RECEIVER_TIMEOUT = std::chrono::seconds(5);
+
 VideoSender::VideoSender() = default;
 
 VideoSender::~VideoSender() {
@@ -77,85 +87,262 @@ PacingMode VideoSender::detect_pacing_mode(const std::string& host) {
     return PacingMode::LIGHT;
 }
 
-void VideoSender::set_client(const std::string& host, uint16_t port, PacingMode mode) {
-    memset(&m_client_addr, 0, sizeof(m_client_addr));
-    m_client_addr.sin_family = AF_INET;
-    m_client_addr.sin_port = htons(port);
-    inet_pton(AF_INET, host.c_str(), &m_client_addr.sin_addr);
-    m_client_set = true;
+uint32_t VideoSender::add_subscriber(const std::string& host, uint16_t port,
+                                     const SubscriberOptions& options) {
+    Subscriber sub;
+    sub.id = m_next_subscriber_id++;
+    sub.host = host;
+    sub.addr.sin_family = AF_INET;
+    sub.addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &sub.addr.sin_addr);
+    sub.multiplexed = options.multiplexed;
+    sub.ecn = options.ecn ? ECN_ECT1 : ECN_NOT_ECT;
+    sub.rung = std::clamp(options.rung, 0, 31);
+    sub.history.assign(NACK_HISTORY_SIZE, HistoryEntry{});
+    configure_pacing(sub, options.pacing);
+
+    LOG_INFO("Video subscriber %u: %s:%d%s%s", sub.id, host.c_str(), port,
+             sub.multiplexed ? " (mux)" : "", sub.ecn ? " (ECN)" : "");
+
+    m_keyframe_rungs |= 1u << sub.rung;
+    m_subscribers.push_back(std::move(sub));
+    return m_subscribers.back().id;
+}
+
+uint32_t VideoSender::add_multicast_subscriber(const std::string& group, uint16_t port, int ttl,
+                                               const SubscriberOptions& options) {
+    if (Subscriber* existing = find_multicast_subscriber()) {
+        return existing->id;
+    }
+
+    struct in_addr group_addr = {};
+    if (inet_pton(AF_INET, group.c_str(), &group_addr) != 1 || !IN_MULTICAST(ntohl(group_addr.s_addr))) {
+        LOG_ERROR("Invalid multicast group: %s", group.c_str());
+        return 0;
+    }
+
+    unsigned char mttl = static_cast<unsigned char>(std::clamp(ttl, 1, 255));
+    if (setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl)) < 0) {
+        LOG_ERROR("Failed to set multicast TTL: %s", strerror(errno));
+        return 0;
+    }
+
+    SubscriberOptions multicast_options = options;
+    multicast_options.multiplexed = false;
+    uint32_t id = add_subscriber(group, port, multicast_options);
+
+    Subscriber* sub = find_subscriber(id);
+    sub->multicast = true;
+    sub->fec_group = m_fec_config > 0 ? m_fec_config : 0;
+    m_receivers.clear();
+    m_last_receiver_update = std::chrono::steady_clock::now();
+    m_receiver_updates = 0;
+
+    LOG_INFO("Video multicast to %s:%d (ttl=%d, fec=%s)", group.c_str(), port, mttl,
+             m_fec_config < 0 ? "adaptive" : (m_fec_config > 0 ? "fixed" : "off"));
+    return id;
+}
+
+void VideoSender::remove_subscriber(uint32_t id) {
+    auto it = std::find_if(m_subscribers.begin(), m_subscribers.end(),
+                           [id](const Subscriber& sub) { return sub.id == id; });
+    if (it == m_subscribers.end()) {
+        return;
+    }
+    LOG_INFO("Video subscriber %u removed (%s, %lu frames, %lu retransmits)",
+             it->id, it->host.c_str(), it->frames_sent, it->retransmits);
+    if (it->multicast) {
+        m_receivers.clear();
+    }
+    m_subscribers.erase(it);
+}
 
+void VideoSender::clear_subscribers() {
+    m_subscribers.clear();
+    m_receivers.clear();
+    m_keyframe_rungs = 0;
+}
+
+std::vector<SubscriberStats> VideoSender::get_subscriber_stats() const {
+    std::vector<SubscriberStats> result;
+    result.reserve(m_subscribers.size());
+    for (const auto& sub : m_subscribers) {
+        SubscriberStats stats;
+        stats.id = sub.id;
+        stats.host = sub.host;
+        stats.port = ntohs(sub.addr.sin_port);
+        stats.multicast = sub.multicast;
+        stats.waiting_for_keyframe = sub.waiting_for_keyframe;
+        stats.rung = sub.rung;
+        stats.bytes_sent = sub.bytes_sent;
+        stats.packets_sent = sub.packets_sent;
+        stats.frames_sent = sub.frames_sent;
+        stats.frames_skipped = sub.frames_skipped;
+        stats.retransmits = sub.retransmits;
+        stats.nacks_unrecoverable = sub.nacks_unrecoverable;
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+uint32_t VideoSender::take_keyframe_request() {
+    uint32_t rungs = m_keyframe_rungs;
+    m_keyframe_rungs = 0;
+    return rungs;
+}
+
+void VideoSender::set_subscriber_rung(uint32_t id, int rung) {
+    Subscriber* sub = find_subscriber(id);
+    rung = std::clamp(rung, 0, 31);
+    if (!sub || rung == (sub->pending_rung >= 0 ? sub->pending_rung : sub->rung)) {
+        return;
+    }
+
+    if (sub->waiting_for_keyframe || rung == sub->rung) {
+        // Nothing decodable in flight (or switch cancelled): move right away
+        sub->rung = rung;
+        sub->pending_rung = -1;
+    } else {
+        sub->pending_rung = rung;
+    }
+    m_keyframe_rungs |= 1u << rung;
+    LOG_INFO("Video subscriber %u: rung %d -> %d", sub->id, sub->rung, rung);
+}
+
+void VideoSender::set_pacing_mode(PacingMode mode) {
+    for (auto& sub : m_subscribers) {
+        configure_pacing(sub, mode);
+    }
+}
+
+void VideoSender::set_subscriber_paused(uint32_t id, bool paused) {
+    Subscriber* sub = find_subscriber(id);
+    if (!sub || sub->paused == paused) {
+        return;
+    }
+    sub->paused = paused;
+    if (!paused) {
+        // Its decoder missed everything since the pause
+        sub->waiting_for_keyframe = true;
+        m_keyframe_rungs |= 1u << sub->rung;
+    }
+    LOG_INFO("Video subscriber %u %s", sub->id, paused ? "paused" : "resumed");
+}
+
+int VideoSender::get_subscriber_rung(uint32_t id) const {
+    const Subscriber* sub = find_subscriber(id);
+    return sub ? sub->rung : -1;
+}
+
+void VideoSender::configure_pacing(Subscriber& sub, PacingMode mode) {
     // Set pacing mode
     if (mode == PacingMode::AUTO) {
-        m_pacing_mode = detect_pacing_mode(host);
+        sub.pacing_mode = detect_pacing_mode(sub.host);
     } else {
-        m_pacing_mode = mode;
+        sub.pacing_mode = mode;
     }
 
     // Configure pacing parameters based on mode
-    switch (m_pacing_mode) {
+    switch (sub.pacing_mode) {
         case PacingMode::NONE:
-            m_pacing_threshold = 1000000000;  // Never pace (1GB threshold)
-            m_packets_per_burst = 0;
-            m_burst_delay_us = 0;
+            sub.pacing_threshold = 1000000000;  // Never pace (1GB threshold)
+            sub.packets_per_burst = 0;
+            sub.burst_delay_us = 0;
             LOG_INFO("Pacing: NONE");
             break;
         case PacingMode::LIGHT:
-            m_pacing_threshold = 50000;     // Only pace large frames (>50KB)
-            m_packets_per_burst = 20;
-            m_burst_delay_us = 50;
+            sub.pacing_threshold = 50000;     // Only pace large frames (>50KB)
+            sub.packets_per_burst = 20;
+            sub.burst_delay_us = 50;
             LOG_INFO("Pacing: LIGHT (threshold=50KB, burst=20, delay=50us)");
             break;
         case PacingMode::AGGRESSIVE:
-            m_pacing_threshold = 2400;      // Pace any frame > 2 packets
-            m_packets_per_burst = 4;
-            m_burst_delay_us = 200;
+            sub.pacing_threshold = 2400;      // Pace any frame > 2 packets
+            sub.packets_per_burst = 4;
+            sub.burst_delay_us = 200;
             LOG_INFO("Pacing: AGGRESSIVE (threshold=2.4KB, burst=4, delay=200us)");
             break;
         case PacingMode::KEYFRAME:
             // Special mode: only pace keyframes, with very aggressive pacing
-            m_pacing_threshold = 0;         // Will check keyframe flag instead
-            m_packets_per_burst = 8;        // Small bursts
-            m_burst_delay_us = 100;         // 100us between bursts
+            sub.pacing_threshold = 0;         // Will check keyframe flag instead
+            sub.packets_per_burst = 8;        // Small bursts
+            sub.burst_delay_us = 100;         // 100us between bursts
             LOG_INFO("Pacing: KEYFRAME (keyframes only, burst=8, delay=100us)");
             break;
         default:
-            m_pacing_threshold = 50000;
-            m_packets_per_burst = 20;
-            m_burst_delay_us = 50;
+            sub.pacing_threshold = 50000;
+            sub.packets_per_burst = 20;
+            sub.burst_delay_us = 50;
             break;
     }
+}
 
-    LOG_INFO("Video client set to %s:%d", host.c_str(), port);
+void VideoSender::set_scheduler(EgressScheduler* scheduler) {
+    m_scheduler = scheduler;
+    if (m_scheduler) {
+        EgressScheduler::mark_socket(m_socket, TrafficClass::VIDEO_DELTA);
+    }
 }
 
-bool VideoSender::send_frame(const uint8_t* data, size_t size,
-                             uint32_t frame_number, bool keyframe, uint64_t timestamp_us) {
-    (void)timestamp_us;  // Reserved for future use
+VideoSender::Subscriber* VideoSender::find_subscriber(uint32_t id) {
+    for (auto& sub : m_subscribers) {
+        if (sub.id == id) return &sub;
+    }
+    return nullptr;
+}
 
-    if (!m_client_set || m_socket < 0) {
-        return false;
+const VideoSender::Subscriber* VideoSender::find_subscriber(uint32_t id) const {
+    for (const auto& sub : m_subscribers) {
+        if (sub.id == id) return &sub;
     }
+    return nullptr;
+}
 
-    // Calculate number of fragments needed
-    size_t num_fragments = (size + MAX_PAYLOAD_SIZE - 1) / MAX_PAYLOAD_SIZE;
-    if (num_fragments > 65535) {
-        LOG_ERROR("Frame too large: %zu bytes requires %zu fragments", size, num_fragments);
-        return false;
+VideoSender::Subscriber* VideoSender::find_subscriber(const struct sockaddr_in& from) {
+    // Exact address first: where its video goes, or where its feedback
+    // came from before
+    Subscriber* same_host = nullptr;
+    int same_host_count = 0;
+    for (auto& sub : m_subscribers) {
+        if (sub.multicast || sub.addr.sin_addr.s_addr != from.sin_addr.s_addr) {
+            continue;
+        }
+        if (sub.addr.sin_port == from.sin_port ||
+            (sub.feedback_addr.sin_port != 0 && sub.feedback_addr.sin_port == from.sin_port)) {
+            return &sub;
+        }
+        same_host = &sub;
+        same_host_count++;
     }
 
-    // Log frame sizes for diagnostics
-    if (keyframe) {
-        LOG_INFO("Keyframe %u: %zu bytes (%zu packets)", frame_number, size, num_fragments);
+    // A NAT may send feedback from another port. Take that only when it
+    // can't be anyone else: the host's sole unicast subscriber, and no
+    // multicast receivers who could be on the same host. The source is
+    // latched (again, if the NAT mapping changed) for exact matches.
+    if (same_host_count != 1 || find_multicast_subscriber()) {
+        return nullptr;
     }
+    LOG_INFO("Subscriber %u sends feedback from port %d", same_host->id, ntohs(from.sin_port));
+    same_host->feedback_addr = from;
+    return same_host;
+}
 
+VideoSender::Subscriber* VideoSender::find_multicast_subscriber() {
+    for (auto& sub : m_subscribers) {
+        if (sub.multicast) return &sub;
+    }
+    return nullptr;
+}
+
+void VideoSender::plan_frame(Subscriber& sub, size_t size, bool keyframe) {
     // Determine pacing parameters based on mode and frame size
-    bool need_pacing = false;
-    int packets_per_burst = m_packets_per_burst;
-    int burst_delay_us = m_burst_delay_us;
+    sub.frame_paced = false;
+    sub.frame_burst = sub.packets_per_burst;
+    sub.frame_delay_us = sub.burst_delay_us;
 
-    if (m_pacing_mode == PacingMode::KEYFRAME) {
+    if (sub.pacing_mode == PacingMode::KEYFRAME) {
         // Only pace keyframes, with adaptive pacing based on size
-        need_pacing = keyframe;
+        sub.frame_paced = keyframe;
         if (keyframe && size > 100000) {
             // Adaptive pacing for large keyframes:
             // - Small keyframes (<100KB): no pacing needed
@@ -163,88 +350,544 @@ bool VideoSender::send_frame(const uint8_t* data, size_t size,
             // - Large (300-500KB): moderate pacing (4 packets, 200us)
             // - Very large (>500KB): aggressive pacing (2 packets, 300us)
             if (size > 500000) {
-                packets_per_burst = 2;
-                burst_delay_us = 300;
+                sub.frame_burst = 2;
+                sub.frame_delay_us = 300;
             } else if (size > 300000) {
-                packets_per_burst = 4;
-                burst_delay_us = 200;
+                sub.frame_burst = 4;
+                sub.frame_delay_us = 200;
             } else {
-                packets_per_burst = 6;
-                burst_delay_us = 150;
+                sub.frame_burst = 6;
+                sub.frame_delay_us = 150;
             }
         }
-    } else if (m_pacing_mode != PacingMode::NONE) {
+    } else if (sub.pacing_mode != PacingMode::NONE) {
         // Size-based pacing
-        need_pacing = (size > m_pacing_threshold);
-    }
-
-    // Send each fragment (with pacing based on mode)
-    size_t offset = 0;
-    int packets_in_burst = 0;
-
-    for (size_t i = 0; i < num_fragments; i++) {
-        size_t payload_size = std::min(MAX_PAYLOAD_SIZE, size - offset);
-
-        // Build packet
-        std::vector<uint8_t> packet(sizeof(VideoPacketHeader) + payload_size);
-        VideoPacketHeader* header = reinterpret_cast<VideoPacketHeader*>(packet.data());
-
-        header->magic = VIDEO_MAGIC;
-        header->sequence = m_sequence++;
-        header->frame_number = static_cast<uint16_t>(frame_number & 0xFFFF);
-        header->flags = 0;
-        if (keyframe) header->flags |= FLAG_KEYFRAME;
-        if (i == 0) header->flags |= FLAG_START_OF_FRAME;
-        if (i == num_fragments - 1) header->flags |= FLAG_END_OF_FRAME;
-        header->fragment_idx = static_cast<uint16_t>(i);
-        header->fragment_count = static_cast<uint16_t>(num_fragments);
-        header->reserved = 0;
-        header->payload_len = static_cast<uint16_t>(payload_size);
-        header->reserved2 = 0;
-
-        // Copy payload
-        memcpy(packet.data() + sizeof(VideoPacketHeader), data + offset, payload_size);
-
-        // Send
-        if (!send_packet(packet.data(), packet.size())) {
-            return false;
+        sub.frame_paced = (size > sub.pacing_threshold);
+    }
+
+    if (sub.frame_burst < 1) {
+        sub.frame_paced = false;
+    }
+    sub.next_fragment = 0;
+    sub.next_send = std::chrono::steady_clock::now();
+}
+
+bool VideoSender::send_frame(const uint8_t* data, size_t size,
+                             uint32_t frame_number, bool keyframe, uint64_t timestamp_us,
+                             int rung, uint32_t only_subscriber) {
+    (void)timestamp_us;  // Reserved for future use
+
+    if (m_subscribers.empty() || m_socket < 0) {
+        return false;
+    }
+
+    // Calculate number of fragments needed
+    size_t num_fragments = (size + MAX_PAYLOAD_SIZE - 1) / MAX_PAYLOAD_SIZE;
+    if (num_fragments > 65535) {
+        LOG_ERROR("Frame too large: %zu bytes requires %zu fragments", size, num_fragments);
+        return false;
+    }
+
+    // Log frame sizes for diagnostics
+    if (keyframe) {
+        LOG_INFO("Keyframe %u: %zu bytes (%zu packets)", frame_number, size, num_fragments);
+    }
+
+    // Keyframe gating: subscribers that joined mid-GOP skip deltas until the next keyframe
+    std::vector<size_t> active;
+    for (size_t i = 0; i < m_subscribers.size(); i++) {
+        Subscriber& sub = m_subscribers[i];
+        if (sub.paused) {
+            continue;
         }
+        if (only_subscriber != 0) {
+            // Replayed keyframe: the live deltas that follow don't reference
+            // it, so the subscriber keeps waiting for the next live keyframe
+            if (sub.id != only_subscriber) {
+                continue;
+            }
+        } else {
+            if (sub.pending_rung == rung && keyframe) {
+                // Rung switch lands on the new rung's keyframe
+                sub.rung = rung;
+                sub.pending_rung = -1;
+                sub.waiting_for_keyframe = false;
+            }
+            if (sub.rung != rung) {
+                continue;
+            }
+            if (sub.waiting_for_keyframe) {
+                if (!keyframe) {
+                    sub.frames_skipped++;
+                    continue;
+                }
+                sub.waiting_for_keyframe = false;
+            }
+        }
+        sub.frames_sent++;
+        plan_frame(sub, size, keyframe);
+        active.push_back(i);
+    }
+
+    // Send burst by burst, always serving the subscriber whose pacer is due
+    // first, so one slow link's pauses don't add up with everyone else's
+    bool ok = true;
+    while (!active.empty()) {
+        size_t pick = 0;
+        for (size_t k = 1; k < active.size(); k++) {
+            if (m_subscribers[active[k]].next_send < m_subscribers[active[pick]].next_send) {
+                pick = k;
+            }
+        }
+        Subscriber& sub = m_subscribers[active[pick]];
 
-        offset += payload_size;
+        auto now = std::chrono::steady_clock::now();
+        if (sub.next_send > now) {
+            std::this_thread::sleep_for(sub.next_send - now);
+        }
 
-        // Pacing to prevent buffer overflow
-        if (need_pacing) {
-            packets_in_burst++;
-            if (packets_in_burst >= packets_per_burst && i < num_fragments - 1) {
-                std::this_thread::sleep_for(std::chrono::microseconds(burst_delay_us));
-                packets_in_burst = 0;
+        size_t burst = sub.frame_paced ? static_cast<size_t>(sub.frame_burst) : num_fragments;
+        for (size_t b = 0; b < burst && sub.next_fragment < num_fragments; b++) {
+            if (!send_fragment(sub, data, size, frame_number, keyframe,
+                               sub.next_fragment, num_fragments)) {
+                ok = false;
+                sub.next_fragment = num_fragments;
+                break;
             }
+            sub.next_fragment++;
+        }
+
+        if (sub.next_fragment >= num_fragments) {
+            // Don't hold parity across frames; the tail of a frame must be recoverable now
+            flush_fec(sub);
+            active.erase(active.begin() + pick);
+        } else {
+            sub.next_send = std::chrono::steady_clock::now() +
+                            std::chrono::microseconds(sub.frame_delay_us);
         }
     }
 
-    return true;
+    return ok;
 }
 
-bool VideoSender::send_packet(const uint8_t* data, size_t size) {
-    ssize_t sent = sendto(m_socket, data, size, 0,
-                          reinterpret_cast<struct sockaddr*>(&m_client_addr),
-                          sizeof(m_client_addr));
-    if (sent < 0) {
-        LOG_ERROR("Failed to send packet");
+bool VideoSender::send_fragment(Subscriber& sub, const uint8_t* data, size_t size,
+                                uint32_t frame_number, bool keyframe,
+                                size_t index, size_t num_fragments) {
+    size_t offset = index * MAX_PAYLOAD_SIZE;
+    size_t payload_size = std::min(MAX_PAYLOAD_SIZE, size - offset);
+    size_t prefix_size = sub.multiplexed ? 1 : 0;
+
+    // Build packet ([stream_id:1] in multiplexed mode, then header + payload)
+    std::vector<uint8_t> packet(prefix_size + sizeof(VideoPacketHeader) + payload_size);
+    if (sub.multiplexed) {
+        packet[0] = STREAM_ID_VIDEO;
+    }
+    VideoPacketHeader* header = reinterpret_cast<VideoPacketHeader*>(packet.data() + prefix_size);
+
+    uint16_t sequence = sub.sequence++;
+    header->magic = VIDEO_MAGIC;
+    header->sequence = sequence;
+    header->frame_number = static_cast<uint16_t>(frame_number & 0xFFFF);
+    header->flags = 0;
+    if (keyframe) header->flags |= FLAG_KEYFRAME;
+    if (index == 0) header->flags |= FLAG_START_OF_FRAME;
+    if (index == num_fragments - 1) header->flags |= FLAG_END_OF_FRAME;
+    header->fragment_idx = static_cast<uint16_t>(index);
+    header->fragment_count = static_cast<uint16_t>(num_fragments);
+    header->reserved = 0;
+    header->payload_len = static_cast<uint16_t>(payload_size);
+    header->reserved2 = 0;
+
+    // Copy payload
+    memcpy(packet.data() + prefix_size + sizeof(VideoPacketHeader), data + offset, payload_size);
+
+    // Send
+    if (!send_packet(sub, packet.data(), packet.size(), keyframe)) {
         return false;
     }
 
-    m_bytes_sent += sent;
+    if (sub.fec_group > 0) {
+        add_fec(sub, packet.data() + prefix_size, packet.size() - prefix_size,
+                sequence, header->frame_number, keyframe);
+    }
+
+    // Keep the datagram so NACKed packets can be resent as-is
+    HistoryEntry& entry = sub.history[sequence % sub.history.size()];
+    entry.valid = true;
+    entry.sequence = sequence;
+    entry.keyframe = keyframe;
+    entry.last_resend = {};
+    entry.data = std::move(packet);
+    return true;
+}
+
+void VideoSender::add_fec(Subscriber& sub, const uint8_t* datagram, size_t size, uint16_t sequence,
+                          uint16_t frame_number, bool keyframe) {
+    if (sub.fec_count == 0) {
+        sub.fec_parity.assign(sizeof(VideoPacketHeader) + MAX_PAYLOAD_SIZE, 0);
+        sub.fec_max_size = 0;
+        sub.fec_length_xor = 0;
+        sub.fec_base_sequence = sequence;
+        sub.fec_keyframe = false;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        sub.fec_parity[i] ^= datagram[i];
+    }
+    sub.fec_length_xor ^= static_cast<uint16_t>(size);
+    sub.fec_max_size = std::max(sub.fec_max_size, size);
+    sub.fec_frame_number = frame_number;
+    sub.fec_keyframe |= keyframe;
+
+    if (++sub.fec_count >= sub.fec_group) {
+        flush_fec(sub);
+    }
+}
+
+bool VideoSender::flush_fec(Subscriber& sub) {
+    if (sub.fec_count == 0) {
+        return true;
+    }
+
+    // [stream_id:1] in multiplexed mode, header, [length_xor:2], parity
+    size_t prefix_size = sub.multiplexed ? 1 : 0;
+    std::vector<uint8_t> packet(prefix_size + sizeof(VideoPacketHeader) + 2 + sub.fec_max_size);
+    if (sub.multiplexed) {
+        packet[0] = STREAM_ID_VIDEO;
+    }
+    VideoPacketHeader* header = reinterpret_cast<VideoPacketHeader*>(packet.data() + prefix_size);
+    header->magic = VIDEO_MAGIC;
+    header->sequence = sub.fec_base_sequence;
+    header->frame_number = sub.fec_frame_number;
+    header->flags = FLAG_FEC | (sub.fec_keyframe ? FLAG_KEYFRAME : 0);
+    header->reserved = 0;
+    header->fragment_idx = 0;
+    header->fragment_count = static_cast<uint16_t>(sub.fec_count);
+    header->payload_len = static_cast<uint16_t>(2 + sub.fec_max_size);
+    header->reserved2 = 0;
+
+    uint8_t* payload = packet.data() + prefix_size + sizeof(VideoPacketHeader);
+    memcpy(payload, &sub.fec_length_xor, 2);
+    memcpy(payload + 2, sub.fec_parity.data(), sub.fec_max_size);
+
+    sub.fec_count = 0;
+    sub.fec_sent++;
+    return send_packet(sub, packet.data(), packet.size(), sub.fec_keyframe);
+}
+
+bool VideoSender::send_packet(Subscriber& sub, const uint8_t* data, size_t size, bool keyframe) {
+    // Impairment shim: pretend a bottleneck marked this packet
+    uint8_t ecn = sub.ecn;
+    if (m_ce_impair > 0.0f && ecn != ECN_NOT_ECT) {
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        if (dist(m_impair_rng) < m_ce_impair) {
+            ecn = ECN_CE;
+        }
+    }
+
+    if (m_scheduler) {
+        // Keyframes go in the lowest class so their bursts never delay audio or deltas
+        TrafficClass cls = keyframe ? TrafficClass::VIDEO_KEYFRAME : TrafficClass::VIDEO_DELTA;
+        if (!m_scheduler->enqueue(cls, m_socket, sub.addr, data, size, ecn)) {
+            return false;
+        }
+    } else {
+        // ECN is per subscriber, so it's set per packet rather than on the shared socket
+        bool ok;
+        if (ecn != ECN_NOT_ECT) {
+            ok = send_datagram_tos(m_socket, sub.addr, data, size, ecn);
+        } else {
+            ok = sendto(m_socket, data, size, 0,
+                        reinterpret_cast<const struct sockaddr*>(&sub.addr),
+                        sizeof(sub.addr)) >= 0;
+        }
+        if (!ok) {
+            LOG_ERROR("Failed to send packet to subscriber %u", sub.id);
+            return false;
+        }
+    }
+
+    sub.bytes_sent += size;
+    sub.packets_sent++;
+    m_bytes_sent += size;
     m_packets_sent++;
     return true;
 }
 
+void VideoSender::process_feedback() {
+    if (m_socket < 0) {
+        return;
+    }
+
+    uint8_t buffer[1500];
+    struct sockaddr_in from = {};
+    socklen_t from_len = sizeof(from);
+
+    while (true) {
+        ssize_t n = recvfrom(m_socket, buffer, sizeof(buffer), MSG_DONTWAIT,
+                             reinterpret_cast<struct sockaddr*>(&from), &from_len);
+        if (n <= 0) {
+            break;
+        }
+
+        // Unicast subscribers by address; anything else may be a multicast receiver
+        Subscriber* sub = find_subscriber(from);
+        if (!sub) {
+            sub = find_multicast_subscriber();
+        }
+        if (!sub) {
+            continue;
+        }
+
+        const uint8_t* payload = buffer;
+        size_t payload_size = static_cast<size_t>(n);
+        if (sub->multiplexed) {
+            // Demultiplex by stream id; only feedback is expected from the client
+            if (buffer[0] != STREAM_ID_FEEDBACK) {
+                continue;
+            }
+            payload++;
+            payload_size--;
+        }
+
+        m_feedback_received++;
+        if (payload_size == 0 || handle_feedback_packet(*sub, from, payload, payload_size)) {
+            continue;
+        }
+        if (m_feedback_cb) {
+            m_feedback_cb(sub->id, payload, payload_size);
+        }
+    }
+
+    for (auto& sub : m_subscribers) {
+        resend_nacked(sub);
+        if (sub.multicast) {
+            update_receivers(sub);
+        }
+    }
+}
+
+bool VideoSender::handle_feedback_packet(Subscriber& sub, const struct sockaddr_in& from,
+                                         const uint8_t* data, size_t size) {
+    FeedbackPacketHeader header;
+    if (size < sizeof(header)) {
+        return sub.multicast;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != FEEDBACK_MAGIC || sizeof(header) + header.payload_len > size) {
+        // Unicast: let the server see it (e.g. NAT keepalives); multicast: anyone
+        // on the LAN can reach this socket, so drop it
+        return sub.multicast;
+    }
+    const uint8_t* payload = data + sizeof(header);
+
+    if (!sub.multicast) {
+        // NACKs are answered from this subscriber's own history
+        if (header.type == FEEDBACK_NACK) {
+            queue_nacks(sub, payload, header.payload_len);
+            m_nacks_received++;
+            return true;
+        }
+        return false;
+    }
+
+    Receiver* receiver = find_receiver(from);
+    if (!receiver) {
+        return true;
+    }
+    receiver->last_seen = std::chrono::steady_clock::now();
+
+    switch (header.type) {
+        case FEEDBACK_NACK:
+            queue_nacks(sub, payload, header.payload_len);
+            receiver->nacks++;
+            m_nacks_received++;
+            return true;
+
+        case FEEDBACK_RECEIVER_REPORT: {
+            if (header.payload_len < sizeof(ReceiverReport)) {
+                return true;
+            }
+            ReceiverReport report;
+            memcpy(&report, payload, sizeof(report));
+            bool had_report = receiver->have_report;
+            uint32_t received = report.packets_received - receiver->last_received;
+            uint32_t lost = report.packets_lost - receiver->last_lost;
+            uint32_t ect = report.ect_received - receiver->last_ect;
+            uint32_t ce = report.ce_received - receiver->last_ce;
+            receiver->have_report = true;
+            receiver->last_received = report.packets_received;
+            receiver->last_lost = report.packets_lost;
+            receiver->last_ect = report.ect_received;
+            receiver->last_ce = report.ce_received;
+
+            uint32_t total = received + lost;
+            if (!had_report || total == 0 || total >= (1u << 30)) {
+                return true;
+            }
+            double fraction = static_cast<double>(lost) / total;
+            receiver->loss_fraction += (fraction - receiver->loss_fraction) / 8.0;
+            if (received > 0 && ce <= received) {
+                double ce_fraction = static_cast<double>(ce) / received;
+                receiver->ce_fraction += (ce_fraction - receiver->ce_fraction) / 8.0;
+            }
+
+            // One encode serves the whole group, so the rate follows the
+            // most congested receiver: only its deltas reach the server
+            for (const auto& other : m_receivers) {
+                if (&other != receiver && other.have_report &&
+                    other.loss_fraction + other.ce_fraction > receiver->loss_fraction + receiver->ce_fraction) {
+                    return true;
+                }
+            }
+            sub.report_received += received;
+            sub.report_lost += lost;
+            sub.report_ect += ect;
+            sub.report_ce += ce;
+            if (m_feedback_cb) {
+                uint8_t packet[sizeof(FeedbackPacketHeader) + sizeof(ReceiverReport)];
+                FeedbackPacketHeader out_header = {};
+                out_header.magic = FEEDBACK_MAGIC;
+                out_header.type = FEEDBACK_RECEIVER_REPORT;
+                out_header.payload_len = sizeof(ReceiverReport);
+                ReceiverReport out_report = {};
+                out_report.highest_sequence = report.highest_sequence;
+                out_report.packets_received = sub.report_received;
+                out_report.packets_lost = sub.report_lost;
+                out_report.ect_received = sub.report_ect;
+                out_report.ce_received = sub.report_ce;
+                memcpy(packet, &out_header, sizeof(out_header));
+                memcpy(packet + sizeof(out_header), &out_report, sizeof(out_report));
+                m_feedback_cb(sub.id, packet, sizeof(packet));
+            }
+            return true;
+        }
+
+        default:
+            // Keyframe requests and anything else go to the server
+            return false;
+    }
+}
+
+void VideoSender::queue_nacks(Subscriber& sub, const uint8_t* payload, size_t size) {
+    size_t count = size / sizeof(NackEntry);
+    for (size_t i = 0; i < count; i++) {
+        NackEntry entry;
+        memcpy(&entry, payload + i * sizeof(NackEntry), sizeof(entry));
+        sub.pending_nacks.push_back(entry.sequence);
+        for (int bit = 0; bit < 16; bit++) {
+            if (entry.bitmask & (1 << bit)) {
+                sub.pending_nacks.push_back(static_cast<uint16_t>(entry.sequence + 1 + bit));
+            }
+        }
+    }
+}
+
+VideoSender::Receiver* VideoSender::find_receiver(const struct sockaddr_in& from) {
+    for (auto& receiver : m_receivers) {
+        if (receiver.addr.sin_addr.s_addr == from.sin_addr.s_addr &&
+            receiver.addr.sin_port == from.sin_port) {
+            return &receiver;
+        }
+    }
+    if (m_receivers.size() >= MAX_RECEIVERS) {
+        return nullptr;
+    }
+
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+    LOG_INFO("Multicast receiver joined: %s:%d", host, ntohs(from.sin_port));
+
+    Receiver receiver;
+    receiver.addr = from;
+    m_receivers.push_back(receiver);
+    return &m_receivers.back();
+}
+
+void VideoSender::resend_nacked(Subscriber& sub) {
+    if (sub.pending_nacks.empty()) {
+        return;
+    }
+
+    // Several receivers usually miss the same packets; resend each one once
+    std::sort(sub.pending_nacks.begin(), sub.pending_nacks.end());
+    auto last = std::unique(sub.pending_nacks.begin(), sub.pending_nacks.end());
+    m_nacks_suppressed += sub.pending_nacks.end() - last;
+    sub.pending_nacks.erase(last, sub.pending_nacks.end());
+
+    auto now = std::chrono::steady_clock::now();
+    for (uint16_t sequence : sub.pending_nacks) {
+        HistoryEntry& entry = sub.history[sequence % sub.history.size()];
+        if (!entry.valid || entry.sequence != sequence) {
+            // Too old to resend: stop sending deltas the decoder can't use
+            sub.nacks_unrecoverable++;
+            if (!sub.multicast && !sub.waiting_for_keyframe) {
+                sub.waiting_for_keyframe = true;
+                m_keyframe_rungs |= 1u << sub.rung;
+            }
+            continue;
+        }
+        if (now - entry.last_resend < NACK_HOLDOFF) {
+            m_nacks_suppressed++;
+            continue;
+        }
+        entry.last_resend = now;
+        if (send_packet(sub, entry.data.data(), entry.data.size(), entry.keyframe)) {
+            sub.retransmits++;
+        }
+    }
+    sub.pending_nacks.clear();
+}
+
+void VideoSender::update_receivers(Subscriber& sub) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_last_receiver_update < std::chrono::seconds(1)) {
+        return;
+    }
+    m_last_receiver_update = now;
+
+    // Forget receivers that stopped sending feedback
+    m_receivers.erase(std::remove_if(m_receivers.begin(), m_receivers.end(),
+        [&](const Receiver& receiver) {
+            if (now - receiver.last_seen < RECEIVER_TIMEOUT) {
+                return false;
+            }
+            char host[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &receiver.addr.sin_addr, host, sizeof(host));
+            LOG_INFO("Multicast receiver timed out: %s:%d", host, ntohs(receiver.addr.sin_port));
+            return true;
+        }), m_receivers.end());
+
+    double worst_loss = 0.0;
+    for (const auto& receiver : m_receivers) {
+        worst_loss = std::max(worst_loss, receiver.loss_fraction);
+    }
+
+    // Adaptive FEC: protect for the worst receiver
+    if (m_fec_config < 0) {
+        int group = worst_loss < 0.005 ? 0 : worst_loss < 0.02 ? 20 : worst_loss < 0.05 ? 10 : 5;
+        if (group != sub.fec_group) {
+            LOG_INFO("FEC: worst receiver loss %.2f%%, parity every %d packets",
+                     worst_loss * 100.0, group);
+            flush_fec(sub);
+            sub.fec_group = group;
+        }
+    }
+
+    // Log aggregated feedback every 5 seconds
+    if (++m_receiver_updates % 5 == 0) {
+        LOG_INFO("Multicast: %zu receivers, worst loss=%.2f%% | nacks=%lu retransmits=%lu suppressed=%lu | fec=%d parity=%lu",
+                 m_receivers.size(), worst_loss * 100.0, m_nacks_received, sub.retransmits,
+                 m_nacks_suppressed, sub.fec_group, sub.fec_sent);
+    }
+}
+
 void VideoSender::shutdown() {
     if (m_socket >= 0) {
         close(m_socket);
         m_socket = -1;
     }
-    m_client_set = false;
+    m_subscribers.clear();
 }
 
 }  // namespace stream_tablet
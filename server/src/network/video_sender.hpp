@@ -3,11 +3,16 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <functional>
+#include <random>
+#include <chrono>
 #include <netinet/in.h>
 #include <openssl/ssl.h>
 
 namespace stream_tablet {
 
+class EgressScheduler;
+
 enum class PacingMode {
     AUTO,       // Detect based on IP range
     NONE,       // No pacing (lowest latency, may drop packets)
@@ -16,45 +21,238 @@ enum class PacingMode {
     KEYFRAME    // Only pace keyframes (best for high-bandwidth links)
 };
 
+// Per-subscriber transport options
+struct SubscriberOptions {
+    PacingMode pacing = PacingMode::AUTO;  // AUTO: detect from the subscriber's IP
+    bool multiplexed = false;  // Prefix datagrams with a stream id (audio/feedback share the port)
+    bool ecn = false;          // Mark ECT(1); the receiver echoes CE counts in reports
+    int rung = 0;              // Simulcast rung to start on
+};
+
+struct SubscriberStats {
+    uint32_t id = 0;
+    std::string host;
+    uint16_t port = 0;
+    bool multicast = false;
+    bool waiting_for_keyframe = false;
+    int rung = 0;                     // Simulcast rung being received
+    uint64_t bytes_sent = 0;
+    uint64_t packets_sent = 0;
+    uint64_t frames_sent = 0;
+    uint64_t frames_skipped = 0;      // Deltas dropped while waiting for a keyframe
+    uint64_t retransmits = 0;
+    uint64_t nacks_unrecoverable = 0; // NACKed packets no longer in history
+};
+
+// Sends each encoded frame to every subscriber. Encoding happens once; each
+// subscriber has its own sequence numbers, pacer, retransmission history and
+// keyframe gate, so adding a viewer only costs network.
 class VideoSender {
 public:
+    // Called for each datagram a subscriber sends back on the video socket
+    // (stream id already stripped in multiplexed mode)
+    using FeedbackCallback = std::function<void(uint32_t subscriber_id, const uint8_t* data, size_t size)>;
+
     VideoSender();
     ~VideoSender();
 
     // Initialize UDP socket
     bool init(uint16_t port);
 
-    // Set client address (called when client connects)
-    // Automatically detects pacing mode based on IP if mode is AUTO
-    void set_client(const std::string& host, uint16_t port, PacingMode mode = PacingMode::AUTO);
+    // Add a unicast subscriber and return its id. It receives nothing until the
+    // next keyframe, so joining never hands a decoder a delta frame it can't use.
+    uint32_t add_subscriber(const std::string& host, uint16_t port,
+                            const SubscriberOptions& options = {});
+
+    // Add the subscriber for an IP multicast group (0 on failure). Feedback is
+    // then accepted from every receiver: NACKs are merged and each lost packet
+    // is resent once to the group, and parity packets follow the worst loss.
+    // Receiver reports reach the feedback callback as one report stream that
+    // follows the most congested receiver.
+    uint32_t add_multicast_subscriber(const std::string& group, uint16_t port, int ttl,
+                                      const SubscriberOptions& options = {});
+
+    void remove_subscriber(uint32_t id);
+    void clear_subscribers();
+    size_t get_subscriber_count() const { return m_subscribers.size(); }
+    std::vector<SubscriberStats> get_subscriber_stats() const;
+
+    // Bitmask of simulcast rungs that owe a subscriber a keyframe (joined,
+    // switching rungs, or NACKed a packet that can no longer be resent).
+    // Cleared by the call.
+    uint32_t take_keyframe_request();
+
+    // Move a subscriber to another simulcast rung. It keeps receiving its
+    // current rung until that rung's next keyframe, then switches cleanly.
+    void set_subscriber_rung(uint32_t id, int rung);
+    int get_subscriber_rung(uint32_t id) const;
+
+    // Change the pacing mode of every subscriber (AUTO re-detects per host)
+    void set_pacing_mode(PacingMode mode);
+
+    // Stop sending to a subscriber (its client paused). On unpause it waits
+    // for a keyframe, which is requested right away.
+    void set_subscriber_paused(uint32_t id, bool paused);
 
-    // Send encoded frame (fragments if necessary)
+    // Route packets through a shared egress scheduler (nullptr = send directly)
+    void set_scheduler(EgressScheduler* scheduler);
+
+    // Testing shim: send this fraction of ECN packets already CE-marked (0 = off)
+    void set_ce_impairment(float fraction) { m_ce_impair = fraction; }
+
+    // Multicast parity packet after every N video packets (0 = off, -1 = adapt to receiver loss)
+    void set_fec_group(int packets) { m_fec_config = packets; }
+
+    // Multicast receivers that sent feedback recently
+    size_t get_receiver_count() const { return m_receivers.size(); }
+
+    // Socket shared with other senders in multiplexed mode
+    int get_socket() const { return m_socket; }
+
+    // Drain datagrams received from subscribers (non-blocking, call from event loop)
+    void process_feedback();
+    void set_feedback_callback(FeedbackCallback cb) { m_feedback_cb = std::move(cb); }
+
+    // Send encoded frame to the subscribers of its rung (fragments if necessary).
+    // With only_subscriber set, the frame (a stored keyframe) goes to that
+    // subscriber alone and does not open its keyframe gate.
     bool send_frame(const uint8_t* data, size_t size,
-                    uint32_t frame_number, bool keyframe, uint64_t timestamp_us);
+                    uint32_t frame_number, bool keyframe, uint64_t timestamp_us,
+                    int rung = 0, uint32_t only_subscriber = 0);
 
-    // Get statistics
+    // Get statistics (all subscribers)
     uint64_t get_bytes_sent() const { return m_bytes_sent; }
     uint64_t get_packets_sent() const { return m_packets_sent; }
+    uint64_t get_feedback_received() const { return m_feedback_received; }
 
     void shutdown();
 
 private:
-    bool send_packet(const uint8_t* data, size_t size);
+    // Sent packet kept for retransmission
+    struct HistoryEntry {
+        bool valid = false;
+        uint16_t sequence = 0;
+        bool keyframe = false;
+        std::chrono::steady_clock::time_point last_resend;
+        std::vector<uint8_t> data;
+    };
+
+    struct Subscriber {
+        uint32_t id = 0;
+        struct sockaddr_in addr = {};
+        struct sockaddr_in feedback_addr = {};  // Where its feedback comes from (port 0: not seen yet)
+        std::string host;
+        bool multicast = false;
+        bool multiplexed = false;
+        uint8_t ecn = 0;                  // ECN_* codepoint for outgoing video
+
+        // Pacer
+        PacingMode pacing_mode = PacingMode::LIGHT;
+        size_t pacing_threshold = 0;      // Frame size threshold for pacing
+        int packets_per_burst = 0;        // Packets before pause
+        int burst_delay_us = 0;           // Microseconds to pause
+
+        // Current frame (subscribers are interleaved burst by burst)
+        size_t next_fragment = 0;
+        bool frame_paced = false;
+        int frame_burst = 0;
+        int frame_delay_us = 0;
+        std::chrono::steady_clock::time_point next_send;
+
+        bool waiting_for_keyframe = true;
+        bool paused = false;
+        int rung = 0;
+        int pending_rung = -1;            // Switch target, taken at its next keyframe
+        uint16_t sequence = 0;
+        std::vector<HistoryEntry> history;  // Indexed by sequence % size
+        std::vector<uint16_t> pending_nacks;
+
+        // XOR parity over consecutive video packets
+        int fec_group = 0;
+        std::vector<uint8_t> fec_parity;
+        size_t fec_max_size = 0;
+        uint16_t fec_length_xor = 0;
+        uint16_t fec_base_sequence = 0;
+        uint16_t fec_frame_number = 0;
+        bool fec_keyframe = false;
+        int fec_count = 0;
+        uint64_t fec_sent = 0;
+
+        // Multicast: the report the server's rate controller sees. The most
+        // congested receiver's counter deltas are added up here, so the
+        // counters stay continuous when another receiver becomes the worst.
+        uint32_t report_received = 0;
+        uint32_t report_lost = 0;
+        uint32_t report_ect = 0;
+        uint32_t report_ce = 0;
+
+        uint64_t bytes_sent = 0;
+        uint64_t packets_sent = 0;
+        uint64_t frames_sent = 0;
+        uint64_t frames_skipped = 0;
+        uint64_t retransmits = 0;
+        uint64_t nacks_unrecoverable = 0;
+    };
+
+    // Feedback state of one multicast receiver
+    struct Receiver {
+        struct sockaddr_in addr;
+        std::chrono::steady_clock::time_point last_seen;
+        bool have_report = false;
+        uint32_t last_received = 0;
+        uint32_t last_lost = 0;
+        uint32_t last_ect = 0;
+        uint32_t last_ce = 0;
+        double loss_fraction = 0.0;
+        double ce_fraction = 0.0;
+        uint64_t nacks = 0;
+    };
+
+    void configure_pacing(Subscriber& sub, PacingMode mode);
     PacingMode detect_pacing_mode(const std::string& host);
+    void plan_frame(Subscriber& sub, size_t size, bool keyframe);
+    bool send_fragment(Subscriber& sub, const uint8_t* data, size_t size, uint32_t frame_number,
+                       bool keyframe, size_t index, size_t num_fragments);
+    bool send_packet(Subscriber& sub, const uint8_t* data, size_t size, bool keyframe);
+
+    Subscriber* find_subscriber(uint32_t id);
+    const Subscriber* find_subscriber(uint32_t id) const;
+    Subscriber* find_subscriber(const struct sockaddr_in& from);
+    Subscriber* find_multicast_subscriber();
+
+    bool handle_feedback_packet(Subscriber& sub, const struct sockaddr_in& from,
+                                const uint8_t* data, size_t size);
+    void queue_nacks(Subscriber& sub, const uint8_t* payload, size_t size);
+    Receiver* find_receiver(const struct sockaddr_in& from);
+    void resend_nacked(Subscriber& sub);
+    void update_receivers(Subscriber& sub);
+    void add_fec(Subscriber& sub, const uint8_t* datagram, size_t size, uint16_t sequence,
+                 uint16_t frame_number, bool keyframe);
+    bool flush_fec(Subscriber& sub);
 
     int m_socket = -1;
-    struct sockaddr_in m_client_addr = {};
-    bool m_client_set = false;
+    std::vector<Subscriber> m_subscribers;
+    uint32_t m_next_subscriber_id = 1;
+    uint32_t m_keyframe_rungs = 0;    // Bit per rung
+
+    EgressScheduler* m_scheduler = nullptr;
+    FeedbackCallback m_feedback_cb;
+
+    // CE impairment shim
+    float m_ce_impair = 0.0f;
+    std::minstd_rand m_impair_rng;
+
+    // Multicast receivers (feedback from addresses that aren't unicast subscribers)
+    std::vector<Receiver> m_receivers;
+    std::chrono::steady_clock::time_point m_last_receiver_update;
+    int m_receiver_updates = 0;
+    int m_fec_config = 0;
+    uint64_t m_nacks_received = 0;
+    uint64_t m_nacks_suppressed = 0;
 
-    uint16_t m_sequence = 0;
     uint64_t m_bytes_sent = 0;
     uint64_t m_packets_sent = 0;
-
-    // Pacing configuration
-    PacingMode m_pacing_mode = PacingMode::LIGHT;
-    size_t m_pacing_threshold = 0;    // Frame size threshold for pacing
-    int m_packets_per_burst = 0;      // Packets before pause
-    int m_burst_delay_us = 0;         // Microseconds to pause
+    uint64_t m_feedback_received = 0;
 };
 
 // Video packet header (16 bytes)
@@ -78,5 +276,45 @@ constexpr uint16_t VIDEO_MAGIC = 0x5354;
 constexpr uint8_t FLAG_KEYFRAME = 0x01;
 constexpr uint8_t FLAG_START_OF_FRAME = 0x02;
 constexpr uint8_t FLAG_END_OF_FRAME = 0x04;
+// Parity packet: sequence = first protected packet, fragment_count = packets
+// covered, payload = [length_xor:2][XOR of the protected datagrams]
+constexpr uint8_t FLAG_FEC = 0x08;
+
+// Feedback packet header (8 bytes), sent by the client to the video port
+#pragma pack(push, 1)
+struct FeedbackPacketHeader {
+    uint16_t magic;         // 0x5346 ("SF")
+    uint8_t type;           // FEEDBACK_* message type
+    uint8_t reserved;
+    uint16_t payload_len;   // Payload length
+    uint16_t reserved2;
+};
+
+// FEEDBACK_RECEIVER_REPORT payload (20 bytes). Counters are cumulative so a
+// lost report does not lose information.
+struct ReceiverReport {
+    uint16_t highest_sequence;  // Highest video packet sequence seen
+    uint16_t reserved;
+    uint32_t packets_received;  // Video packets received
+    uint32_t packets_lost;      // Video packets missing (sequence gaps)
+    uint32_t ect_received;      // Packets that arrived ECT(0)/ECT(1)/CE
+    uint32_t ce_received;       // Packets that arrived CE-marked
+};
+
+// FEEDBACK_NACK payload: one or more entries (4 bytes each)
+struct NackEntry {
+    uint16_t sequence;      // First missing packet
+    uint16_t bitmask;       // Bit i set: sequence + 1 + i is missing too
+};
+#pragma pack(pop)
+
+static_assert(sizeof(NackEntry) == 4, "NackEntry must be 4 bytes");
+static_assert(sizeof(FeedbackPacketHeader) == 8, "FeedbackPacketHeader must be 8 bytes");
+static_assert(sizeof(ReceiverReport) == 20, "ReceiverReport must be 20 bytes");
+
+constexpr uint16_t FEEDBACK_MAGIC = 0x5346;  // "SF"
+constexpr uint8_t FEEDBACK_RECEIVER_REPORT = 0x01;
+constexpr uint8_t FEEDBACK_NACK = 0x02;
+constexpr uint8_t FEEDBACK_KEYFRAME_REQUEST = 0x03;  // Receiver joined or cannot recover
 
 }  // namespace stream_tablet
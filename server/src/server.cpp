@@ -4,6 +4,14 @@
 #include <thread>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdarg>
+#include <openssl/rand.h>
 
 #ifdef HAVE_X11
 #include "capture/x11_capture.hpp"
@@ -19,6 +27,11 @@ Server::Server() = default;
 
 Server::~Server() {
     stop();
+    // The input thread calls into uinput, which is destroyed before the receiver
+    if (m_input_receiver) {
+        m_input_receiver->stop_thread();
+    }
+    m_input_recorder.close();
 }
 
 bool Server::create_capture_backend(const char* display) {
@@ -97,27 +110,21 @@ bool Server::init(const ServerConfig& config) {
     LOG_INFO("Using %s capture backend", m_capture->get_name());
 
     // Initialize VA-API encoder
-    EncoderConfig enc_config;
-    enc_config.width = m_capture->get_width();
-    enc_config.height = m_capture->get_height();
-    enc_config.framerate = config.capture_fps;
-    enc_config.bitrate = config.bitrate;
-    enc_config.gop_size = config.gop_size;
-    enc_config.low_latency = (config.quality_mode != QualityMode::HIGH_QUALITY &&
-                               config.quality_mode != QualityMode::AUTO);
-    enc_config.quality_mode = config.quality_mode;
-    enc_config.codec_type = config.codec_type;
-    enc_config.cqp = config.cqp;
-
-    m_encoder = std::make_unique<VAAPIEncoder>();
-    if (!m_encoder->init(enc_config)) {
+    m_encoder = std::make_unique<SimulcastEncoder>();
+    if (!m_encoder->init(make_encoder_config(), config.simulcast_rungs)) {
         LOG_ERROR("Failed to initialize VA-API encoder");
         return false;
     }
 
     // Initialize control server
     m_control = std::make_unique<ControlServer>();
-    if (!m_control->init_plain(config.control_port)) {
+    m_control->set_max_clients(config.max_clients);
+    m_control->set_heartbeat(config.heartbeat_ms, config.heartbeat_misses);
+    m_control->set_early_data(config.tls_early_data);
+    bool control_ok = config.tls
+        ? m_control->init(config.control_port, config.cert_file, config.key_file)
+        : m_control->init_plain(config.control_port);
+    if (!control_ok) {
         LOG_ERROR("Failed to initialize control server");
         return false;
     }
@@ -129,31 +136,130 @@ bool Server::init(const ServerConfig& config) {
         return false;
     }
 
+    // Initialize egress scheduler (optional)
+    if (config.egress_mode != 0) {
+        m_egress = std::make_unique<EgressScheduler>();
+        EgressMode mode = (config.egress_mode == 2) ? EgressMode::WEIGHTED : EgressMode::STRICT;
+        if (m_egress->start(mode)) {
+            m_video_sender->set_scheduler(m_egress.get());
+        } else {
+            LOG_WARN("Failed to start egress scheduler, sending directly");
+            m_egress.reset();
+        }
+    }
+
     // Initialize input receiver
     m_input_receiver = std::make_unique<InputReceiver>();
     if (!m_input_receiver->init(config.input_port)) {
         LOG_ERROR("Failed to initialize input receiver");
         return false;
     }
+    if (config.udp_input && !m_input_receiver->init_udp(config.input_port)) {
+        LOG_WARN("UDP input unavailable, clients will use TCP");
+        m_config.udp_input = false;
+    }
 
     // Initialize uinput
     m_uinput = std::make_unique<UInputBackend>();
-    if (!m_uinput->init(m_capture->get_width(), m_capture->get_height())) {
+    if (!config.uinput_sink.empty()) {
+        // Stand-in for /dev/uinput (benchmarks, CI): raw input_event records
+        int fds[3];
+        for (int& fd : fds) {
+            fd = open(config.uinput_sink.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        }
+        if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+            LOG_ERROR("Cannot open uinput sink %s: %s", config.uinput_sink.c_str(), strerror(errno));
+            for (int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+            return false;
+        }
+        m_uinput->attach_fds(fds[0], fds[1], fds[2], m_capture->get_width(), m_capture->get_height());
+        LOG_INFO("Writing input events to %s instead of uinput devices", config.uinput_sink.c_str());
+    } else if (!m_uinput->init(m_capture->get_width(), m_capture->get_height())) {
         LOG_WARN("Failed to initialize uinput (stylus input may not work)");
         // Continue without uinput - it's not fatal
     }
 
+    if (!config.input_record_path.empty() && !m_input_recorder.open(config.input_record_path)) {
+        return false;
+    }
+
+    m_stylus_predictor.set_horizon_ms(static_cast<float>(config.stylus_predict_ms));
+    if (config.stylus_predict_ms > 0) {
+        LOG_INFO("Stylus prediction: %d ms ahead", config.stylus_predict_ms);
+    }
+
     // Set input callback
     m_input_receiver->set_callback([this](const InputEvent& event) {
         handle_input(event);
     });
 
+    m_input_pacer.set_max_delay_us(config.input_pace_us);
+    if (config.input_pace_us >= 0) {
+        LOG_INFO("Stylus pacing: original sample spacing, up to %d us added", config.input_pace_us);
+    }
+
+    // Input on its own thread, so it never waits for the frame loop
+    if (config.input_thread) {
+        if (config.input_coalesce_us >= 0 || config.input_pace_us >= 0) {
+            m_input_receiver->set_idle_callback([this]() {
+                flush_coalesced_input(false);
+            });
+        }
+        if (!m_input_receiver->start_thread(config.input_rt_priority)) {
+            LOG_WARN("Failed to start input thread, polling input from the frame loop");
+        }
+    }
+
+    // Receiver reports drive the rate controller
+    m_video_sender->set_feedback_callback([this](uint32_t subscriber_id, const uint8_t* data, size_t size) {
+        handle_feedback(subscriber_id, data, size);
+    });
+
     // Set keyframe callback
-    m_control->set_keyframe_callback([this]() {
-        LOG_INFO("Keyframe requested by client");
-        m_encoder->request_keyframe();
+    m_control->set_keyframe_callback([this](uint32_t client_id) {
+        LOG_INFO("Keyframe requested by client %u", client_id);
+        request_shared_keyframe("client request");
+    });
+
+    m_control->set_disconnect_callback([this](uint32_t client_id) {
+        on_client_disconnected(client_id);
     });
 
+    m_control->set_pause_callback([this](uint32_t client_id, bool paused) {
+        on_client_paused(client_id, paused);
+    });
+
+    // Viewers share the primary client's stream, so only it may change it
+    m_control->set_param_callback([this](uint32_t client_id, uint8_t param, int32_t& value) {
+        if (client_id != m_primary_client) {
+            LOG_WARN("Client %u is not the primary client, ignoring parameter change", client_id);
+            value = 0;
+            return PARAM_REJECTED;
+        }
+        return set_param(param, value);
+    });
+
+    // Stats and live tuning for operators (--admin-socket)
+    if (!config.admin_socket.empty()) {
+        m_admin = std::make_unique<AdminServer>();
+        m_admin->set_command_handler([this](const std::vector<std::string>& args,
+                                            std::string& reply, std::string& error) {
+            return handle_admin(args, reply, error);
+        });
+        if (!m_admin->init(config.admin_socket)) {
+            LOG_ERROR("Failed to initialize admin socket");
+            return false;
+        }
+        // Commands are also answered while waiting for a client
+        m_control->set_idle_callback([this]() {
+            if (m_admin->has_pending()) {
+                m_admin->process();
+            }
+        });
+    }
+
     LOG_INFO("Server initialized: %dx%d @ %d fps",
              m_capture->get_width(), m_capture->get_height(), config.capture_fps);
 
@@ -188,65 +294,115 @@ void Server::run() {
             continue;
         }
 
-        // Send configuration to client (with audio and codec info)
-        uint8_t codec_type = m_encoder->get_codec_type();
-#ifdef HAVE_OPUS
-        int audio_port = m_audio_initialized ? m_config.audio_port : 0;
-#else
-        int audio_port = 0;
-#endif
-        m_control->send_config_full(m_capture->get_width(), m_capture->get_height(),
-                                    m_config.video_port, m_config.input_port,
-                                    audio_port, m_config.audio_sample_rate,
-                                    m_config.audio_channels, m_config.audio_frame_ms,
-                                    codec_type);
-
-        // Set video destination with pacing mode
-        PacingMode pacing = static_cast<PacingMode>(m_config.pacing_mode);
-        m_video_sender->set_client(client_info.host, client_info.video_port, pacing);
-
-#ifdef HAVE_OPUS
-        // Set audio destination and start audio capture
-        if (m_audio_initialized && m_audio_sender && m_audio_capture) {
-            m_audio_sender->set_client(client_info.host, m_config.audio_port);
-            m_audio_sequence = 0;
-            m_audio_capture->start([this](const AudioFrame& frame) {
-                on_audio_frame(frame);
-            });
-            LOG_INFO("Audio capture started for client");
+        // First client starts the session and owns input and audio
+        m_primary_client = client_info.id;
+        if (m_encoder->get_rung_count() == 1) {
+            m_encoder->get_encoder(0).set_bitrate(m_config.bitrate);
+            m_encoder->get_encoder(0).set_qp(m_config.cqp);
         }
-#endif
-
-        // Initialize coordinate transform
-        m_coord_transform.init(m_capture->get_width(), m_capture->get_height(),
-                               client_info.width, client_info.height,
-                               CoordTransform::Mode::LETTERBOX, false);
+        start_client(client_info);
 
         printf("Client connected from %s - streaming started\n", client_info.host.c_str());
         LOG_INFO("Client connected, starting stream...");
 
         // Reset frame count for new session
         m_frame_count = 0;
-        m_encoder->request_keyframe();  // Start with a keyframe
+        m_encoder->request_keyframe_all();  // Start with a keyframe
 
-        // Calculate frame interval
-        auto frame_interval = std::chrono::microseconds(1000000 / m_config.capture_fps);
+        // Calculate frame interval (recomputed when PARAM_FPS changes it)
+        int loop_fps = m_config.capture_fps;
+        auto frame_interval = std::chrono::microseconds(1000000 / loop_fps);
         auto next_frame = std::chrono::high_resolution_clock::now();
 
-        // Stream loop - runs until client disconnects
-        while (m_running && m_control->is_client_connected()) {
+        // Input-triggered capture: input pulls the next frame forward to
+        // settle time after it arrived, but never closer than the cap
+        // allows to the previous capture
+        bool input_trigger = m_config.input_trigger_us >= 0;
+        auto trigger_fps_for = [this](int fps) {
+            return m_config.input_trigger_max_fps > 0 ? m_config.input_trigger_max_fps : fps;
+        };
+        auto trigger_settle = std::chrono::microseconds(std::max(0, m_config.input_trigger_us));
+        auto trigger_interval = std::chrono::microseconds(1000000 / trigger_fps_for(loop_fps));
+        auto last_capture = std::chrono::steady_clock::now() - trigger_interval;
+        m_input_trigger_ns = 0;
+
+        // Stream loop - runs until the last client disconnects and no
+        // dropped client's session is waiting for it to come back
+        while (m_running && (m_control->is_client_connected() || !m_parked_sessions.empty())) {
             auto now = std::chrono::high_resolution_clock::now();
 
-            // Process control messages
+            // Further clients join the running encode as extra subscribers;
+            // with session resume, a dropped client can come back any time
+            if (m_config.max_clients > 1 || m_config.resume_grace_ms > 0) {
+                ClientInfo viewer_info;
+                if (m_control->poll_accept(viewer_info)) {
+                    start_client(viewer_info);
+                }
+            }
+            expire_parked_sessions();
+            if (update_suspended()) {
+                // Client is back: capture its keyframe now, not at the next tick
+                next_frame = now;
+            }
+
+            // Process control messages, and admin commands between frames
             m_control->process();
+            if (m_admin && m_admin->has_pending()) {
+                m_admin->process();
+            }
+            if (m_config.capture_fps != loop_fps) {
+                loop_fps = m_config.capture_fps;
+                frame_interval = std::chrono::microseconds(1000000 / loop_fps);
+                trigger_interval = std::chrono::microseconds(1000000 / trigger_fps_for(loop_fps));
+                next_frame = std::min(next_frame, now + frame_interval);
+            }
+
+            // Input latency follows the measured client clock (re-read every
+            // iteration so the skew is applied as time goes on)
+            const ClockSync* client_clock = m_control->get_clock_sync(m_primary_client);
+            if (client_clock && client_clock->is_synced()) {
+                m_input_latency.set_clock_offset(-client_clock->get_offset_us(ControlServer::now_us()) / 1000);
+            }
 
             // Process input events with high priority (no sleep between)
             m_input_receiver->process();
+            flush_coalesced_input(false);
+
+            // Drain client datagrams on the video socket (feedback, NAT keepalives)
+            m_video_sender->process_feedback();
+            if (uint32_t rungs = m_video_sender->take_keyframe_request()) {
+                request_shared_keyframe("subscriber waiting for keyframe", rungs);
+            }
+
+            // Input arrived while idle: capture once it has settled
+            bool triggered = false;
+            auto trigger_at = std::chrono::steady_clock::time_point::max();
+            if (input_trigger && m_input_trigger_ns != 0) {
+                auto armed = std::chrono::steady_clock::time_point(
+                    std::chrono::nanoseconds(m_input_trigger_ns.load()));
+                trigger_at = std::max(armed + trigger_settle, last_capture + trigger_interval);
+                triggered = std::chrono::steady_clock::now() >= trigger_at;
+            }
 
             // Check if it's time for next frame
-            if (now >= next_frame) {
-                capture_and_encode_loop();
-                next_frame += frame_interval;
+            if (now >= next_frame || triggered) {
+                // Input from here on needs the next frame
+                m_input_trigger_ns = 0;
+                last_capture = std::chrono::steady_clock::now();
+
+                // Held input lands before the frame that should show it
+                flush_coalesced_input(true);
+                if (!m_suspended && !skip_frame_for_backoff()) {
+                    capture_and_encode_loop();
+                }
+
+                if (triggered && now < next_frame) {
+                    // Early frame: the regular cadence restarts from here
+                    m_triggered_frames++;
+                    next_frame = now + frame_interval;
+                } else {
+                    next_frame += frame_interval;
+                }
 
                 // If we're behind, skip frames
                 if (next_frame < now) {
@@ -257,24 +413,28 @@ void Server::run() {
             // Calculate time until next frame and sleep smartly
             auto time_to_next = std::chrono::duration_cast<std::chrono::microseconds>(
                 next_frame - std::chrono::high_resolution_clock::now());
+            if (input_trigger && trigger_at != std::chrono::steady_clock::time_point::max()) {
+                time_to_next = std::min(time_to_next, std::chrono::duration_cast<std::chrono::microseconds>(
+                    trigger_at - std::chrono::steady_clock::now()));
+            }
 
             // For high FPS (>90), use tighter timing to avoid sleep overshooting
             if (m_config.capture_fps > 90) {
                 // High FPS mode: sleep less aggressively, busy-wait for last 500us
                 if (time_to_next.count() > 2000) {
                     // Sleep for 60% of remaining time (leaving margin for oversleep)
-                    std::this_thread::sleep_for(time_to_next * 6 / 10);
+                    idle_wait(time_to_next * 6 / 10);
                 } else if (time_to_next.count() > 500) {
                     // Short sleep
-                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    idle_wait(std::chrono::microseconds(100));
                 }
                 // Busy wait for last 500us for accuracy
             } else {
                 // Normal/Low FPS mode: can sleep more aggressively
                 if (time_to_next.count() > 1000) {
-                    std::this_thread::sleep_for(time_to_next / 2);
+                    idle_wait(time_to_next / 2);
                 } else if (time_to_next.count() > 100) {
-                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    idle_wait(std::chrono::microseconds(50));
                 }
             }
         }
@@ -289,12 +449,25 @@ void Server::run() {
                 LOG_INFO("Audio capture stopped");
             }
 #endif
-            // Release all pressed buttons/tools before resetting
-            if (m_uinput && m_uinput->is_initialized()) {
-                m_uinput->reset_all();
+            release_input();
+            if (m_egress) {
+                m_egress->clear();
             }
             m_control->reset();
-            m_input_receiver->reset();
+            m_video_sender->clear_subscribers();
+            m_client_subscribers.clear();
+            m_rate_controllers.clear();
+            m_rung_assignments.clear();
+            m_session_tokens.clear();
+            m_parked_sessions.clear();
+            m_keyframe_cache.clear();
+            m_primary_client = 0;
+            m_multicast_subscriber = 0;
+            if (m_suspended) {
+                m_capture->set_active(true);
+            }
+            m_suspended = false;
+            m_audio_parked = false;
         }
     }
 
@@ -321,19 +494,37 @@ void Server::capture_and_encode_loop() {
 
     auto t1 = std::chrono::high_resolution_clock::now();
 
-    // Encode frame
-    EncodedFrame encoded;
+    // Encode frame (once per active simulcast rung)
     if (!m_encoder->encode(frame.data, frame.width, frame.height, frame.stride,
-                           frame.timestamp_us, encoded)) {
+                           frame.timestamp_us, m_rung_frames)) {
         encode_fail_count++;
         return;  // Encoder not ready yet or error
     }
 
     auto t2 = std::chrono::high_resolution_clock::now();
 
-    // Send to client
-    bool sent = m_video_sender->send_frame(encoded.data.data(), encoded.data.size(),
-                               m_frame_count, encoded.is_keyframe, encoded.timestamp_us);
+    // Send each rung to its subscribers
+    bool sent = false;
+    size_t encoded_bytes = 0;
+    bool keyframe = false;
+    for (const RungFrame& out : m_rung_frames) {
+        const EncodedFrame& encoded = out.frame;
+        sent |= m_video_sender->send_frame(encoded.data.data(), encoded.data.size(),
+                                           m_frame_count, encoded.is_keyframe,
+                                           encoded.timestamp_us, out.rung);
+        encoded_bytes += encoded.data.size();
+        keyframe |= encoded.is_keyframe;
+        if (encoded.is_keyframe && m_config.resume_grace_ms > 0) {
+            // Reuses the buffer: keyframes of a rung are about the same size
+            EncodedFrame& cached = m_keyframe_cache[out.rung];
+            cached.data.assign(encoded.data.begin(), encoded.data.end());
+            cached.timestamp_us = encoded.timestamp_us;
+            cached.is_keyframe = true;
+        }
+    }
+    if (m_encoder->get_rung_count() > 1) {
+        update_active_rungs();
+    }
 
     auto t3 = std::chrono::high_resolution_clock::now();
 
@@ -353,22 +544,212 @@ void Server::capture_and_encode_loop() {
                      total_send_us / 1000.0 / timing_count,
                      capture_fail_count, encode_fail_count, timing_count);
         }
+        if (m_video_sender->get_feedback_received() > 0) {
+            for (const auto& entry : m_rate_controllers) {
+                const RateController& rate = entry.second;
+                int rung = std::max(0, m_video_sender->get_subscriber_rung(entry.first));
+                const VAAPIEncoder& encoder = m_encoder->get_encoder(rung);
+                LOG_INFO("Rate[%u]: target=%.2fMbps rung=%d encoder=%.2fMbps qp=%d | ce_alpha=%.3f loss=%.2f%%",
+                         entry.first, rate.get_target_bitrate() / 1e6, rung,
+                         encoder.get_bitrate() / 1e6, encoder.get_qp(),
+                         rate.get_ce_alpha(), rate.get_loss_fraction() * 100.0);
+            }
+        }
+        uint64_t events_in = m_input_events_in.exchange(0);
+        uint64_t events_out = m_input_events_out.exchange(0);
+        if (m_config.input_coalesce_us >= 0 && events_in > 0) {
+            LOG_INFO("Input: %lu events in, %lu written (%.1f%% coalesced)",
+                     events_in, events_out, 100.0 * (events_in - events_out) / events_in);
+        }
+        if (m_config.input_pace_us >= 0) {
+            LatencyHistogram::Snapshot hold = m_input_pacer.get_hold_stats(true);
+            uint64_t capped = m_input_pacer.take_capped();
+            if (hold.count > 0) {
+                LOG_INFO("Stylus pacing: %lu samples held p50=%.2f p99=%.2f max=%.2fms, %lu at the %d us bound",
+                         hold.count, hold.percentile(50) / 1000.0, hold.percentile(99) / 1000.0,
+                         hold.max_us / 1000.0, capped, m_config.input_pace_us);
+            }
+        }
+        if (m_triggered_frames > 0) {
+            LOG_INFO("Input-triggered frames: %u of %d", m_triggered_frames, timing_count);
+            m_triggered_frames = 0;
+        }
+        if (m_backoff_skipped > 0) {
+            LOG_INFO("Rate backoff: %u frames dropped until the encoder took the lower rate",
+                     m_backoff_skipped);
+            m_backoff_skipped = 0;
+        }
+        if (m_input_receiver->get_udp_duplicates() > 0 || m_input_receiver->get_udp_lost() > 0) {
+            LOG_INFO("UDP input: %lu samples lost, %lu redundant copies, %lu datagrams rejected",
+                     m_input_receiver->get_udp_lost(), m_input_receiver->get_udp_duplicates(),
+                     m_input_receiver->get_udp_rejected());
+        }
+        const ClockSync* client_clock = m_control->get_clock_sync(m_primary_client);
+        if (client_clock && client_clock->is_synced()) {
+            LOG_INFO("Client clock: offset=%+.3fms skew=%+.1fppm min rtt=%.2fms (%lu exchanges)",
+                     client_clock->get_offset_us(ControlServer::now_us()) / 1000.0, client_clock->get_skew_ppm(),
+                     client_clock->get_min_rtt_us() / 1000.0, client_clock->get_sample_count());
+        }
+        for (const InputLatencyStats& lat : m_input_latency.get_stats(true)) {
+            LOG_INFO("Input latency %s (n=%lu): net%s p50=%.1f p99=%.1fms | queue p50=%.2f p99=%.2fms | "
+                     "write p50=%.2f p99=%.2fms | total p99=%.2f max=%.2fms",
+                     InputLatency::type_name(lat.type), lat.total.count,
+                     lat.clock_synced ? "" : "(rel)",
+                     lat.network.percentile(50) / 1000.0, lat.network.percentile(99) / 1000.0,
+                     lat.queue.percentile(50) / 1000.0, lat.queue.percentile(99) / 1000.0,
+                     lat.write.percentile(50) / 1000.0, lat.write.percentile(99) / 1000.0,
+                     lat.total.percentile(99) / 1000.0, lat.total.max_us / 1000.0);
+        }
+        if (m_encoder->get_rung_count() > 1) {
+            double elapsed_s = std::chrono::duration<double>(now - last_timing_log).count();
+            LOG_INFO("Simulcast: shared convert=%.2fms/frame", m_encoder->take_convert_ms());
+            auto rungs = m_encoder->take_stats();
+            for (size_t i = 0; i < rungs.size(); i++) {
+                const RungStats& rung = rungs[i];
+                LOG_INFO("Rung[%zu] %dx%d%s: %.2fMbps out (target %.2f) | cpu=%.2fms gpu=%.2fms per frame",
+                         i, rung.width, rung.height, rung.active ? "" : " (idle)",
+                         rung.bytes * 8 / elapsed_s / 1e6, rung.bitrate / 1e6,
+                         rung.cpu_ms, rung.gpu_ms);
+            }
+        }
+        if (m_video_sender->get_subscriber_count() > 1) {
+            for (const auto& sub : m_video_sender->get_subscriber_stats()) {
+                LOG_INFO("Subscriber %u (%s%s): frames=%lu skipped=%lu | %.1fMB sent, retransmits=%lu unrecoverable=%lu",
+                         sub.id, sub.host.c_str(), sub.multicast ? ", multicast" : "",
+                         sub.frames_sent, sub.frames_skipped, sub.bytes_sent / 1e6,
+                         sub.retransmits, sub.nacks_unrecoverable);
+            }
+        }
+        if (timing_count > 0) {
+            m_stage_stats.window_s = std::chrono::duration<double>(now - last_timing_log).count();
+            m_stage_stats.frames = timing_count;
+            m_stage_stats.capture_ms = total_capture_us / 1000.0 / timing_count;
+            m_stage_stats.encode_ms = total_encode_us / 1000.0 / timing_count;
+            m_stage_stats.send_ms = total_send_us / 1000.0 / timing_count;
+            m_stage_stats.capture_fails = capture_fail_count;
+            m_stage_stats.encode_fails = encode_fail_count;
+        }
         total_capture_us = total_encode_us = total_send_us = 0;
         capture_fail_count = encode_fail_count = timing_count = 0;
         last_timing_log = now;
     }
 
-    if (m_frame_count % 60 == 0 || encoded.is_keyframe) {
-        LOG_DEBUG("Frame %d: %zu bytes, keyframe=%d, sent=%d",
-                  m_frame_count, encoded.data.size(), encoded.is_keyframe, sent);
+    if (m_frame_count % 60 == 0 || keyframe) {
+        LOG_DEBUG("Frame %d: %zu bytes in %zu rung(s), keyframe=%d, sent=%d",
+                  m_frame_count, encoded_bytes, m_rung_frames.size(), keyframe, sent);
     }
     m_frame_count++;
 }
 
+void Server::idle_wait(std::chrono::microseconds timeout) {
+    // Input-triggered mode: the first input since the last capture ends
+    // the wait, so the frame loop can schedule the early capture
+    if (m_config.input_trigger_us < 0 || m_input_trigger_ns != 0) {
+        std::this_thread::sleep_for(timeout);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_trigger_mutex);
+    m_trigger_cv.wait_for(lock, timeout, [this] { return m_input_trigger_ns != 0; });
+}
+
 void Server::handle_input(const InputEvent& event) {
     if (!m_uinput || !m_uinput->is_initialized()) {
         return;
     }
+    if (m_config.input_trigger_us >= 0 && m_input_trigger_ns == 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_trigger_mutex);
+            m_input_trigger_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        m_trigger_cv.notify_one();
+    }
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    m_input_events_in++;
+    m_input_recorder.record(event);
+
+    bool stylus = (event.type == InputEventType::STYLUS_DOWN || event.type == InputEventType::STYLUS_MOVE ||
+                   event.type == InputEventType::STYLUS_UP || event.type == InputEventType::STYLUS_HOVER);
+    if (stylus && m_config.input_pace_us >= 0) {
+        // Everything stylus goes through the pacer so DOWN/UP stay in order
+        m_input_pacer.push(event, event.received_ns ? event.received_ns : InputLatency::now_ns());
+        release_paced_input();
+        return;
+    }
+
+    if (m_config.input_coalesce_us < 0) {
+        dispatch_input(event);
+        return;
+    }
+
+    uint16_t pointer = stylus ? (0x100 | event.pointer_id) : event.pointer_id;
+    bool mergeable = (event.type == InputEventType::STYLUS_MOVE || event.type == InputEventType::STYLUS_HOVER ||
+                      event.type == InputEventType::TOUCH_MOVE);
+
+    auto pending = std::find_if(m_pending_input.begin(), m_pending_input.end(),
+                                [pointer](const PendingInput& p) { return p.pointer == pointer; });
+    if (pending != m_pending_input.end()) {
+        // Only a plain position update replaces the held sample; a different
+        // type (DOWN/UP, MOVE<->HOVER) or button change writes it out first
+        if (mergeable && pending->event.type == event.type &&
+            pending->event.buttons == event.buttons) {
+            pending->event = event;
+            return;
+        }
+        dispatch_input(pending->event);
+        m_pending_input.erase(pending);
+    }
+
+    if (!mergeable) {
+        dispatch_input(event);
+        return;
+    }
+
+    PendingInput held;
+    held.pointer = pointer;
+    held.event = event;
+    held.first_seen = std::chrono::steady_clock::now();
+    m_pending_input.push_back(held);
+}
+
+void Server::flush_coalesced_input(bool force) {
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    // Paced samples go out on their own schedule, forced or not
+    release_paced_input();
+    if (m_pending_input.empty()) {
+        return;
+    }
+    // Window 0 coalesces within one receive batch only
+    auto now = std::chrono::steady_clock::now();
+    auto window = std::chrono::microseconds(std::max(0, m_config.input_coalesce_us));
+    for (auto it = m_pending_input.begin(); it != m_pending_input.end();) {
+        if (force || now - it->first_seen >= window) {
+            dispatch_input(it->event);
+            it = m_pending_input.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Server::release_paced_input() {
+    if (m_input_pacer.empty()) {
+        return;
+    }
+    InputEvent event;
+    while (m_input_pacer.pop_due(InputLatency::now_ns(), event)) {
+        dispatch_input(event);
+    }
+    // Precise wakeup for the next one (the idle poll is only per millisecond)
+    m_input_receiver->set_wake_time(m_input_pacer.next_due_ns());
+}
+
+void Server::dispatch_input(const InputEvent& event) {
+    if (!m_uinput || !m_uinput->is_initialized()) {
+        return;
+    }
+    m_input_events_out++;
+    uint64_t dispatch_ns = InputLatency::now_ns();
 
     // Transform coordinates
     int screen_x, screen_y;
@@ -392,36 +773,1006 @@ void Server::handle_input(const InputEvent& event) {
             bool button2 = (event.buttons & 0x04) != 0;  // Tertiary button
             bool eraser = (event.buttons & 0x20) != 0;   // Eraser mode
 
+            // Draw slightly ahead of the pen while it moves on the surface
+            if (!tip_down) {
+                snap_back_stylus();
+            }
+            if (m_config.stylus_predict_ms > 0) {
+                if (event.type != InputEventType::STYLUS_MOVE) {
+                    m_stylus_predictor.reset();
+                }
+                if (tip_down) {
+                    float px, py;
+                    m_last_stylus = event;
+                    m_stylus_predicted = m_stylus_predictor.update(event.x, event.y, event.timestamp_ms, px, py);
+                    if (m_stylus_predicted) {
+                        m_coord_transform.transform(px, py, screen_x, screen_y);
+                    }
+                }
+            }
+
             m_uinput->send_stylus(screen_x, screen_y, event.pressure,
                                    event.tilt_x, event.tilt_y,
                                    tip_down, button1, button2, eraser);
-            m_uinput->sync();
             break;
         }
 
         case InputEventType::STYLUS_UP: {
+            snap_back_stylus();
+            m_stylus_predictor.reset();
+
             // Pass in_range=false to release BTN_TOOL_PEN
             m_uinput->send_stylus(screen_x, screen_y, 0.0f,
                                    event.tilt_x, event.tilt_y,
                                    false, false, false, false, false);
-            m_uinput->sync();
             break;
         }
 
         case InputEventType::TOUCH_DOWN:
         case InputEventType::TOUCH_MOVE:
             m_uinput->send_touch(screen_x, screen_y, event.pointer_id, true, event.pressure);
-            m_uinput->sync();
             break;
 
         case InputEventType::TOUCH_UP:
             m_uinput->send_touch(screen_x, screen_y, event.pointer_id, false, 0.0f);
-            m_uinput->sync();
             break;
 
         default:
             break;
     }
+
+    m_input_latency.record(event, dispatch_ns, InputLatency::now_ns());
+}
+
+void Server::snap_back_stylus() {
+    // The stroke must end where the pen really lifted, not at the last
+    // extrapolated point
+    if (!m_stylus_predicted) {
+        return;
+    }
+    int true_x, true_y;
+    m_coord_transform.transform(m_last_stylus.x, m_last_stylus.y, true_x, true_y);
+    m_uinput->send_stylus(true_x, true_y, m_last_stylus.pressure,
+                           m_last_stylus.tilt_x, m_last_stylus.tilt_y, true,
+                           (m_last_stylus.buttons & 0x02) != 0,
+                           (m_last_stylus.buttons & 0x04) != 0,
+                           (m_last_stylus.buttons & 0x20) != 0);
+    m_stylus_predicted = false;
+}
+
+void Server::start_client(const ClientInfo& client_info) {
+    // A client coming back with its token picks up its parked session
+    ParkedSession resumed;
+    bool resuming = false;
+    if (!client_info.resume_token.empty()) {
+        for (auto it = m_parked_sessions.begin(); it != m_parked_sessions.end(); ++it) {
+            if (it->token == client_info.resume_token) {
+                resumed = std::move(*it);
+                m_parked_sessions.erase(it);
+                resuming = true;
+                break;
+            }
+        }
+        if (!resuming) {
+            LOG_INFO("Client %u: session token unknown or expired, starting fresh", client_info.id);
+        }
+    }
+
+    // Input and audio go to whoever connects while nobody holds them. A
+    // dropped primary's parked session keeps them until it returns or
+    // expires; with a single client slot a newcomer can only be its
+    // replacement, so it takes over.
+    bool reserved = m_config.max_clients > 1 &&
+                    std::any_of(m_parked_sessions.begin(), m_parked_sessions.end(),
+                                [](const ParkedSession& parked) { return parked.primary; });
+    if (m_primary_client == 0 && !reserved) {
+        m_primary_client = client_info.id;
+    }
+    if (resuming && resumed.primary && client_info.id != m_primary_client) {
+        LOG_WARN("Client %u resumed, but client %u holds input now; joining as viewer",
+                 client_info.id, m_primary_client);
+    }
+    bool primary = (client_info.id == m_primary_client);
+
+    // Multicast video if configured and the client can join the group
+    bool multicast = !m_config.multicast_group.empty() &&
+                     (client_info.capabilities & CLIENT_CAP_MULTICAST);
+    if (!m_config.multicast_group.empty() && !multicast) {
+        LOG_WARN("Client does not support multicast, falling back to unicast video");
+    }
+
+    // Multiplex all UDP traffic over the video socket if both sides support it
+    // (not with multicast: the group port can't carry per-client audio)
+    bool multiplexed = m_config.udp_mux && !multicast &&
+                       (client_info.capabilities & CLIENT_CAP_MUX);
+    bool ecn = m_config.ecn && (client_info.capabilities & CLIENT_CAP_ECN);
+    // Only the primary client sends input
+    bool compact_input = primary && m_config.compact_input &&
+                         (client_info.capabilities & CLIENT_CAP_COMPACT_INPUT);
+    bool udp_input = primary && m_config.udp_input &&
+                     (client_info.capabilities & CLIENT_CAP_UDP_INPUT);
+    bool clock_sync = primary && m_config.clock_sync &&
+                      (client_info.capabilities & CLIENT_CAP_CLOCK_SYNC);
+    // Multicast clients share one subscriber, so there is nothing of their
+    // own to keep
+    bool resumable = m_config.resume_grace_ms > 0 && !multicast &&
+                     (client_info.capabilities & CLIENT_CAP_RESUME);
+    std::vector<uint8_t> session_token;
+    if (resumable) {
+        session_token.resize(SESSION_TOKEN_SIZE);
+        if (RAND_bytes(session_token.data(), static_cast<int>(session_token.size())) == 1) {
+            m_session_tokens[client_info.id] = session_token;
+        } else {
+            LOG_WARN("Failed to generate a session token, client %u can't resume", client_info.id);
+            resumable = false;
+            session_token.clear();
+        }
+    }
+    resuming = resuming && !multicast;
+    uint8_t stream_flags = (multiplexed ? STREAM_FLAG_MUX : 0) | (ecn ? STREAM_FLAG_ECN : 0) |
+                           (multicast ? STREAM_FLAG_MULTICAST : 0) |
+                           (compact_input ? STREAM_FLAG_COMPACT_INPUT : 0) |
+                           (udp_input ? STREAM_FLAG_UDP_INPUT : 0) |
+                           (clock_sync ? STREAM_FLAG_CLOCK_SYNC : 0) |
+                           (resumable ? STREAM_FLAG_RESUME : 0) |
+                           (resuming ? STREAM_FLAG_RESUMED : 0);
+    if (primary) {
+        // Before the config goes out: the client sends input right after
+        m_input_receiver->set_wire_format(compact_input ? InputWireFormat::COMPACT
+                                                        : InputWireFormat::LEGACY);
+        if (udp_input) {
+            m_input_receiver->set_udp_peer(client_info.host);
+        }
+    }
+
+    // Send configuration to client (with audio and codec info).
+    // Only the primary client gets audio.
+    uint8_t codec_type = m_encoder->get_encoder(0).get_codec_type();
+#ifdef HAVE_OPUS
+    int audio_port = (m_audio_initialized && primary) ? m_config.audio_port : 0;
+#else
+    int audio_port = 0;
+#endif
+    m_control->send_config_full(client_info.id, m_capture->get_width(), m_capture->get_height(),
+                                m_config.video_port, m_config.input_port,
+                                audio_port, m_config.audio_sample_rate,
+                                m_config.audio_channels, m_config.audio_frame_ms,
+                                codec_type, stream_flags,
+                                m_config.multicast_group, m_config.multicast_port, session_token);
+
+    // Add video subscriber with pacing mode
+    SubscriberOptions options;
+    options.pacing = static_cast<PacingMode>(m_config.pacing_mode);
+    options.multiplexed = multiplexed;
+    options.ecn = ecn;
+
+    // Simulcast: never send more pixels than the tablet can show
+    RungAssignment assignment;
+    for (size_t i = 1; i < m_encoder->get_rung_count(); i++) {
+        const VAAPIEncoder& encoder = m_encoder->get_encoder(i);
+        if (multicast || encoder.get_width() < client_info.width ||
+            encoder.get_height() < client_info.height) {
+            break;
+        }
+        assignment.top = static_cast<int>(i);
+    }
+    assignment.rung = assignment.top;
+    if (resuming) {
+        // Back on the rung its estimate had settled on
+        assignment.rung = std::clamp(resumed.assignment.rung, assignment.top,
+                                     static_cast<int>(m_encoder->get_rung_count()) - 1);
+    }
+    options.rung = assignment.rung;
+    m_video_sender->set_ce_impairment(m_config.ecn_impair_ce);
+
+    uint32_t subscriber_id = 0;
+    if (multicast) {
+        // All multicast clients share one subscriber
+        m_video_sender->set_fec_group(m_config.fec_group);
+        if (!m_multicast_subscriber) {
+            m_multicast_subscriber = m_video_sender->add_multicast_subscriber(
+                m_config.multicast_group, m_config.multicast_port, m_config.multicast_ttl, options);
+            // Driven by the worst receiver's reports (see VideoSender), so
+            // the group counts in combined_target_bitrate() like any client
+            if (m_multicast_subscriber) {
+                RateController& rate = m_rate_controllers[m_multicast_subscriber];
+                rate.init(m_config.bitrate, m_config.bitrate / 10, m_config.bitrate);
+                rate.set_ecn_enabled(ecn);
+            }
+        }
+        subscriber_id = m_multicast_subscriber;
+        m_rung_assignments[subscriber_id] = RungAssignment{};
+    } else {
+        subscriber_id = m_video_sender->add_subscriber(client_info.host, client_info.video_port, options);
+        // Fresh rate estimate per subscriber, starting from the configured
+        // rate, unless the client resumes with the one it had
+        RateController& rate = m_rate_controllers[subscriber_id];
+        if (resuming) {
+            rate = resumed.rate;
+        } else {
+            rate.init(m_config.bitrate, m_config.bitrate / 10, m_config.bitrate);
+        }
+        rate.set_ecn_enabled(ecn);
+        m_rung_assignments[subscriber_id] = assignment;
+        if (m_encoder->get_rung_count() > 1) {
+            LOG_INFO("Client %u (%dx%d) starts on simulcast rung %d", client_info.id,
+                     client_info.width, client_info.height, assignment.rung);
+            update_active_rungs();
+        }
+    }
+    if (multiplexed) {
+        LOG_INFO("Multiplexed UDP: video, audio and feedback on port %d", m_config.video_port);
+    }
+    m_client_subscribers[client_info.id] = subscriber_id;
+
+    if (resuming) {
+        // Something to show right away; the subscriber still waits for the
+        // live keyframe its join requested before it gets deltas
+        size_t cached_bytes = 0;
+        auto cached = m_keyframe_cache.find(assignment.rung);
+        if (cached != m_keyframe_cache.end()) {
+            const EncodedFrame& frame = cached->second;
+            m_video_sender->send_frame(frame.data.data(), frame.data.size(), m_frame_count++, true,
+                                       frame.timestamp_us, assignment.rung, subscriber_id);
+            cached_bytes = frame.data.size();
+        }
+        LOG_INFO("Client %u resumed its session: %.1f Mbps estimate, rung %d, cached keyframe %zu bytes",
+                 client_info.id, m_rate_controllers[subscriber_id].get_target_bitrate() / 1e6,
+                 assignment.rung, cached_bytes);
+    }
+
+    if (!primary) {
+        LOG_INFO("Client %u (%s) joined as viewer: %zu clients, %zu video subscribers",
+                 client_info.id, client_info.host.c_str(), m_control->get_client_count(),
+                 m_video_sender->get_subscriber_count());
+        return;
+    }
+
+#ifdef HAVE_OPUS
+    // Set audio destination and start audio capture
+    if (m_audio_initialized && m_audio_sender && m_audio_capture) {
+        if (multiplexed) {
+            // Audio goes to the client's video socket, demuxed by stream id
+            m_audio_sender->set_shared_socket(m_video_sender->get_socket());
+            m_audio_sender->set_client(client_info.host, client_info.video_port);
+        } else {
+            m_audio_sender->set_shared_socket(-1);
+            m_audio_sender->set_client(client_info.host, m_config.audio_port);
+        }
+        m_audio_sequence = 0;
+        m_audio_capture->start([this](const AudioFrame& frame) {
+            on_audio_frame(frame);
+        });
+        LOG_INFO("Audio capture started for client");
+    }
+#endif
+
+    // Initialize coordinate transform
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    m_coord_transform.init(m_capture->get_width(), m_capture->get_height(),
+                           client_info.width, client_info.height,
+                           CoordTransform::Mode::LETTERBOX, false);
+}
+
+void Server::on_client_disconnected(uint32_t client_id) {
+    auto it = m_client_subscribers.find(client_id);
+    if (it != m_client_subscribers.end()) {
+        uint32_t subscriber_id = it->second;
+        m_client_subscribers.erase(it);
+
+        // The multicast subscriber stays while any multicast client remains
+        bool shared = false;
+        for (const auto& entry : m_client_subscribers) {
+            if (entry.second == subscriber_id) shared = true;
+        }
+        if (!shared) {
+            park_session(client_id, subscriber_id);
+            m_video_sender->remove_subscriber(subscriber_id);
+            m_rate_controllers.erase(subscriber_id);
+            m_rung_assignments.erase(subscriber_id);
+            if (subscriber_id == m_multicast_subscriber) {
+                m_multicast_subscriber = 0;
+            }
+        }
+    }
+
+    m_session_tokens.erase(client_id);
+
+    if (client_id == m_primary_client) {
+        m_primary_client = 0;
+#ifdef HAVE_OPUS
+        // Audio follows the primary client only
+        if (m_audio_capture && m_audio_capture->is_capturing()) {
+            m_audio_capture->stop();
+            LOG_INFO("Audio capture stopped");
+        }
+#endif
+        // Whoever takes over input starts with nothing held down
+        release_input();
+    }
+
+    if (m_control->get_client_count() > 0) {
+        LOG_INFO("Client %u left, %zu clients remaining", client_id, m_control->get_client_count());
+        if (m_encoder->get_rung_count() > 1) {
+            update_active_rungs();
+        } else if (!m_rate_controllers.empty()) {
+            apply_target_bitrate(combined_target_bitrate());
+        }
+    }
+}
+
+void Server::park_session(uint32_t client_id, uint32_t subscriber_id) {
+    auto token = m_session_tokens.find(client_id);
+    auto rate = m_rate_controllers.find(subscriber_id);
+    auto assignment = m_rung_assignments.find(subscriber_id);
+    if (m_config.resume_grace_ms <= 0 || token == m_session_tokens.end() ||
+        rate == m_rate_controllers.end() || assignment == m_rung_assignments.end()) {
+        return;
+    }
+
+    ParkedSession parked;
+    parked.token = token->second;
+    parked.primary = (client_id == m_primary_client);
+    parked.rate = rate->second;
+    parked.assignment = assignment->second;
+    parked.expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_config.resume_grace_ms);
+    m_parked_sessions.push_back(std::move(parked));
+    LOG_INFO("Client %u dropped, keeping its session for %d ms", client_id, m_config.resume_grace_ms);
+}
+
+void Server::expire_parked_sessions() {
+    if (m_parked_sessions.empty()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = m_parked_sessions.begin(); it != m_parked_sessions.end();) {
+        if (now >= it->expires) {
+            LOG_INFO("Parked session expired (%zu left)", m_parked_sessions.size() - 1);
+            it = m_parked_sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Server::release_input() {
+    // Drop the input connection first so nothing presses a button again
+    // after the reset
+    m_input_receiver->reset();
+
+    // Release all pressed buttons/tools
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    m_pending_input.clear();
+    m_input_pacer.reset();
+    m_stylus_predictor.reset();
+    m_stylus_predicted = false;
+    m_input_latency.reset_clock();
+    if (m_uinput && m_uinput->is_initialized()) {
+        m_uinput->reset_all();
+    }
+}
+
+bool Server::update_suspended() {
+    // Nobody is watching when every client has paused, gone silent
+    // (heartbeats) or away (parked sessions). Returns true on resume.
+    bool suspend = !m_control->has_active_client();
+    if (suspend == m_suspended) {
+        return false;
+    }
+    m_suspended = suspend;
+
+    if (suspend) {
+        LOG_INFO("No client watching, suspending capture and encode");
+        m_capture->set_active(false);
+        park_audio(true);
+        return false;
+    }
+
+    LOG_INFO("Client watching again, resuming capture and encode");
+    m_capture->set_active(true);
+    if (!m_control->is_client_paused(m_primary_client)) {
+        park_audio(false);
+    }
+    m_encoder->request_keyframe_all();
+    return true;
+}
+
+void Server::on_client_paused(uint32_t client_id, bool paused) {
+    // Multicast clients share a subscriber, which keeps going for the others
+    auto it = m_client_subscribers.find(client_id);
+    if (it != m_client_subscribers.end() && it->second != m_multicast_subscriber) {
+        m_video_sender->set_subscriber_paused(it->second, paused);
+    }
+    // Audio plays on the primary client only
+    if (client_id == m_primary_client && (paused || !m_suspended)) {
+        park_audio(paused);
+    }
+}
+
+void Server::park_audio(bool park) {
+#ifdef HAVE_OPUS
+    if (!m_audio_capture) {
+        return;
+    }
+    if (park) {
+        if (m_audio_capture->is_capturing()) {
+            m_audio_capture->stop();
+            m_audio_parked = true;
+            LOG_INFO("Audio capture stopped");
+        }
+        return;
+    }
+    if (m_audio_parked && m_primary_client != 0 && !m_audio_capture->is_capturing()) {
+        m_audio_capture->start([this](const AudioFrame& frame) {
+            on_audio_frame(frame);
+        });
+        LOG_INFO("Audio capture started for client");
+    }
+    m_audio_parked = false;
+#else
+    (void)park;
+#endif
+}
+
+void Server::request_shared_keyframe(const char* reason, uint32_t rungs) {
+    // Every subscriber gets the IDR, so don't let clients trigger a burst of them
+    auto now = std::chrono::steady_clock::now();
+    if (m_control->get_client_count() > 1 &&
+        now - m_last_keyframe_request < std::chrono::milliseconds(500)) {
+        return;
+    }
+    m_last_keyframe_request = now;
+    LOG_DEBUG("Requesting keyframe: %s", reason);
+    for (size_t i = 0; i < m_encoder->get_rung_count() && i < 32; i++) {
+        if (rungs & (1u << i)) {
+            m_encoder->request_keyframe(i);
+        }
+    }
+}
+
+int Server::combined_target_bitrate() const {
+    // One encode for everyone: follow the most constrained subscriber
+    int target = m_config.bitrate;
+    for (const auto& entry : m_rate_controllers) {
+        target = std::min(target, entry.second.get_target_bitrate());
+    }
+    return target;
+}
+
+void Server::handle_feedback(uint32_t subscriber_id, const uint8_t* data, size_t size) {
+    FeedbackPacketHeader header;
+    if (size < sizeof(header)) {
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != FEEDBACK_MAGIC || sizeof(header) + header.payload_len > size) {
+        return;
+    }
+    const uint8_t* payload = data + sizeof(header);
+
+    switch (header.type) {
+        case FEEDBACK_RECEIVER_REPORT: {
+            if (header.payload_len < sizeof(ReceiverReport)) {
+                return;
+            }
+            ReceiverReport report;
+            memcpy(&report, payload, sizeof(report));
+            auto it = m_rate_controllers.find(subscriber_id);
+            if (it != m_rate_controllers.end() && it->second.on_receiver_report(report)) {
+                if (m_encoder->get_rung_count() > 1) {
+                    select_rung(subscriber_id);
+                } else {
+                    apply_target_bitrate(combined_target_bitrate());
+                }
+            }
+            break;
+        }
+
+        case FEEDBACK_KEYFRAME_REQUEST: {
+            // Multicast receivers joining at once would otherwise trigger an IDR each
+            auto now = std::chrono::steady_clock::now();
+            if (now - m_last_keyframe_request >= std::chrono::milliseconds(500)) {
+                m_last_keyframe_request = now;
+                LOG_INFO("Keyframe requested by receiver");
+                int rung = std::max(0, m_video_sender->get_subscriber_rung(subscriber_id));
+                m_encoder->request_keyframe(rung);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void Server::apply_target_bitrate(int bitrate) {
+    if (bitrate <= 0) {
+        return;
+    }
+
+    VAAPIEncoder& encoder = m_encoder->get_encoder(0);
+    QualityMode mode = encoder.get_quality_mode();
+    if (mode == QualityMode::AUTO || mode == QualityMode::HIGH_QUALITY) {
+        // CQP has no bitrate knob: ~6 QP steps halve the bitrate
+        double ratio = static_cast<double>(m_config.bitrate) / bitrate;
+        int qp = m_config.cqp + static_cast<int>(std::lround(6.0 * std::log2(ratio)));
+        encoder.set_qp(qp);
+    } else {
+        // Each change costs a codec reopen at the next IDR, so ignore small steps
+        int current = encoder.get_bitrate();
+        if (std::abs(bitrate - current) * 10 >= current) {
+            encoder.set_bitrate(bitrate);
+        }
+    }
+}
+
+bool Server::skip_frame_for_backoff() {
+    // A decrease reaches the encoder at its next keyframe; until then every
+    // frame still gets the old bit budget, so send fewer of them
+    if (m_encoder->get_rung_count() != 1) {
+        m_backoff_credit = 0.0;
+        return false;
+    }
+    double scale = m_encoder->get_encoder(0).get_pending_rate_scale();
+    if (scale >= 1.0) {
+        m_backoff_credit = 0.0;
+        return false;
+    }
+    m_backoff_credit += scale;
+    if (m_backoff_credit >= 1.0) {
+        m_backoff_credit -= 1.0;
+        return false;
+    }
+    m_encoder->get_encoder(0).skip_frame();
+    m_backoff_skipped++;
+    return true;
+}
+
+void Server::select_rung(uint32_t subscriber_id) {
+    auto rate = m_rate_controllers.find(subscriber_id);
+    auto assignment = m_rung_assignments.find(subscriber_id);
+    if (rate == m_rate_controllers.end() || assignment == m_rung_assignments.end()) {
+        return;
+    }
+
+    // Best rung the estimate sustains; moving up needs 15% headroom so a
+    // client on the edge doesn't bounce between rungs (each switch is an IDR)
+    int target = rate->second.get_target_bitrate();
+    int current = assignment->second.rung;
+    int last = static_cast<int>(m_encoder->get_rung_count()) - 1;
+    int rung = last;
+    for (int i = assignment->second.top; i <= last; i++) {
+        int needed = m_encoder->get_rung_bitrate(i);
+        if (i < current) {
+            needed += needed * 15 / 100;
+        }
+        if (needed <= target) {
+            rung = i;
+            break;
+        }
+    }
+
+    if (rung != current) {
+        assignment->second.rung = rung;
+        m_video_sender->set_subscriber_rung(subscriber_id, rung);
+        update_active_rungs();
+    }
+}
+
+void Server::update_active_rungs() {
+    // A rung is needed while anyone receives it or is switching to it
+    std::vector<bool> needed(m_encoder->get_rung_count(), false);
+    for (const auto& entry : m_rung_assignments) {
+        int current = m_video_sender->get_subscriber_rung(entry.first);
+        if (current >= 0 && static_cast<size_t>(current) < needed.size()) {
+            needed[current] = true;
+        }
+        if (static_cast<size_t>(entry.second.rung) < needed.size()) {
+            needed[entry.second.rung] = true;
+        }
+    }
+    for (size_t i = 0; i < needed.size(); i++) {
+        m_encoder->set_active(i, needed[i]);
+    }
+}
+
+EncoderConfig Server::make_encoder_config() const {
+    EncoderConfig enc_config;
+    enc_config.width = m_capture->get_width();
+    enc_config.height = m_capture->get_height();
+    enc_config.framerate = m_config.capture_fps;
+    enc_config.bitrate = m_config.bitrate;
+    enc_config.gop_size = m_config.gop_size;
+    enc_config.low_latency = (m_config.quality_mode != QualityMode::HIGH_QUALITY &&
+                               m_config.quality_mode != QualityMode::AUTO);
+    enc_config.quality_mode = m_config.quality_mode;
+    enc_config.codec_type = m_config.codec_type;
+    enc_config.cqp = m_config.cqp;
+    enc_config.qp_min = m_config.qp_min;
+    enc_config.qp_max = m_config.qp_max;
+    return enc_config;
+}
+
+uint8_t Server::set_param(uint8_t param, int32_t& value) {
+    // Each change takes the cheapest path that works: pacing only touches
+    // the sender, rate/QP/fps are retuned by the encoders at their next
+    // keyframe, and only a new resolution rebuilds them
+    switch (param) {
+        case PARAM_FPS: {
+            int fps = std::clamp(value, 1, 120);
+            if (fps != m_config.capture_fps) {
+                // Keyframe interval keeps its length in time (as the encoders do)
+                m_config.gop_size = std::max(1, m_config.gop_size * fps / m_config.capture_fps);
+                m_config.capture_fps = fps;
+                m_encoder->set_framerate(fps);
+                LOG_INFO("Capture rate set to %d fps", fps);
+            }
+            value = fps;
+            return PARAM_OK;
+        }
+
+        case PARAM_BITRATE: {
+            int bitrate = std::clamp(value, 100000, 500000000);
+            if (bitrate != m_config.bitrate) {
+                m_config.bitrate = bitrate;
+                if (!m_config.simulcast_rungs.empty()) {
+                    m_config.simulcast_rungs[0].bitrate = bitrate;
+                }
+                // New ceiling for every rate estimate; the full-size encode
+                // follows the most constrained one as before
+                for (auto& entry : m_rate_controllers) {
+                    entry.second.set_max_bitrate(bitrate);
+                }
+                m_encoder->set_rung_bitrate(0, bitrate);
+                if (m_encoder->get_rung_count() == 1) {
+                    apply_target_bitrate(combined_target_bitrate());
+                }
+                LOG_INFO("Bitrate set to %.2f Mbps", bitrate / 1e6);
+            }
+            value = bitrate;
+            return PARAM_OK;
+        }
+
+        case PARAM_QP: {
+            if (m_config.quality_mode != QualityMode::AUTO &&
+                m_config.quality_mode != QualityMode::HIGH_QUALITY) {
+                value = m_config.cqp;
+                return PARAM_REJECTED;  // Bitrate-controlled modes have no QP
+            }
+            int qp = std::clamp(value, m_config.qp_min, m_config.qp_max);
+            if (qp != m_config.cqp) {
+                m_config.cqp = qp;
+                if (m_encoder->get_rung_count() == 1) {
+                    apply_target_bitrate(combined_target_bitrate());
+                } else {
+                    m_encoder->get_encoder(0).set_qp(qp);
+                }
+                LOG_INFO("CQP level set to %d", qp);
+            }
+            value = qp;
+            return PARAM_OK;
+        }
+
+        case PARAM_PACING: {
+            int mode = std::clamp(value, 0, static_cast<int>(PacingMode::KEYFRAME));
+            if (mode != m_config.pacing_mode) {
+                m_config.pacing_mode = mode;
+                m_video_sender->set_pacing_mode(static_cast<PacingMode>(mode));
+            }
+            value = mode;
+            return PARAM_OK;
+        }
+
+        case PARAM_RESOLUTION: {
+            int capture_width = m_capture->get_width();
+            int capture_height = m_capture->get_height();
+            int width = (value >> 16) & 0xFFFF;
+            int height = value & 0xFFFF;
+            float scale = 1.0f;
+            if (width > 0 && height > 0) {
+                // Fit inside the requested size, keeping the aspect ratio
+                scale = std::min(static_cast<float>(width) / capture_width,
+                                 static_cast<float>(height) / capture_height);
+                scale = std::clamp(scale, 0.1f, 1.0f);
+            }
+            uint8_t status = PARAM_OK;
+            if (std::abs(scale - m_output_scale) > 0.001f && !rebuild_encoder(scale)) {
+                status = PARAM_REJECTED;
+            }
+            const VAAPIEncoder& top = m_encoder->get_encoder(0);
+            value = (top.get_width() << 16) | top.get_height();
+            return status;
+        }
+
+        default:
+            value = 0;
+            return PARAM_UNKNOWN;
+    }
+}
+
+bool Server::rebuild_encoder(float output_scale) {
+    // Build the new encoders next to the running ones, so a failure leaves
+    // the stream as it was
+    auto encoder = std::make_unique<SimulcastEncoder>();
+    if (!encoder->init(make_encoder_config(), m_config.simulcast_rungs, output_scale)) {
+        LOG_ERROR("Failed to rebuild the encoder at scale %.2f, keeping the current one", output_scale);
+        return false;
+    }
+
+    // Same ladder, so rung assignments and subscriber rungs stay valid; the
+    // first frame of each new encoder is a keyframe at the new size
+    for (size_t i = 0; i < encoder->get_rung_count(); i++) {
+        encoder->set_active(i, m_encoder->is_active(i));
+    }
+    m_encoder = std::move(encoder);
+    m_encoder->request_keyframe_all();
+    m_keyframe_cache.clear();
+    m_output_scale = output_scale;
+    if (m_encoder->get_rung_count() == 1 && !m_rate_controllers.empty()) {
+        apply_target_bitrate(combined_target_bitrate());
+    }
+    return true;
+}
+
+// printf into an admin reply
+static void appendf(std::string& out, const char* fmt, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    out += line;
+}
+
+static const char* const ADMIN_SETTINGS[] = {
+    "fps", "bitrate", "qp", "qp-min", "qp-max", "pacing", "pace-input", "log-level"
+};
+static const char* const PACING_NAMES[] = {"auto", "none", "light", "aggressive", "keyframe"};
+static const char* const LOG_LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+
+// Whole decimal number, with an optional k/M suffix when 'suffix' is set
+static bool parse_admin_int(const std::string& text, int& out, bool suffix = false) {
+    char* end = nullptr;
+    errno = 0;
+    double value = strtod(text.c_str(), &end);
+    if (suffix && (*end == 'k' || *end == 'K')) {
+        value *= 1e3;
+        end++;
+    } else if (suffix && (*end == 'm' || *end == 'M')) {
+        value *= 1e6;
+        end++;
+    }
+    if (text.empty() || *end != '\0' || errno != 0 || value < -2e9 || value > 2e9) {
+        return false;
+    }
+    out = static_cast<int>(std::lround(value));
+    return true;
+}
+
+// Index of 'text' in a name table, also accepting the index itself (-1 = neither)
+static int parse_admin_choice(const std::string& text, const char* const* names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (text == names[i]) {
+            return i;
+        }
+    }
+    int index = -1;
+    return parse_admin_int(text, index) && index >= 0 && index < count ? index : -1;
+}
+
+bool Server::handle_admin(const std::vector<std::string>& args, std::string& reply, std::string& error) {
+    const std::string& command = args[0];
+    if (command == "help") {
+        reply += "stats                 stage timings, queue depths, bitrate and loss\n";
+        reply += "get [NAME]            current value of one or all settings\n";
+        reply += "set NAME VALUE        change a setting (fps, bitrate, qp, qp-min, qp-max,\n";
+        reply += "                      pacing, pace-input, log-level)\n";
+        reply += "keyframe              send every client a keyframe\n";
+        return true;
+    }
+    if (command == "stats" && args.size() == 1) {
+        admin_stats(reply);
+        return true;
+    }
+    if (command == "get" && args.size() <= 2) {
+        return admin_get(args.size() == 2 ? args[1] : "", reply, error);
+    }
+    if (command == "set" && args.size() == 3) {
+        return admin_set(args[1], args[2], reply, error);
+    }
+    if (command == "keyframe" && args.size() == 1) {
+        request_shared_keyframe("admin request");
+        return true;
+    }
+    bool known = command == "stats" || command == "get" || command == "set" || command == "keyframe";
+    error = (known ? "wrong arguments for " : "unknown command ") + command + " (see help)";
+    return false;
+}
+
+void Server::admin_stats(std::string& reply) {
+    bool connected = m_control->is_client_connected() || !m_parked_sessions.empty();
+    appendf(reply, "state=%s clients=%zu parked=%zu primary=%u frames=%u fps=%d\n",
+            !connected ? "waiting" : (m_suspended ? "suspended" : "streaming"),
+            m_control->get_client_count(), m_parked_sessions.size(), m_primary_client,
+            m_frame_count, m_config.capture_fps);
+
+    // Averages over the last stats window (as logged with -v)
+    const StageStats& stage = m_stage_stats;
+    appendf(reply, "timing window_s=%.1f frames=%d capture_ms=%.2f encode_ms=%.2f send_ms=%.2f "
+            "capture_fails=%d encode_fails=%d\n",
+            stage.window_s, stage.frames, stage.capture_ms, stage.encode_ms, stage.send_ms,
+            stage.capture_fails, stage.encode_fails);
+
+    for (size_t i = 0; i < m_encoder->get_rung_count(); i++) {
+        const VAAPIEncoder& encoder = m_encoder->get_encoder(i);
+        appendf(reply, "rung=%zu size=%dx%d active=%d bitrate=%d qp=%d\n",
+                i, encoder.get_width(), encoder.get_height(), m_encoder->is_active(i) ? 1 : 0,
+                encoder.get_bitrate(), encoder.get_qp());
+    }
+
+    for (const auto& entry : m_client_subscribers) {
+        appendf(reply, "client=%u subscriber=%u paused=%d",
+                entry.first, entry.second, m_control->is_client_paused(entry.first) ? 1 : 0);
+        auto rate = m_rate_controllers.find(entry.second);
+        if (rate != m_rate_controllers.end()) {
+            appendf(reply, " target_bps=%d loss_pct=%.2f ce_alpha=%.3f",
+                    rate->second.get_target_bitrate(), rate->second.get_loss_fraction() * 100.0,
+                    rate->second.get_ce_alpha());
+        }
+        const ClockSync* clock = m_control->get_clock_sync(entry.first);
+        if (clock && clock->is_synced()) {
+            appendf(reply, " min_rtt_ms=%.2f", clock->get_min_rtt_us() / 1000.0);
+        }
+        reply += "\n";
+    }
+    for (const SubscriberStats& sub : m_video_sender->get_subscriber_stats()) {
+        appendf(reply, "subscriber=%u host=%s rung=%d frames=%lu skipped=%lu bytes=%lu packets=%lu "
+                "retransmits=%lu unrecoverable=%lu waiting_keyframe=%d\n",
+                sub.id, sub.host.c_str(), sub.rung, sub.frames_sent, sub.frames_skipped, sub.bytes_sent,
+                sub.packets_sent, sub.retransmits, sub.nacks_unrecoverable, sub.waiting_for_keyframe ? 1 : 0);
+    }
+
+    // Queue depths: held input (the input thread owns it) and egress classes
+    {
+        std::lock_guard<std::mutex> lock(m_input_mutex);
+        appendf(reply, "queue input_paced=%zu input_coalesced=%zu",
+                m_input_pacer.size(), m_pending_input.size());
+    }
+    if (m_egress && m_egress->is_running()) {
+        for (size_t i = 0; i < TRAFFIC_CLASS_COUNT; i++) {
+            TrafficClass cls = static_cast<TrafficClass>(i);
+            EgressClassStats egress = m_egress->get_stats(cls);
+            appendf(reply, " egress_%s=%zu", EgressScheduler::class_name(cls), egress.queue_depth);
+        }
+    }
+    reply += "\n";
+    uint64_t input_events = m_input_receiver->get_events_received();
+    uint64_t recv_calls = m_input_receiver->get_recv_calls();
+    appendf(reply, "input events=%lu recv_calls=%lu recv_per_event=%.2f "
+            "udp_lost=%lu udp_duplicates=%lu udp_rejected=%lu\n",
+            input_events, recv_calls, input_events ? static_cast<double>(recv_calls) / input_events : 0.0,
+            m_input_receiver->get_udp_lost(), m_input_receiver->get_udp_duplicates(),
+            m_input_receiver->get_udp_rejected());
+    // Last ~5-10 s; the periodic log's intervals are left intact
+    for (const InputLatencyStats& lat : m_input_latency.get_recent_stats()) {
+        appendf(reply, "input_latency type=%s n=%lu clock=%s net_p50_ms=%.1f net_p99_ms=%.1f "
+                "queue_p50_ms=%.2f queue_p99_ms=%.2f write_p50_ms=%.2f write_p99_ms=%.2f "
+                "total_p50_ms=%.2f total_p99_ms=%.2f total_max_ms=%.2f\n",
+                InputLatency::type_name(lat.type), lat.total.count, lat.clock_synced ? "synced" : "relative",
+                lat.network.percentile(50) / 1000.0, lat.network.percentile(99) / 1000.0,
+                lat.queue.percentile(50) / 1000.0, lat.queue.percentile(99) / 1000.0,
+                lat.write.percentile(50) / 1000.0, lat.write.percentile(99) / 1000.0,
+                lat.total.percentile(50) / 1000.0, lat.total.percentile(99) / 1000.0,
+                lat.total.max_us / 1000.0);
+    }
+    if (m_control->is_tls()) {
+        TlsStats tls = m_control->get_tls_stats();
+        appendf(reply, "tls full=%lu resumed=%lu early_accepted=%lu early_rejected=%lu failed=%lu "
+                "full_p50_ms=%.2f resumed_p50_ms=%.2f cpu_p50_ms=%.2f\n",
+                tls.full, tls.resumed, tls.early_accepted, tls.early_rejected, tls.failed,
+                tls.full_us.percentile(50) / 1000.0, tls.resumed_us.percentile(50) / 1000.0,
+                tls.cpu_us.percentile(50) / 1000.0);
+    }
+}
+
+bool Server::admin_get(const std::string& name, std::string& reply, std::string& error) {
+    bool found = false;
+    for (const char* setting : ADMIN_SETTINGS) {
+        if (!name.empty() && name != setting) {
+            continue;
+        }
+        found = true;
+        std::string key = setting;
+        if (key == "fps") {
+            appendf(reply, "fps=%d\n", m_config.capture_fps);
+        } else if (key == "bitrate") {
+            appendf(reply, "bitrate=%d\n", m_config.bitrate);
+        } else if (key == "qp") {
+            appendf(reply, "qp=%d\n", m_config.cqp);
+        } else if (key == "qp-min") {
+            appendf(reply, "qp-min=%d\n", m_config.qp_min);
+        } else if (key == "qp-max") {
+            appendf(reply, "qp-max=%d\n", m_config.qp_max);
+        } else if (key == "pacing") {
+            appendf(reply, "pacing=%s\n", PACING_NAMES[std::clamp(m_config.pacing_mode, 0, 4)]);
+        } else if (key == "pace-input") {
+            std::lock_guard<std::mutex> lock(m_input_mutex);
+            appendf(reply, "pace-input=%d\n", m_config.input_pace_us);
+        } else if (key == "log-level") {
+            appendf(reply, "log-level=%s\n", LOG_LEVEL_NAMES[static_cast<int>(Logger::get_level())]);
+        }
+    }
+    if (!found) {
+        error = "unknown setting " + name;
+    }
+    return found;
+}
+
+bool Server::admin_set(const std::string& name, const std::string& value, std::string& reply, std::string& error) {
+    int number = 0;
+    if (name == "fps" || name == "bitrate" || name == "qp") {
+        // The same path (and limits) as MSG_SET_PARAM from the primary client
+        if (!parse_admin_int(value, number, name == "bitrate")) {
+            error = "not a number: " + value;
+            return false;
+        }
+        uint8_t param = name == "fps" ? PARAM_FPS : (name == "bitrate" ? PARAM_BITRATE : PARAM_QP);
+        int32_t applied = number;
+        if (set_param(param, applied) != PARAM_OK) {
+            error = "qp only applies in the auto and high quality modes (see qp-min/qp-max)";
+            return false;
+        }
+    } else if (name == "qp-min" || name == "qp-max") {
+        if (!parse_admin_int(value, number) || number < 1 || number > 51) {
+            error = "QP bound must be 1-51";
+            return false;
+        }
+        int qp_min = name == "qp-min" ? number : m_config.qp_min;
+        int qp_max = name == "qp-max" ? number : m_config.qp_max;
+        if (qp_min > qp_max) {
+            error = "qp-min must not be above qp-max";
+            return false;
+        }
+        m_config.qp_min = qp_min;
+        m_config.qp_max = qp_max;
+        m_config.cqp = std::clamp(m_config.cqp, qp_min, qp_max);
+        m_encoder->set_qp_range(qp_min, qp_max);
+        if (m_encoder->get_rung_count() == 1 && !m_rate_controllers.empty()) {
+            apply_target_bitrate(combined_target_bitrate());
+        }
+        LOG_INFO("QP range set to %d-%d", qp_min, qp_max);
+    } else if (name == "pacing") {
+        int32_t mode = parse_admin_choice(value, PACING_NAMES, 5);
+        if (mode < 0) {
+            error = "pacing is one of auto, none, light, aggressive, keyframe";
+            return false;
+        }
+        set_param(PARAM_PACING, mode);
+    } else if (name == "pace-input") {
+        if (!parse_admin_int(value, number) || number < 0 || number > 50000) {
+            error = "pace-input is 0-50000 microseconds";
+            return false;
+        }
+        // The input path is only set up for pacing when started with it
+        std::lock_guard<std::mutex> lock(m_input_mutex);
+        if (m_config.input_pace_us < 0) {
+            error = "input pacing is off (start with --pace-input)";
+            return false;
+        }
+        m_config.input_pace_us = number;
+        m_input_pacer.set_max_delay_us(number);
+    } else if (name == "log-level") {
+        int level = parse_admin_choice(value, LOG_LEVEL_NAMES, 4);
+        if (level < 0) {
+            error = "log-level is one of debug, info, warn, error";
+            return false;
+        }
+        Logger::set_level(static_cast<LogLevel>(level));
+    } else {
+        error = "unknown setting " + name;
+        return false;
+    }
+    return admin_get(name, reply, error);
 }
 
 void Server::stop() {
@@ -479,6 +1830,10 @@ bool Server::init_audio() {
         return false;
     }
 
+    if (m_egress) {
+        m_audio_sender->set_scheduler(m_egress.get());
+    }
+
     m_audio_initialized = true;
     LOG_INFO("Audio initialized: %s backend, %dHz, %d channels, %dkbps",
              m_audio_capture->get_name(),
@@ -3,14 +3,26 @@
 #include <memory>
 #include <atomic>
 #include <mutex>
+#include <map>
+#include <chrono>
+#include <condition_variable>
+#include <string>
+#include <vector>
 #include "stream_tablet/config.hpp"
 #include "capture/capture_backend.hpp"
-#include "encoder/vaapi_encoder.hpp"
+#include "encoder/simulcast_encoder.hpp"
 #include "network/control_server.hpp"
 #include "network/video_sender.hpp"
 #include "network/input_receiver.hpp"
+#include "network/egress_scheduler.hpp"
+#include "network/rate_controller.hpp"
+#include "network/admin_server.hpp"
 #include "input/uinput_backend.hpp"
 #include "input/coord_transform.hpp"
+#include "input/stylus_predictor.hpp"
+#include "input/input_latency.hpp"
+#include "input/input_recorder.hpp"
+#include "input/input_pacer.hpp"
 
 #ifdef HAVE_OPUS
 #include "audio/audio_backend.hpp"
@@ -47,7 +59,34 @@ public:
 private:
     bool create_capture_backend(const char* display);
     void capture_and_encode_loop();
+    bool skip_frame_for_backoff();
     void handle_input(const InputEvent& event);
+    void dispatch_input(const InputEvent& event);
+    void flush_coalesced_input(bool force);
+    void release_paced_input();
+    void idle_wait(std::chrono::microseconds timeout);
+    void snap_back_stylus();
+    void start_client(const ClientInfo& client_info);
+    void on_client_disconnected(uint32_t client_id);
+    void park_session(uint32_t client_id, uint32_t subscriber_id);
+    void expire_parked_sessions();
+    void release_input();
+    bool update_suspended();
+    void on_client_paused(uint32_t client_id, bool paused);
+    void park_audio(bool park);
+    void request_shared_keyframe(const char* reason, uint32_t rungs = ~0u);
+    void handle_feedback(uint32_t subscriber_id, const uint8_t* data, size_t size);
+    int combined_target_bitrate() const;
+    void apply_target_bitrate(int bitrate);
+    void select_rung(uint32_t subscriber_id);
+    void update_active_rungs();
+    EncoderConfig make_encoder_config() const;
+    uint8_t set_param(uint8_t param, int32_t& value);
+    bool rebuild_encoder(float output_scale);
+    bool handle_admin(const std::vector<std::string>& args, std::string& reply, std::string& error);
+    void admin_stats(std::string& reply);
+    bool admin_get(const std::string& name, std::string& reply, std::string& error);
+    bool admin_set(const std::string& name, const std::string& value, std::string& reply, std::string& error);
 
 #ifdef HAVE_OPUS
     bool init_audio();
@@ -58,14 +97,98 @@ private:
     CaptureBackendType m_backend_type = CaptureBackendType::AUTO;
 
     std::unique_ptr<CaptureBackend> m_capture;
-    std::unique_ptr<VAAPIEncoder> m_encoder;
+    std::unique_ptr<SimulcastEncoder> m_encoder;
     std::unique_ptr<ControlServer> m_control;
     std::unique_ptr<VideoSender> m_video_sender;
     std::unique_ptr<InputReceiver> m_input_receiver;
     std::unique_ptr<UInputBackend> m_uinput;
+    std::unique_ptr<AdminServer> m_admin;
 
     CoordTransform m_coord_transform;
 
+    // Input coalescing: newest MOVE/HOVER sample per pointer, not yet written
+    struct PendingInput {
+        uint16_t pointer = 0;   // 0x100 | id for stylus, id for touch
+        InputEvent event;
+        std::chrono::steady_clock::time_point first_seen;
+    };
+    std::vector<PendingInput> m_pending_input;
+    // Stylus samples waiting for their slot (--pace-input)
+    InputPacer m_input_pacer;
+    // Stylus prediction (last true sample, to snap back on lift-off)
+    StylusPredictor m_stylus_predictor;
+    InputEvent m_last_stylus = {};
+    bool m_stylus_predicted = false;
+
+    std::atomic<uint64_t> m_input_events_in{0};
+    std::atomic<uint64_t> m_input_events_out{0};
+    InputLatency m_input_latency;
+    InputRecorder m_input_recorder;
+
+    // Input-triggered capture: steady_clock ns of the first input since the
+    // last capture (0 = none); the frame loop waits on the condition
+    std::atomic<int64_t> m_input_trigger_ns{0};
+    std::mutex m_trigger_mutex;
+    std::condition_variable m_trigger_cv;
+    uint32_t m_triggered_frames = 0;
+
+    // Frame decimation while a rate decrease waits for the encoder's next
+    // keyframe (see skip_frame_for_backoff)
+    double m_backoff_credit = 0.0;
+    uint32_t m_backoff_skipped = 0;
+
+    // Capture, encode and audio idle while no client is watching (paused,
+    // silent or away); audio also stops while the primary client is paused
+    bool m_suspended = false;
+    bool m_audio_parked = false;
+
+    // Stage timings of the last completed stats window, for the admin socket
+    struct StageStats {
+        double window_s = 0.0;
+        int frames = 0;
+        double capture_ms = 0.0;
+        double encode_ms = 0.0;
+        double send_ms = 0.0;
+        int capture_fails = 0;
+        int encode_fails = 0;
+    };
+    StageStats m_stage_stats;
+
+    // Guards uinput, coordinate transform and held input: the input thread
+    // writes events while the main loop flushes and resets
+    std::mutex m_input_mutex;
+
+    // Encode once, fan out: control client id -> video subscriber id
+    std::map<uint32_t, uint32_t> m_client_subscribers;
+    std::map<uint32_t, RateController> m_rate_controllers;  // Per unicast subscriber
+    uint32_t m_primary_client = 0;        // First client: owns input and audio
+    uint32_t m_multicast_subscriber = 0;  // Shared by all multicast clients
+    std::chrono::steady_clock::time_point m_last_keyframe_request;
+
+    // Simulcast: rung each subscriber should receive, and the best rung
+    // worth sending it (nothing above the tablet's own screen size)
+    struct RungAssignment {
+        int rung = 0;
+        int top = 0;
+    };
+    std::map<uint32_t, RungAssignment> m_rung_assignments;
+    std::vector<RungFrame> m_rung_frames;  // Reused per captured frame
+    float m_output_scale = 1.0f;           // PARAM_RESOLUTION: encode below capture size
+
+    // Session resume: stream state of a unicast client that dropped off,
+    // kept until it reconnects with its token or the grace period ends
+    struct ParkedSession {
+        std::vector<uint8_t> token;
+        bool primary = false;
+        RateController rate;
+        RungAssignment assignment;
+        std::chrono::steady_clock::time_point expires;
+    };
+    std::map<uint32_t, std::vector<uint8_t>> m_session_tokens;  // Control client id -> token
+    std::vector<ParkedSession> m_parked_sessions;
+    // Last keyframe of each rung, sent to a resuming client right away
+    std::map<int, EncodedFrame> m_keyframe_cache;
+
 #ifdef HAVE_OPUS
     // Audio components
     std::unique_ptr<AudioBackend> m_audio_capture;
@@ -76,6 +199,9 @@ private:
     std::mutex m_audio_mutex;
 #endif
 
+    // Shared egress scheduler (declared after the senders so it stops first)
+    std::unique_ptr<EgressScheduler> m_egress;
+
     std::atomic<bool> m_running{false};
     uint32_t m_frame_count = 0;
 };
@@ -0,0 +1,80 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace stream_tablet {
+
+int LatencyHistogram::bucket_index(uint64_t value_us) {
+    value_us = std::min<uint64_t>(value_us, (1ull << MAX_BITS) - 1);
+    if (value_us < SUB_BUCKETS) {
+        return static_cast<int>(value_us);
+    }
+    // Group g >= 1 covers [2^(g+3), 2^(g+4)) in 16 equal steps
+    int msb = 63 - __builtin_clzll(value_us);
+    int group = msb - SUB_BUCKET_BITS + 1;
+    int sub = static_cast<int>(value_us >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return group * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper(int index) {
+    int group = index / SUB_BUCKETS;
+    int sub = index % SUB_BUCKETS;
+    if (group == 0) {
+        return static_cast<uint64_t>(sub);
+    }
+    int shift = group - 1;
+    return ((static_cast<uint64_t>(SUB_BUCKETS + sub + 1)) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_us) {
+    m_counts[bucket_index(value_us)].fetch_add(1, std::memory_order_relaxed);
+    m_sum_us.fetch_add(value_us, std::memory_order_relaxed);
+
+    uint64_t max = m_max_us.load(std::memory_order_relaxed);
+    while (value_us > max &&
+           !m_max_us.compare_exchange_weak(max, value_us, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot(bool reset) {
+    Snapshot snap;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        snap.counts[i] = reset ? m_counts[i].exchange(0, std::memory_order_relaxed)
+                               : m_counts[i].load(std::memory_order_relaxed);
+        snap.count += snap.counts[i];
+    }
+    // The count comes from the buckets so percentiles stay consistent even
+    // if record() runs concurrently
+    snap.sum_us = reset ? m_sum_us.exchange(0, std::memory_order_relaxed)
+                        : m_sum_us.load(std::memory_order_relaxed);
+    snap.max_us = reset ? m_max_us.exchange(0, std::memory_order_relaxed)
+                        : m_max_us.load(std::memory_order_relaxed);
+    return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(std::ceil(count * std::clamp(p, 0.0, 100.0) / 100.0));
+    target = std::max<uint64_t>(target, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(bucket_upper(i), max_us);
+        }
+    }
+    return max_us;
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot& other) {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum_us += other.sum_us;
+    max_us = std::max(max_us, other.max_us);
+}
+
+}  // namespace stream_tablet
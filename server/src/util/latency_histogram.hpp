@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace stream_tablet {
+
+// Log-linear (HDR-style) histogram of microsecond latencies.
+// Every power of two is split into 16 linear sub-buckets, so any recorded
+// value is known to within ~6% from 1 us up to ~67 s. Buckets are relaxed
+// atomics: record() is lock-free and wait-free and may run on any thread
+// while another thread reads or drains the histogram.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_BITS = 26;  // 2^26 us = 67 s; larger values are clamped
+    static constexpr int BUCKET_COUNT = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // Plain copy of the counters, for percentiles and reporting
+    struct Snapshot {
+        std::array<uint64_t, BUCKET_COUNT> counts = {};
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+        uint64_t max_us = 0;
+
+        // Upper bound of the bucket holding the p-th percentile (0-100)
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum_us) / count : 0.0; }
+
+        void merge(const Snapshot& other);
+    };
+
+    LatencyHistogram() = default;
+
+    void record(uint64_t value_us);
+
+    // Copy the counters; reset=true also zeroes them (per-interval stats).
+    // Values recorded concurrently land in this snapshot or the next one.
+    Snapshot snapshot(bool reset = false);
+
+    static int bucket_index(uint64_t value_us);
+    static uint64_t bucket_upper(int index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_counts = {};
+    std::atomic<uint64_t> m_sum_us{0};
+    std::atomic<uint64_t> m_max_us{0};
+};
+
+}  // namespace stream_tablet
@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <cstdarg>
 #include <ctime>
+#include <atomic>
 
 namespace stream_tablet {
 
@@ -15,7 +16,9 @@ enum class LogLevel {
 
 class Logger {
 public:
-    static void set_level(LogLevel level) { s_level = level; }
+    // Atomic so the admin socket can change it while other threads log
+    static void set_level(LogLevel level) { s_level.store(level, std::memory_order_relaxed); }
+    static LogLevel get_level() { return s_level.load(std::memory_order_relaxed); }
 
     static void debug(const char* fmt, ...) {
         if (s_level <= LogLevel::DEBUG) {
@@ -54,7 +57,7 @@ public:
     }
 
 private:
-    static inline LogLevel s_level = LogLevel::WARN;  // Quiet by default, use -v for INFO, -vv for DEBUG
+    static inline std::atomic<LogLevel> s_level{LogLevel::WARN};  // Quiet by default, use -v for INFO, -vv for DEBUG
 
     static void log_impl(const char* level, const char* fmt, va_list args) {
         time_t now = time(nullptr);
@@ -0,0 +1,169 @@
+// Command line client for the server's admin socket (--admin-socket).
+//
+// Sends one command (the remaining arguments) or, without one, each line
+// of stdin, and prints the replies. The exit status is 1 if the server
+// answered any command with an error.
+//
+// Usage: stream_tablet_ctl [-s socket] [-w seconds] [command [args...]]
+//   stream_tablet_ctl stats
+//   stream_tablet_ctl set pacing light
+//   stream_tablet_ctl -w 1 stats
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void usage(const char* argv0) {
+    printf("Usage: %s [options] [command [args...]]\n", argv0);
+    printf("  -s, --socket PATH   Admin socket (default: $XDG_RUNTIME_DIR/stream_tablet.sock)\n");
+    printf("  -w, --watch SEC     Repeat the command every SEC seconds\n");
+    printf("Without a command, commands are read from stdin, one per line.\n");
+    printf("Run '%s help' for the commands the server knows.\n", argv0);
+}
+
+// Buffered reader for the reply lines
+struct Reader {
+    int fd;
+    std::string buffer;
+
+    bool read_line(std::string& line) {
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+};
+
+// Send one command and print its reply; -1 if the connection is gone
+static int run_command(int fd, Reader& reader, const std::string& command) {
+    std::string line = command + "\n";
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) {
+        fprintf(stderr, "Send failed: %s\n", strerror(errno));
+        return -1;
+    }
+    std::string reply;
+    while (reader.read_line(reply)) {
+        if (reply == "ok") {
+            return 0;
+        }
+        if (reply.compare(0, 6, "error ") == 0) {
+            fprintf(stderr, "%s\n", reply.c_str());
+            return 1;
+        }
+        printf("%s\n", reply.c_str());
+    }
+    fprintf(stderr, "Server closed the admin connection\n");
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    if (const char* runtime_dir = getenv("XDG_RUNTIME_DIR")) {
+        path = std::string(runtime_dir) + "/stream_tablet.sock";
+    }
+    int watch_s = 0;
+
+    static struct option long_options[] = {
+        {"socket", required_argument, 0, 's'},
+        {"watch", required_argument, 0, 'w'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // '+': stop at the command, so its arguments are never taken as options
+    int opt;
+    while ((opt = getopt_long(argc, argv, "+s:w:h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 's': path = optarg; break;
+            case 'w': watch_s = std::max(1, atoi(optarg)); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (path.empty()) {
+        fprintf(stderr, "No admin socket: pass -s PATH (XDG_RUNTIME_DIR is not set)\n");
+        return 1;
+    }
+
+    std::string command;
+    for (int i = optind; i < argc; i++) {
+        if (!command.empty()) {
+            command += ' ';
+        }
+        command += argv[i];
+    }
+    if (command.empty() && watch_s > 0) {
+        fprintf(stderr, "--watch needs a command\n");
+        return 1;
+    }
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+        return 1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", path.c_str(), strerror(errno));
+        return 1;
+    }
+    Reader reader{fd, {}};
+
+    int status = 0;
+    if (!command.empty()) {
+        do {
+            int result = run_command(fd, reader, command);
+            if (result < 0) {
+                status = 1;
+                break;
+            }
+            status |= result;
+            if (watch_s > 0) {
+                printf("\n");
+                fflush(stdout);
+                sleep(static_cast<unsigned>(watch_s));
+            }
+        } while (watch_s > 0);
+    } else {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            int result = run_command(fd, reader, line);
+            if (result < 0) {
+                status = 1;
+                break;
+            }
+            status |= result;
+            fflush(stdout);
+        }
+    }
+
+    close(fd);
+    return status;
+}
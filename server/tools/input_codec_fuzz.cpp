@@ -0,0 +1,293 @@
+// Randomized checks of the compact input codec against the legacy format.
+//
+// 1. Round trip: random event streams (pen strokes, touches, keys and
+//    out-of-range garbage) go through the legacy 28-byte packets and through
+//    compact batches cut at random points. Every decoded event must match
+//    the legacy decode exactly in type, pointer, buttons and timestamp, and
+//    within one quantization step in x/y/pressure/tilt.
+// 2. Robustness: random and bit-flipped batches must decode or be rejected
+//    without reading outside the padded scratch (build with
+//    -fsanitize=address,undefined to check).
+// 3. Size and decode speed of both formats.
+//
+// Usage: stream_tablet_input_codec_fuzz [-n iterations] [-s seed]
+
+#include "network/input_codec.hpp"
+
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace stream_tablet;
+
+static std::mt19937 g_rng;
+
+static float uniform(float lo, float hi) {
+    return std::uniform_real_distribution<float>(lo, hi)(g_rng);
+}
+
+static int randint(int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(g_rng);
+}
+
+// A plausible session: strokes at 240-480 Hz with hovering, touches and
+// the odd key, plus some values outside the normal ranges
+static std::vector<InputEvent> random_stream(int count) {
+    std::vector<InputEvent> events;
+    uint32_t t = static_cast<uint32_t>(g_rng());  // Exercises wraparound
+    float x = 0.5f, y = 0.5f;
+    while (static_cast<int>(events.size()) < count) {
+        InputEvent e = {};
+        int kind = randint(0, 9);
+        t += (kind == 0) ? static_cast<uint32_t>(randint(0, 100000)) : static_cast<uint32_t>(randint(0, 5));
+        x = std::clamp(x + uniform(-0.01f, 0.01f), 0.0f, 1.0f);
+        y = std::clamp(y + uniform(-0.01f, 0.01f), 0.0f, 1.0f);
+        e.x = x;
+        e.y = y;
+        e.timestamp_ms = t;
+        if (kind <= 6) {
+            static const InputEventType stylus[] = {InputEventType::STYLUS_DOWN, InputEventType::STYLUS_MOVE,
+                                                    InputEventType::STYLUS_MOVE, InputEventType::STYLUS_MOVE,
+                                                    InputEventType::STYLUS_UP, InputEventType::STYLUS_HOVER};
+            e.type = stylus[randint(0, 5)];
+            e.pressure = uniform(0.0f, 1.0f);
+            e.tilt_x = uniform(-1.2f, 1.2f);
+            e.tilt_y = uniform(-3.14159f, 3.14159f);
+            e.buttons = (randint(0, 20) == 0) ? static_cast<uint16_t>(randint(0, 0x3f)) : 0x01;
+        } else if (kind <= 8) {
+            e.type = static_cast<InputEventType>(randint(1, 3));
+            e.pointer_id = static_cast<uint8_t>(randint(0, 9));
+            e.pressure = uniform(0.0f, 1.0f);
+        } else {
+            e.type = static_cast<InputEventType>(randint(8, 9));
+            e.pointer_id = static_cast<uint8_t>(randint(0, 255));
+            e.buttons = static_cast<uint16_t>(randint(0, 65535));
+        }
+        if (randint(0, 50) == 0) {
+            // Out of range: must clamp, not wrap
+            e.x = uniform(-2.0f, 3.0f);
+            e.pressure = uniform(-1.0f, 5.0f);
+            e.tilt_x = uniform(-10.0f, 10.0f);
+        }
+        events.push_back(e);
+    }
+    return events;
+}
+
+static bool close_to(float decoded, float legacy, float lo, float hi, float step) {
+    return std::fabs(decoded - std::clamp(legacy, lo, hi)) <= step;
+}
+
+static bool check_round_trip(int count, size_t& legacy_bytes, size_t& compact_bytes) {
+    std::vector<InputEvent> events = random_stream(count);
+
+    // Legacy: exact
+    std::vector<InputEvent> legacy;
+    for (const InputEvent& e : events) {
+        InputEventPacket packet;
+        encode_legacy_packet(e, packet);
+        uint8_t wire[sizeof(packet)];
+        memcpy(wire, &packet, sizeof(packet));
+        memcpy(&packet, wire, sizeof(packet));
+        InputEvent out = {};
+        decode_legacy_packet(packet, out);
+        legacy.push_back(out);
+        legacy_bytes += sizeof(packet);
+    }
+
+    // Compact: batches cut at random sizes, as a client flushing per vsync would
+    CompactInputEncoder encoder;
+    std::vector<uint8_t> stream;
+    for (const InputEvent& e : events) {
+        if (randint(0, 8) == 0) {
+            encoder.finish(stream);
+        }
+        if (!encoder.add(e)) {
+            encoder.finish(stream);
+            encoder.add(e);
+        }
+    }
+    encoder.finish(stream);
+    compact_bytes += stream.size();
+
+    CompactInputDecoder decoder;
+    std::vector<InputEvent> decoded;
+    std::vector<uint8_t> scratch(COMPACT_MAX_PAYLOAD + COMPACT_DECODE_PADDING);
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        size_t length = stream[pos] | (stream[pos + 1] << 8);
+        if (length == 0 || length > COMPACT_MAX_PAYLOAD || pos + 2 + length > stream.size()) {
+            printf("FAIL: bad batch length %zu at %zu\n", length, pos);
+            return false;
+        }
+        memcpy(scratch.data(), stream.data() + pos + 2, length);
+        if (!decoder.decode(scratch.data(), length, decoded)) {
+            printf("FAIL: decoder rejected a valid batch at %zu\n", pos);
+            return false;
+        }
+        pos += 2 + length;
+    }
+
+    if (decoded.size() != legacy.size()) {
+        printf("FAIL: %zu events decoded, %zu expected\n", decoded.size(), legacy.size());
+        return false;
+    }
+    const float unit_step = 0.5f / 65535.0f + 1e-6f;
+    const float tilt_step = 0.5f * 3.14159265f / 32767.0f + 1e-5f;
+    for (size_t i = 0; i < legacy.size(); i++) {
+        const InputEvent& a = legacy[i];
+        const InputEvent& b = decoded[i];
+        bool ok = a.type == b.type && a.pointer_id == b.pointer_id && a.buttons == b.buttons &&
+                  a.timestamp_ms == b.timestamp_ms &&
+                  close_to(b.x, a.x, 0.0f, 1.0f, unit_step) &&
+                  close_to(b.y, a.y, 0.0f, 1.0f, unit_step) &&
+                  close_to(b.pressure, a.pressure, 0.0f, 1.0f, unit_step) &&
+                  close_to(b.tilt_x, a.tilt_x, -3.14159265f, 3.14159265f, tilt_step) &&
+                  close_to(b.tilt_y, a.tilt_y, -3.14159265f, 3.14159265f, tilt_step);
+        if (!ok) {
+            printf("FAIL: event %zu differs: type %d/%d ptr %d/%d x %f/%f y %f/%f p %f/%f "
+                   "tilt %f,%f/%f,%f buttons %x/%x t %u/%u\n", i,
+                   static_cast<int>(a.type), static_cast<int>(b.type), a.pointer_id, b.pointer_id,
+                   a.x, b.x, a.y, b.y, a.pressure, b.pressure, a.tilt_x, a.tilt_y, b.tilt_x, b.tilt_y,
+                   a.buttons, b.buttons, a.timestamp_ms, b.timestamp_ms);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Garbage in: decode() may reject, but every accepted event must be sane
+static bool check_garbage(uint64_t& accepted, uint64_t& rejected) {
+    std::vector<uint8_t> scratch(COMPACT_MAX_PAYLOAD + COMPACT_DECODE_PADDING);
+    size_t length = static_cast<size_t>(randint(1, static_cast<int>(COMPACT_MAX_PAYLOAD)));
+
+    if (randint(0, 1)) {
+        for (size_t i = 0; i < length; i++) scratch[i] = static_cast<uint8_t>(g_rng());
+    } else {
+        // A valid batch with a few bits flipped and maybe truncated
+        CompactInputEncoder encoder;
+        std::vector<uint8_t> batch;
+        for (const InputEvent& e : random_stream(randint(1, 60))) {
+            if (!encoder.add(e)) break;
+        }
+        encoder.finish(batch);
+        length = batch.size() - 2;
+        memcpy(scratch.data(), batch.data() + 2, length);
+        for (int flips = randint(1, 4); flips > 0; flips--) {
+            scratch[randint(0, static_cast<int>(length) - 1)] ^= static_cast<uint8_t>(1 << randint(0, 7));
+        }
+        length = static_cast<size_t>(randint(1, static_cast<int>(length)));
+    }
+    // Poison the padding: a decoder that uses it would produce odd values
+    for (size_t i = length; i < scratch.size(); i++) scratch[i] = 0xA5;
+
+    CompactInputDecoder decoder;
+    std::vector<InputEvent> out;
+    if (!decoder.decode(scratch.data(), length, out)) {
+        rejected++;
+        return true;
+    }
+    accepted++;
+    if (out.size() > length / 6) {
+        printf("FAIL: %zu events from %zu bytes\n", out.size(), length);
+        return false;
+    }
+    for (const InputEvent& e : out) {
+        int type = static_cast<int>(e.type);
+        if (type < 1 || type > 9 || e.x < 0.0f || e.x > 1.0f || e.y < 0.0f || e.y > 1.0f ||
+            e.pressure < 0.0f || e.pressure > 1.0f) {
+            printf("FAIL: decoded out-of-range event from garbage\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bench(int count) {
+    std::vector<InputEvent> events = random_stream(count);
+    std::vector<uint8_t> legacy(events.size() * sizeof(InputEventPacket));
+    for (size_t i = 0; i < events.size(); i++) {
+        InputEventPacket packet;
+        encode_legacy_packet(events[i], packet);
+        memcpy(legacy.data() + i * sizeof(packet), &packet, sizeof(packet));
+    }
+    CompactInputEncoder encoder;
+    std::vector<uint8_t> compact;
+    for (const InputEvent& e : events) {
+        if (!encoder.add(e)) {
+            encoder.finish(compact);
+            encoder.add(e);
+        }
+    }
+    encoder.finish(compact);
+    const size_t compact_size = compact.size();
+    compact.resize(compact_size + COMPACT_DECODE_PADDING);
+
+    std::vector<InputEvent> out;
+    out.reserve(events.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events.size(); i++) {
+        InputEventPacket packet;
+        memcpy(&packet, legacy.data() + i * sizeof(packet), sizeof(packet));
+        InputEvent e;
+        decode_legacy_packet(packet, e);
+        out.push_back(e);
+    }
+    double legacy_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    out.clear();
+    CompactInputDecoder decoder;
+    start = std::chrono::steady_clock::now();
+    size_t pos = 0;
+    while (pos < compact_size) {
+        size_t length = compact[pos] | (compact[pos + 1] << 8);
+        decoder.decode(compact.data() + pos + 2, length, out);
+        pos += 2 + length;
+    }
+    double compact_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Decode: legacy %.1f ns/event, compact %.1f ns/event (%zu events)\n",
+           legacy_ns / events.size(), compact_ns / out.size(), out.size());
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = 2000;
+    unsigned seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n': iterations = std::max(1, atoi(optarg)); break;
+            case 's': seed = static_cast<unsigned>(strtoul(optarg, nullptr, 10)); break;
+            default:
+                printf("Usage: %s [-n iterations] [-s seed]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    g_rng.seed(seed);
+
+    size_t legacy_bytes = 0, compact_bytes = 0;
+    uint64_t accepted = 0, rejected = 0;
+    for (int i = 0; i < iterations; i++) {
+        if (!check_round_trip(randint(1, 500), legacy_bytes, compact_bytes)) {
+            printf("Round trip failed in iteration %d (seed %u)\n", i, seed);
+            return 1;
+        }
+        if (!check_garbage(accepted, rejected)) {
+            printf("Garbage check failed in iteration %d (seed %u)\n", i, seed);
+            return 1;
+        }
+    }
+
+    printf("Round trip OK: %d streams, legacy %zu bytes, compact %zu bytes (%.1f%%)\n",
+           iterations, legacy_bytes, compact_bytes, 100.0 * compact_bytes / legacy_bytes);
+    printf("Garbage: %lu batches rejected, %lu accepted with sane events\n", rejected, accepted);
+    bench(1000000);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Replays an input recording (--record-input) into a server's input port.
+//
+// Events are sent as legacy 28-byte packets over TCP at their recorded
+// receive times, optionally sped up, on an absolute CLOCK_MONOTONIC
+// schedule so errors don't accumulate. Client timestamps are rewritten to
+// the replay schedule so prediction and latency tracking on the server see
+// a consistent stream. Run the server with
+// --uinput-sink to benchmark without uinput devices.
+//
+// Usage: stream_tablet_input_replay [-H host] [-p port] [-x speed] [-g max_gap_ms]
+//                                   [-l loops] [--csv out.csv] recording
+
+#include "input/input_recorder.hpp"
+#include "network/input_codec.hpp"
+#include "util/latency_histogram.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace stream_tablet;
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(deadline_ns / 1000000000ULL);
+    ts.tv_nsec = static_cast<long>(deadline_ns % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+// Stylus samples in the CSV layout predict_eval reads
+static bool write_csv(const char* path, const std::vector<RecordedInput>& events) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "timestamp_ms,type,x,y\n");
+    for (const RecordedInput& r : events) {
+        int type = static_cast<int>(r.event.type);
+        if (type >= 4 && type <= 6) {
+            fprintf(f, "%u,%d,%.6f,%.6f\n", r.event.timestamp_ms, type, r.event.x, r.event.y);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void usage(const char* argv0) {
+    printf("Usage: %s [options] recording\n", argv0);
+    printf("  -H, --host HOST     Server address (default: 127.0.0.1)\n");
+    printf("  -p, --port PORT     Input port (default: 9502)\n");
+    printf("  -x, --speed N       Replay N times faster (default: 1)\n");
+    printf("  -g, --max-gap MS    Shorten pauses longer than MS (default: 1000)\n");
+    printf("  -l, --loops N       Replay N times back to back (default: 1)\n");
+    printf("      --csv FILE      Write stylus samples as predict_eval CSV and exit\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = 9502;
+    double speed = 1.0;
+    uint64_t max_gap_us = 1000000;
+    int loops = 1;
+    const char* csv = nullptr;
+
+    static struct option long_options[] = {
+        {"host", required_argument, 0, 'H'},
+        {"port", required_argument, 0, 'p'},
+        {"speed", required_argument, 0, 'x'},
+        {"max-gap", required_argument, 0, 'g'},
+        {"loops", required_argument, 0, 'l'},
+        {"csv", required_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:x:g:l:h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'x': speed = std::max(0.01, atof(optarg)); break;
+            case 'g': max_gap_us = static_cast<uint64_t>(std::max(1, atoi(optarg))) * 1000; break;
+            case 'l': loops = std::max(1, atoi(optarg)); break;
+            case 'c': csv = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<RecordedInput> events;
+    if (!read_input_recording(argv[optind], events)) {
+        fprintf(stderr, "%s: not an input recording\n", argv[optind]);
+        return 1;
+    }
+    if (events.empty()) {
+        fprintf(stderr, "%s: no events\n", argv[optind]);
+        return 1;
+    }
+    if (csv) {
+        return write_csv(csv, events) ? 0 : 1;
+    }
+
+    // Schedule: recorded offsets with long pauses cut short, scaled by speed
+    std::vector<uint64_t> schedule_ns(events.size());
+    uint64_t t = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (i > 0) {
+            t += std::min(events[i].offset_us - events[i - 1].offset_us, max_gap_us);
+        }
+        schedule_ns[i] = static_cast<uint64_t>(t * 1000.0 / speed);
+    }
+    uint64_t loop_ns = schedule_ns.back() + static_cast<uint64_t>(10000000 / speed);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (fd < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+        connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "Cannot connect to %s:%d: %s\n", host, port, strerror(errno));
+        return 1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    printf("Replaying %zu events (%.2f s at %.2fx) to %s:%d, %d loop(s)\n", events.size(),
+           schedule_ns.back() / 1e9, speed, host, port, loops);
+
+    LatencyHistogram lateness;
+    const uint64_t start_ns = monotonic_ns() + 1000000;
+    const uint32_t base_ts = static_cast<uint32_t>(start_ns / 1000000);
+    uint64_t sent = 0;
+
+    for (int loop = 0; loop < loops; loop++) {
+        uint64_t loop_start = start_ns + loop * loop_ns;
+        for (size_t i = 0; i < events.size(); i++) {
+            // Everything due by now goes out in one write
+            uint64_t due = loop_start + schedule_ns[i];
+            sleep_until(due);
+            uint64_t now = monotonic_ns();
+
+            std::vector<uint8_t> batch;
+            size_t j = i;
+            do {
+                InputEvent event = events[j].event;
+                event.timestamp_ms = base_ts + static_cast<uint32_t>((loop_start - start_ns + schedule_ns[j]) / 1000000);
+                InputEventPacket packet;
+                encode_legacy_packet(event, packet);
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&packet);
+                batch.insert(batch.end(), bytes, bytes + sizeof(packet));
+                lateness.record((now - (loop_start + schedule_ns[j])) / 1000);
+                j++;
+            } while (j < events.size() && loop_start + schedule_ns[j] <= now);
+
+            if (send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(batch.size())) {
+                fprintf(stderr, "Send failed after %lu events: %s\n", sent, strerror(errno));
+                close(fd);
+                return 1;
+            }
+            sent += j - i;
+            i = j - 1;
+        }
+    }
+
+    double elapsed = (monotonic_ns() - start_ns) / 1e9;
+    LatencyHistogram::Snapshot late = lateness.snapshot();
+    printf("Sent %lu events in %.2f s | send lateness p50=%luus p99=%luus max=%luus\n", sent, elapsed,
+           late.percentile(50), late.percentile(99), late.max_us);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Offline evaluation of StylusPredictor.
+//
+// Replays pen strokes and compares each prediction with where the pen really
+// was `horizon` ms later (interpolated from the trace), next to the error of
+// not predicting at all. Traces are CSV lines "timestamp_ms,type,x,y" with
+// type 4/5/6 = STYLUS_DOWN/MOVE/UP and x/y normalized; without a file a set
+// of synthetic 240 Hz strokes is used.
+//
+// Usage: stream_tablet_predict_eval [-f trace.csv] [-t horizon_ms] [-j jerk] [-s sigma]
+
+#include "input/stylus_predictor.hpp"
+
+#include <getopt.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace stream_tablet;
+
+struct Sample {
+    uint32_t t_ms;
+    float x;
+    float y;
+};
+
+using Stroke = std::vector<Sample>;
+
+// Errors are reported in pixels of a 2560 px wide screen
+static constexpr float PIXELS = 2560.0f;
+
+static bool load_csv(const char* path, std::vector<Stroke>& strokes) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    Stroke current;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned t;
+        int type;
+        float x, y;
+        if (sscanf(line, "%u,%d,%f,%f", &t, &type, &x, &y) != 4) {
+            continue;  // Header or comment
+        }
+        if (type == 4) {
+            current.clear();
+        }
+        if (type >= 4 && type <= 6) {
+            current.push_back({t, x, y});
+        }
+        if (type == 6 && current.size() > 1) {
+            strokes.push_back(current);
+            current.clear();
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+// Handwriting-like strokes: loops, a zigzag and a line that stops dead
+static void synthesize(std::vector<Stroke>& strokes) {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.0002f);
+    const float rate_hz = 240.0f;
+
+    for (int k = 0; k < 20; k++) {
+        Stroke stroke;
+        float duration = 0.4f + 0.05f * k;
+        float speed = 1.0f + 0.2f * (k % 5);
+        for (float t = 0.0f; t < duration; t += 1.0f / rate_hz) {
+            float x, y;
+            switch (k % 3) {
+                case 0:  // Cursive loops
+                    x = 0.2f + 0.25f * t * speed + 0.03f * std::sin(t * speed * 25.0f);
+                    y = 0.5f + 0.04f * std::cos(t * speed * 25.0f);
+                    break;
+                case 1:  // Zigzag hatching
+                    x = 0.3f + 0.2f * std::asin(std::sin(t * speed * 12.0f)) / 1.57f;
+                    y = 0.3f + 0.15f * t;
+                    break;
+                default:  // Fast line, then hold still
+                    x = 0.1f + 0.5f * std::min(t, duration * 0.6f) * speed;
+                    y = 0.7f;
+                    break;
+            }
+            stroke.push_back({static_cast<uint32_t>(1000 * k + t * 1000.0f),
+                              x + noise(rng), y + noise(rng)});
+        }
+        strokes.push_back(stroke);
+    }
+}
+
+// True position at time t (linear between samples); false past the stroke end
+static bool position_at(const Stroke& stroke, float t_ms, float& x, float& y) {
+    if (t_ms > stroke.back().t_ms) {
+        return false;
+    }
+    for (size_t i = 1; i < stroke.size(); i++) {
+        if (stroke[i].t_ms >= t_ms) {
+            const Sample& a = stroke[i - 1];
+            const Sample& b = stroke[i];
+            float span = static_cast<float>(b.t_ms - a.t_ms);
+            float w = span > 0.0f ? (t_ms - a.t_ms) / span : 1.0f;
+            x = a.x + (b.x - a.x) * w;
+            y = a.y + (b.y - a.y) * w;
+            return true;
+        }
+    }
+    x = stroke.back().x;
+    y = stroke.back().y;
+    return true;
+}
+
+static void report(const char* name, std::vector<float>& errors) {
+    if (errors.empty()) {
+        printf("  %-14s no samples\n", name);
+        return;
+    }
+    std::sort(errors.begin(), errors.end());
+    double sum = 0.0;
+    for (float e : errors) sum += e;
+    printf("  %-14s mean=%6.2fpx  p50=%6.2fpx  p95=%6.2fpx  max=%6.2fpx\n", name,
+           sum / errors.size(), errors[errors.size() / 2],
+           errors[errors.size() * 95 / 100], errors.back());
+}
+
+int main(int argc, char* argv[]) {
+    const char* trace = nullptr;
+    float horizon_ms = 20.0f;
+    float jerk = -1.0f;
+    float sigma = -1.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:t:j:s:h")) != -1) {
+        switch (opt) {
+            case 'f': trace = optarg; break;
+            case 't': horizon_ms = static_cast<float>(atof(optarg)); break;
+            case 'j': jerk = static_cast<float>(atof(optarg)); break;
+            case 's': sigma = static_cast<float>(atof(optarg)); break;
+            default:
+                printf("Usage: %s [-f trace.csv] [-t horizon_ms] [-j jerk] [-s sigma]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    std::vector<Stroke> strokes;
+    if (trace) {
+        if (!load_csv(trace, strokes)) {
+            return 1;
+        }
+    } else {
+        synthesize(strokes);
+    }
+
+    StylusPredictor predictor;
+    predictor.set_horizon_ms(horizon_ms);
+    if (jerk > 0.0f) predictor.set_process_noise(jerk);
+    if (sigma > 0.0f) predictor.set_measurement_noise(sigma);
+
+    std::vector<float> predicted_errors;
+    std::vector<float> baseline_errors;
+    size_t samples = 0;
+    for (const Stroke& stroke : strokes) {
+        predictor.reset();
+        for (const Sample& s : stroke) {
+            float px, py;
+            bool predicted = predictor.update(s.x, s.y, s.t_ms, px, py);
+            samples++;
+
+            float fx, fy;
+            if (!predicted || !position_at(stroke, s.t_ms + horizon_ms, fx, fy)) {
+                continue;
+            }
+            predicted_errors.push_back(std::hypot(px - fx, py - fy) * PIXELS);
+            baseline_errors.push_back(std::hypot(s.x - fx, s.y - fy) * PIXELS);
+        }
+    }
+
+    printf("%zu strokes, %zu samples, horizon %.1f ms (%s)\n", strokes.size(), samples,
+           horizon_ms, trace ? trace : "synthetic");
+    report("no prediction", baseline_errors);
+    report("predicted", predicted_errors);
+    return 0;
+}
@@ -0,0 +1,480 @@
+// Reference receiver for stream_tablet_server.
+// Connects like a client, receives the video (and audio) stream, reads the
+// ECN bits of every datagram and sends receiver reports back so the server's
+// rate controller can be exercised without the Android client. With --join it
+// acts as an extra multicast receiver that only sends feedback (NACKs, reports,
+// keyframe requests) and never opens the control connection.
+//
+// Usage: stream_tablet_receiver [-s HOST] [-p PORT] [-l PORT] [-t SECONDS]
+//                               [--no-ecn] [--mux] [--multicast] [--join GROUP:PORT]
+
+#include "network/control_server.hpp"
+#include "network/video_sender.hpp"
+#include "stream_tablet/config.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
+#include <getopt.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace stream_tablet;
+
+namespace {
+
+volatile sig_atomic_t g_running = 1;
+
+void signal_handler(int) {
+    g_running = 0;
+}
+
+struct ReceiverStats {
+    uint32_t video_packets = 0;
+    uint32_t video_lost = 0;
+    uint32_t ect = 0;
+    uint32_t ce = 0;
+    uint32_t frames = 0;
+    uint32_t keyframes = 0;
+    uint32_t audio_packets = 0;
+    uint32_t fec_packets = 0;
+    uint32_t late_packets = 0;      // Retransmitted or reordered
+    uint64_t bytes = 0;
+    bool have_sequence = false;
+    uint16_t highest_sequence = 0;
+    std::vector<uint16_t> missing;  // Gaps not yet NACKed
+};
+
+constexpr size_t MAX_NACK_BACKLOG = 256;
+
+bool send_control(int fd, uint8_t type, const uint8_t* data, size_t len) {
+    std::vector<uint8_t> msg(3 + len);
+    uint16_t length = static_cast<uint16_t>(len + 1);
+    msg[0] = (length >> 8) & 0xFF;
+    msg[1] = length & 0xFF;
+    msg[2] = type;
+    if (len > 0) {
+        memcpy(msg.data() + 3, data, len);
+    }
+    return send(fd, msg.data(), msg.size(), 0) == static_cast<ssize_t>(msg.size());
+}
+
+bool read_control(int fd, uint8_t& type, std::vector<uint8_t>& data) {
+    uint8_t header[3];
+    if (recv(fd, header, sizeof(header), MSG_WAITALL) != sizeof(header)) {
+        return false;
+    }
+    uint16_t length = (header[0] << 8) | header[1];
+    type = header[2];
+    data.resize(length > 1 ? length - 1 : 0);
+    if (!data.empty() &&
+        recv(fd, data.data(), data.size(), MSG_WAITALL) != static_cast<ssize_t>(data.size())) {
+        return false;
+    }
+    return true;
+}
+
+void handle_video(const uint8_t* data, size_t size, uint8_t tos, ReceiverStats& stats) {
+    if (size < sizeof(VideoPacketHeader)) {
+        return;
+    }
+    VideoPacketHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != VIDEO_MAGIC) {
+        return;
+    }
+    if (header.flags & FLAG_FEC) {
+        stats.fec_packets++;
+        return;
+    }
+
+    stats.video_packets++;
+    stats.bytes += size;
+
+    uint8_t ecn = tos & 0x03;
+    if (ecn != ECN_NOT_ECT) stats.ect++;
+    if (ecn == ECN_CE) stats.ce++;
+
+    // Count gaps in the packet sequence as loss (reordered packets are ignored)
+    if (!stats.have_sequence) {
+        stats.have_sequence = true;
+        stats.highest_sequence = header.sequence;
+    } else {
+        uint16_t delta = static_cast<uint16_t>(header.sequence - stats.highest_sequence);
+        if (delta > 0 && delta < 0x8000) {
+            stats.video_lost += delta - 1;
+            for (uint16_t i = 1; i < delta && stats.missing.size() < MAX_NACK_BACKLOG; i++) {
+                stats.missing.push_back(static_cast<uint16_t>(stats.highest_sequence + i));
+            }
+            stats.highest_sequence = header.sequence;
+        } else if (delta >= 0x8000) {
+            stats.late_packets++;
+        }
+    }
+
+    if (header.flags & FLAG_END_OF_FRAME) {
+        stats.frames++;
+        if (header.flags & FLAG_KEYFRAME) stats.keyframes++;
+    }
+}
+
+void send_feedback(int fd, const sockaddr_in& server, bool mux, uint8_t type,
+                   const void* payload, size_t len) {
+    std::vector<uint8_t> buffer;
+    if (mux) {
+        buffer.push_back(STREAM_ID_FEEDBACK);
+    }
+
+    FeedbackPacketHeader header = {};
+    header.magic = FEEDBACK_MAGIC;
+    header.type = type;
+    header.payload_len = static_cast<uint16_t>(len);
+    const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+    buffer.insert(buffer.end(), h, h + sizeof(header));
+    const uint8_t* p = static_cast<const uint8_t*>(payload);
+    buffer.insert(buffer.end(), p, p + len);
+
+    sendto(fd, buffer.data(), buffer.size(), 0,
+           reinterpret_cast<const sockaddr*>(&server), sizeof(server));
+}
+
+void send_report(int fd, const sockaddr_in& server, bool mux, const ReceiverStats& stats) {
+    ReceiverReport report = {};
+    report.highest_sequence = stats.highest_sequence;
+    report.packets_received = stats.video_packets;
+    report.packets_lost = stats.video_lost;
+    report.ect_received = stats.ect;
+    report.ce_received = stats.ce;
+    send_feedback(fd, server, mux, FEEDBACK_RECEIVER_REPORT, &report, sizeof(report));
+}
+
+// Pack missing sequences into (first, bitmask) entries and NACK them
+void send_nacks(int fd, const sockaddr_in& server, bool mux, std::vector<uint16_t>& missing) {
+    std::vector<NackEntry> entries;
+    for (uint16_t sequence : missing) {
+        if (!entries.empty()) {
+            uint16_t offset = static_cast<uint16_t>(sequence - entries.back().sequence);
+            if (offset >= 1 && offset <= 16) {
+                entries.back().bitmask |= static_cast<uint16_t>(1 << (offset - 1));
+                continue;
+            }
+        }
+        entries.push_back(NackEntry{sequence, 0});
+    }
+    missing.clear();
+    if (!entries.empty()) {
+        send_feedback(fd, server, mux, FEEDBACK_NACK, entries.data(),
+                      entries.size() * sizeof(NackEntry));
+    }
+}
+
+// UDP socket with TOS reporting; joins group (if non-null) on the bound port
+int open_udp(uint16_t port, const char* group) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int on = 1;
+    setsockopt(fd, IPPROTO_IP, IP_RECVTOS, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    if (group) {
+        struct ip_mreq mreq = {};
+        inet_pton(AF_INET, group, &mreq.imr_multiaddr);
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            perror("IP_ADD_MEMBERSHIP");
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("Options:\n");
+    printf("  -s, --server HOST   Server address (default: 127.0.0.1)\n");
+    printf("  -p, --port PORT     Server control port (default: %d)\n", ServerConfig().control_port);
+    printf("  -l, --listen PORT   Local UDP port for video (default: 9601)\n");
+    printf("  -t, --time SECONDS  Run time, 0 = until Ctrl+C (default: 0)\n");
+    printf("  -r, --report MS     Receiver report interval (default: 50)\n");
+    printf("  -n, --no-ecn        Do not advertise ECN support\n");
+    printf("  -M, --mux           Request multiplexed UDP\n");
+    printf("  -g, --multicast     Advertise multicast support and join the group\n");
+    printf("  -j, --join G:PORT   Passive multicast receiver (no control connection)\n");
+    printf("  -h, --help          Show this help\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string server_host = "127.0.0.1";
+    int control_port = ServerConfig().control_port;
+    int listen_port = 9601;
+    int run_seconds = 0;
+    int report_ms = 50;
+    bool want_ecn = true;
+    bool want_mux = false;
+    bool want_multicast = false;
+    std::string join_group;
+    int join_port = 0;
+
+    static struct option long_options[] = {
+        {"server", required_argument, 0, 's'},
+        {"port", required_argument, 0, 'p'},
+        {"listen", required_argument, 0, 'l'},
+        {"time", required_argument, 0, 't'},
+        {"report", required_argument, 0, 'r'},
+        {"no-ecn", no_argument, 0, 'n'},
+        {"mux", no_argument, 0, 'M'},
+        {"multicast", no_argument, 0, 'g'},
+        {"join", required_argument, 0, 'j'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:p:l:t:r:nMgj:h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 's': server_host = optarg; break;
+            case 'p': control_port = atoi(optarg); break;
+            case 'l': listen_port = atoi(optarg); break;
+            case 't': run_seconds = atoi(optarg); break;
+            case 'r': report_ms = atoi(optarg); break;
+            case 'n': want_ecn = false; break;
+            case 'M': want_mux = true; break;
+            case 'g': want_multicast = true; break;
+            case 'j': {
+                std::string arg = optarg;
+                size_t colon = arg.rfind(':');
+                if (colon == std::string::npos) {
+                    fprintf(stderr, "--join expects GROUP:PORT\n");
+                    return 1;
+                }
+                join_group = arg.substr(0, colon);
+                join_port = atoi(arg.c_str() + colon + 1);
+                break;
+            }
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (report_ms < 1) report_ms = 1;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* resolved = nullptr;
+    if (getaddrinfo(server_host.c_str(), nullptr, &hints, &resolved) != 0 || !resolved) {
+        fprintf(stderr, "Cannot resolve %s\n", server_host.c_str());
+        return 1;
+    }
+    sockaddr_in server_addr = *reinterpret_cast<sockaddr_in*>(resolved->ai_addr);
+    freeaddrinfo(resolved);
+
+    int udp = -1;
+    int group_fd = -1;
+    int control = -1;
+    bool mux = false;
+    sockaddr_in feedback_addr = server_addr;
+
+    if (!join_group.empty()) {
+        // Passive receiver: feedback goes to the server's video port (control + 1)
+        group_fd = open_udp(static_cast<uint16_t>(join_port), join_group.c_str());
+        if (group_fd < 0) {
+            return 1;
+        }
+        feedback_addr.sin_port = htons(control_port + 1);
+        printf("Joined %s:%d, feedback to %s:%d\n", join_group.c_str(), join_port,
+               server_host.c_str(), control_port + 1);
+    } else {
+        // UDP socket first so nothing is lost while the server starts streaming
+        udp = open_udp(static_cast<uint16_t>(listen_port), nullptr);
+        if (udp < 0) {
+            return 1;
+        }
+
+        control = socket(AF_INET, SOCK_STREAM, 0);
+        server_addr.sin_port = htons(control_port);
+        if (connect(control, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) < 0) {
+            perror("connect");
+            return 1;
+        }
+
+        // Config request: width, height, video_port, input_port, capabilities
+        uint8_t caps = (want_ecn ? CLIENT_CAP_ECN : 0) | (want_mux ? CLIENT_CAP_MUX : 0) |
+                       (want_multicast ? CLIENT_CAP_MULTICAST : 0);
+        uint8_t request[9] = {
+            0x07, 0x80, 0x04, 0x38,
+            static_cast<uint8_t>(listen_port >> 8), static_cast<uint8_t>(listen_port & 0xFF),
+            static_cast<uint8_t>((listen_port + 1) >> 8), static_cast<uint8_t>((listen_port + 1) & 0xFF),
+            caps
+        };
+        send_control(control, MSG_CONFIG_REQUEST, request, sizeof(request));
+
+        uint8_t type = 0;
+        std::vector<uint8_t> response;
+        if (!read_control(control, type, response) || type != MSG_CONFIG_RESPONSE || response.size() < 8) {
+            fprintf(stderr, "No config response from server\n");
+            return 1;
+        }
+
+        int width = (response[0] << 8) | response[1];
+        int height = (response[2] << 8) | response[3];
+        int server_video_port = (response[4] << 8) | response[5];
+        uint8_t flags = response.size() >= 16 ? response[15] : 0;
+        mux = flags & STREAM_FLAG_MUX;
+
+        printf("Connected: %dx%d, server video port %d, flags=0x%02x (ecn=%s mux=%s multicast=%s)\n",
+               width, height, server_video_port, flags,
+               (flags & STREAM_FLAG_ECN) ? "on" : "off", mux ? "on" : "off",
+               (flags & STREAM_FLAG_MULTICAST) ? "on" : "off");
+
+        if ((flags & STREAM_FLAG_MULTICAST) && response.size() >= 22) {
+            char group[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &response[16], group, sizeof(group));
+            int group_port = (response[20] << 8) | response[21];
+            group_fd = open_udp(static_cast<uint16_t>(group_port), group);
+            if (group_fd < 0) {
+                return 1;
+            }
+            printf("Joined multicast group %s:%d\n", group, group_port);
+        }
+
+        feedback_addr.sin_port = htons(server_video_port);
+    }
+
+    // Feedback leaves from the socket the server sees us on
+    int feedback_fd = udp >= 0 ? udp : group_fd;
+    if (group_fd >= 0) {
+        // Joining mid-stream: ask for an IDR instead of waiting for the next GOP
+        send_feedback(feedback_fd, feedback_addr, mux, FEEDBACK_KEYFRAME_REQUEST, nullptr, 0);
+    }
+
+    ReceiverStats stats;
+    ReceiverStats last_printed;
+    auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    auto last_print = start;
+
+    uint8_t buffer[65536];
+    alignas(cmsghdr) char cmsg_buf[CMSG_SPACE(sizeof(int))];
+
+    auto drain = [&](int fd) {
+        while (true) {
+            struct iovec iov = {buffer, sizeof(buffer)};
+            struct msghdr msg = {};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = cmsg_buf;
+            msg.msg_controllen = sizeof(cmsg_buf);
+
+            ssize_t n = recvmsg(fd, &msg, MSG_DONTWAIT);
+            if (n <= 0) break;
+
+            uint8_t tos = 0;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS) {
+                    tos = *CMSG_DATA(cmsg);
+                }
+            }
+
+            const uint8_t* data = buffer;
+            size_t size = static_cast<size_t>(n);
+            if (mux && fd == udp) {
+                uint8_t stream_id = data[0];
+                data++;
+                size--;
+                if (stream_id == STREAM_ID_AUDIO) {
+                    stats.audio_packets++;
+                    continue;
+                }
+                if (stream_id != STREAM_ID_VIDEO) {
+                    continue;
+                }
+            }
+            handle_video(data, size, tos, stats);
+        }
+    };
+
+    while (g_running) {
+        struct pollfd pfds[2];
+        nfds_t nfds = 0;
+        if (udp >= 0) pfds[nfds++] = {udp, POLLIN, 0};
+        if (group_fd >= 0) pfds[nfds++] = {group_fd, POLLIN, 0};
+        int ready = poll(pfds, nfds, report_ms);
+
+        if (ready > 0) {
+            for (nfds_t i = 0; i < nfds; i++) {
+                if (pfds[i].revents & POLLIN) {
+                    drain(pfds[i].fd);
+                }
+            }
+        }
+
+        if (!stats.missing.empty()) {
+            send_nacks(feedback_fd, feedback_addr, mux, stats.missing);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::milliseconds(report_ms)) {
+            send_report(feedback_fd, feedback_addr, mux, stats);
+            last_report = now;
+        }
+
+        if (now - last_print >= std::chrono::seconds(1)) {
+            double secs = std::chrono::duration<double>(now - last_print).count();
+            uint32_t packets = stats.video_packets - last_printed.video_packets;
+            printf("%.1f Mbps | %u fps | pkts=%u lost=%u late=%u fec=%u ect=%u ce=%u | keyframes=%u audio=%u\n",
+                   (stats.bytes - last_printed.bytes) * 8.0 / secs / 1e6,
+                   stats.frames - last_printed.frames, packets,
+                   stats.video_lost - last_printed.video_lost,
+                   stats.late_packets - last_printed.late_packets,
+                   stats.fec_packets - last_printed.fec_packets,
+                   stats.ect - last_printed.ect, stats.ce - last_printed.ce,
+                   stats.keyframes, stats.audio_packets - last_printed.audio_packets);
+            fflush(stdout);
+            last_printed = stats;
+            last_print = now;
+        }
+
+        if (run_seconds > 0 && now - start >= std::chrono::seconds(run_seconds)) {
+            break;
+        }
+    }
+
+    if (control >= 0) {
+        send_control(control, MSG_DISCONNECT, nullptr, 0);
+        close(control);
+    }
+    if (udp >= 0) close(udp);
+    if (group_fd >= 0) close(group_fd);
+
+    printf("Total: pkts=%u lost=%u late=%u fec=%u ect=%u ce=%u frames=%u keyframes=%u audio=%u\n",
+           stats.video_packets, stats.video_lost, stats.late_packets, stats.fec_packets,
+           stats.ect, stats.ce, stats.frames, stats.keyframes, stats.audio_packets);
+    return 0;
+}
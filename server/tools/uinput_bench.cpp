@@ -0,0 +1,169 @@
+// Per-sample cost of writing stylus reports.
+//
+// Compares one write() per input_event (the old emit path) with one write()
+// per report, and times UInputBackend::send_stylus itself. Runs against a
+// pipe drained by a reader thread by default; --uinput uses real devices.
+//
+// Usage: stream_tablet_uinput_bench [-n samples] [--uinput]
+
+#include "input/uinput_backend.hpp"
+#include "util/logger.hpp"
+
+#include <linux/uinput.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace stream_tablet;
+
+static std::atomic<bool> g_draining{true};
+
+// Typical pen-down move report: position, pressure, tilt and SYN
+static int build_report(struct input_event* events, int i) {
+    int n = 0;
+    auto add = [&](int type, int code, int value) {
+        memset(&events[n], 0, sizeof(events[n]));
+        events[n].type = type;
+        events[n].code = code;
+        events[n].value = value;
+        n++;
+    };
+    add(EV_ABS, ABS_X, 1000 + (i % 5000));
+    add(EV_ABS, ABS_Y, 2000 + (i % 3000));
+    add(EV_ABS, ABS_PRESSURE, 30000);
+    add(EV_ABS, ABS_TILT_X, 10);
+    add(EV_ABS, ABS_TILT_Y, -5);
+    add(EV_SYN, SYN_REPORT, 0);
+    return n;
+}
+
+static void drain(int fd) {
+    char buf[65536];
+    while (g_draining) {
+        if (read(fd, buf, sizeof(buf)) <= 0) {
+            break;
+        }
+    }
+}
+
+static double ns_per_sample(std::chrono::steady_clock::time_point start, int samples) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / samples;
+}
+
+int main(int argc, char* argv[]) {
+    int samples = 200000;
+    bool use_uinput = false;
+
+    static struct option long_options[] = {
+        {"samples", required_argument, 0, 'n'},
+        {"uinput", no_argument, 0, 'u'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:uh", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'n':
+                samples = std::max(1, atoi(optarg));
+                break;
+            case 'u':
+                use_uinput = true;
+                break;
+            default:
+                printf("Usage: %s [-n samples] [--uinput]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    Logger::set_level(LogLevel::WARN);
+
+    UInputBackend backend;
+    std::vector<std::thread> drainers;
+    std::vector<int> read_ends;
+
+    if (use_uinput) {
+        if (!backend.init(1920, 1080)) {
+            fprintf(stderr, "Cannot create uinput devices (need access to /dev/uinput)\n");
+            return 1;
+        }
+    }
+
+    // Pipe stand-in: one pipe per device plus one for the raw comparison
+    int pipes[4][2];
+    for (auto& p : pipes) {
+        if (pipe(p) < 0) {
+            perror("pipe");
+            return 1;
+        }
+        fcntl(p[1], F_SETPIPE_SZ, 1 << 20);
+        read_ends.push_back(p[0]);
+        drainers.emplace_back(drain, p[0]);
+    }
+    int raw_fd = pipes[3][1];
+    if (!use_uinput) {
+        backend.attach_fds(pipes[0][1], pipes[1][1], pipes[2][1], 1920, 1080);
+    }
+
+    struct input_event report[8];
+    int count = build_report(report, 0);
+
+    // Old path: one syscall per event
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        count = build_report(report, i);
+        for (int e = 0; e < count; e++) {
+            if (write(raw_fd, &report[e], sizeof(report[e])) < 0) break;
+        }
+    }
+    double per_event = ns_per_sample(start, samples);
+
+    // Batched: one syscall per report
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        count = build_report(report, i);
+        if (write(raw_fd, report, sizeof(report[0]) * count) < 0) break;
+    }
+    double per_report = ns_per_sample(start, samples);
+
+    // The backend itself (pen down, then moves)
+    backend.send_stylus(100, 100, 0.5f, 0, 0, true, false, false, false);
+    uint64_t writes_before = backend.get_writes();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        backend.send_stylus(100 + (i % 1000), 100 + (i % 700), 0.5f, 10, -5,
+                            true, false, false, false);
+    }
+    double backend_ns = ns_per_sample(start, samples);
+    uint64_t writes = backend.get_writes() - writes_before;
+
+    printf("%d samples, %d events/report, target: %s\n", samples, count,
+           use_uinput ? "/dev/uinput (backend), pipe (raw)" : "pipe");
+    printf("  write per event:   %8.0f ns/sample (%d syscalls)\n", per_event, count);
+    printf("  write per report:  %8.0f ns/sample (1 syscall)\n", per_report);
+    printf("  send_stylus():     %8.0f ns/sample (%.2f syscalls, %lu write errors)\n",
+           backend_ns, static_cast<double>(writes) / samples, backend.get_write_errors());
+
+    // The backend closes the write ends it was given
+    backend.shutdown();
+    g_draining = false;
+    for (int i = use_uinput ? 0 : 3; i < 4; i++) {
+        close(pipes[i][1]);
+    }
+    for (auto& t : drainers) {
+        t.join();
+    }
+    for (int fd : read_ends) {
+        close(fd);
+    }
+    return 0;
+}